@@ -29,6 +29,13 @@ typedef struct public_key public_key_t;
  */
 typedef struct key_metainfo key_metainfo_t;
 
+/**
+ * @struct signer_metainfo
+ * @brief Structure that represents the subset of a key_metainfo needed by a single node to sign. It only stores
+ * the verification key of its own node, instead of the verification keys of the l nodes.
+ */
+typedef struct signer_metainfo signer_metainfo_t;
+
 /**
  * @struct key_share
  * @brief Structure that represents one key share, to be used to generate a signature share.
@@ -41,6 +48,55 @@ typedef struct key_share key_share_t;
  */
 typedef struct signature_share signature_share_t;
 
+/**
+ * @struct document_ctx
+ * @brief Structure with the values that signing, verifying and joining derive from a prepared document and a key, so
+ * that they are computed once per document.
+ */
+typedef struct document_ctx tc_document_ctx_t;
+
+/**
+ * @struct prepare_ctx
+ * @brief Structure with the state of a document being prepared incrementally.
+ */
+typedef struct prepare_ctx tc_prepare_ctx_t;
+
+/**
+ * @struct engine
+ * @brief Structure with the worker threads and the submission queue of a signing engine.
+ */
+typedef struct engine tc_engine_t;
+
+/**
+ * @struct future
+ * @brief Structure with the state and the result of an operation submitted to an engine.
+ */
+typedef struct future tc_future_t;
+
+/**
+ * @struct scheduler
+ * @brief Structure with the worker threads of a scheduler that signs the requests for the same key in batches.
+ */
+typedef struct scheduler tc_scheduler_t;
+
+/**
+ * @struct completion_queue
+ * @brief Structure with the futures of asynchronous operations that are done, and the eventfd that signals them.
+ */
+typedef struct completion_queue tc_completion_queue_t;
+
+/**
+ * @struct shm_ring
+ * @brief Structure with a process' mapping of a shared memory ring buffer.
+ */
+typedef struct shm_ring tc_shm_ring_t;
+
+/**
+ * @struct public_key_ctx
+ * @brief Structure with an RSA public key decoded for verification, to verify many signatures under the same key.
+ */
+typedef struct public_key_ctx tc_public_key_ctx_t;
+
 /**
  * @brief Hash functions to be used when preparing a document to be signed.
  */
@@ -50,13 +106,156 @@ enum tc_hash_type {
 };
 typedef enum tc_hash_type tc_hash_type_t;
 
+/**
+ * @brief Arithmetic backends used for the modular exponentiations and the prime generation.
+ */
+enum tc_backend {
+    TC_BACKEND_GMP, /**< GMP, the default */
+    TC_BACKEND_OPENSSL /**< OpenSSL BIGNUM, only if the library was built with TC_OPENSSL_BACKEND */
+};
+typedef enum tc_backend tc_backend_t;
+
+/**
+ * @brief Counters of the object pools.
+ */
+struct tc_pool_stats {
+    uint64_t hits; /**< Objects taken from a pool instead of allocated */
+    uint64_t misses; /**< Objects allocated because the pool of the thread was empty */
+    uint64_t recycled; /**< Objects returned to a pool instead of released */
+    uint64_t dropped; /**< Objects released because the pool of the thread was full */
+    uint64_t cached; /**< Objects currently cached by the calling thread */
+};
+typedef struct tc_pool_stats tc_pool_stats_t;
+
+/**
+ * @brief Number of batch sizes told apart by tc_scheduler_stats: 1, 2-3, 4-7, 8-15, 16-31, 32-63 and 64.
+ */
+#define TC_SCHEDULER_BATCH_BUCKETS 7
+
+/**
+ * @struct tc_scheduler_stats
+ * @brief Counters of a scheduler since it started, see tc_get_scheduler_stats.
+ */
+struct tc_scheduler_stats {
+    uint64_t requests; /**< Requests signed */
+    uint64_t batches; /**< Batches signed, each one with requests for a single key */
+    uint64_t batch_sizes[TC_SCHEDULER_BATCH_BUCKETS]; /**< Batches by size, from 1 up to powers of two */
+    uint64_t wait_total_ns; /**< Sum of the time each request waited between its submission and its batch */
+    uint64_t wait_max_ns; /**< Longest time a request waited between its submission and its batch */
+};
+typedef struct tc_scheduler_stats tc_scheduler_stats_t;
+
+/**
+ * @struct tc_completion
+ * @brief An operation delivered by a completion queue, see tc_poll_completions.
+ */
+struct tc_completion {
+    tc_future_t *future; /**< Done, its result is read as for the futures of the engine, then it is cleared */
+    void *user_data; /**< Given when the operation was submitted */
+};
+typedef struct tc_completion tc_completion_t;
+
+/**
+ * @brief Allocation function used by the library. Receives the context given to tc_set_allocator.
+ */
+typedef void *(*tc_malloc_fn)(void *ctx, size_t size);
+
+/**
+ * @brief Reallocation function used by the library. Receives the context given to tc_set_allocator.
+ */
+typedef void *(*tc_realloc_fn)(void *ctx, void *ptr, size_t size);
+
+/**
+ * @brief Deallocation function used by the library. Receives the context given to tc_set_allocator.
+ */
+typedef void (*tc_free_fn)(void *ctx, void *ptr);
+
+
+/* Memory management */
+
+/**
+ * Function that sets the allocator used by every allocation made by the library. It should be called before any
+ * other function of the library, and not concurrently with them, since memory allocated with an allocator must be
+ * released with the same one. Passing NULL functions restores the C library allocator.
+ *
+ * The memory returned to the user (serialized strings, data released by tc_release_bytes, etc.) is allocated with
+ * this allocator, and should be released with tc_free.
+ *
+ * @param [in] malloc_fn the allocation function.
+ * @param [in] realloc_fn the reallocation function.
+ * @param [in] free_fn the deallocation function.
+ * @param [in] ctx an opaque pointer given to each of the functions.
+ * @param [in] gmp if it isn't zero, GMP is set to allocate through the same functions (mp_set_memory_functions),
+ *                 otherwise GMP is reset to its default functions.
+ */
+void tc_set_allocator(tc_malloc_fn malloc_fn, tc_realloc_fn realloc_fn, tc_free_fn free_fn, void *ctx, int gmp);
+
+/**
+ * Releases memory allocated by the library with the allocator set by tc_set_allocator.
+ */
+void tc_free(void *ptr);
+
+/**
+ * Function that enables the recycling of the objects allocated by the library (bytes_t, key shares, signature shares
+ * and the buffers of their numbers). Each thread caches up to max released objects of each size class, and reuses
+ * them in later allocations. The cache of a thread is released when the thread exits. Pools are disabled by default.
+ *
+ * @param [in] max the maximum number of objects of each size class cached by each thread. Must be positive.
+ */
+void tc_enable_pools(size_t max);
+
+/**
+ * Disables the object pools, and releases the objects cached by the calling thread.
+ */
+void tc_disable_pools(void);
+
+/**
+ * Releases the objects cached by the calling thread.
+ */
+void tc_flush_pools(void);
+
+/**
+ * @param [out] stats the counters of the pools, aggregated over all the threads, except for cached.
+ */
+void tc_get_pool_stats(tc_pool_stats_t *stats);
+
+/**
+ * Selects the arithmetic backend used from now on by every thread. The numbers and the serialization formats are the
+ * same with every backend, so keys and shares can be used with any of them.
+ *
+ * @param [in] backend the backend to use.
+ * @return 0 on success, -1 if the library was built without that backend.
+ */
+int tc_set_backend(tc_backend_t backend);
+
+/**
+ * @return the arithmetic backend currently selected.
+ */
+tc_backend_t tc_get_backend(void);
+
+/**
+ * Releases the mpz temporaries kept by the calling thread for the algorithms. They are sized for the largest key the
+ * thread has used, and are otherwise kept until the thread exits.
+ */
+void tc_release_workspace(void);
+
+/**
+ * Sets the memory, in bytes, that each key may use for the precomputed tables of its fixed bases. Half of it goes to
+ * the table of v, used by every signature and verification, and the rest is split among the tables of the l
+ * verification keys. Tables are built the first time a key needs them, with the budget set at that moment, and released
+ * with the key metainfo. 0 disables the tables. The default is 1 MiB.
+ *
+ * @param [in] bytes the budget of each key.
+ */
+void tc_set_fixed_base_budget(size_t bytes);
+
 
 /* Operations & Constructors */
 
 
 /**
  * Function that allocates and initialize a bytes_t structure that contains len bytes in the bs pointer.
- * The bytes_t structure will own the data pointed by bs. Any bytes_t structure initialized by this function
+ * The bytes_t structure will own the data pointed by bs, which should be allocated with the library allocator. Any bytes_t structure initialized by this function
  * should be deinitialized by tc_clear_bytes.
  *
  * @param [in] bs pointer to data
@@ -107,6 +306,122 @@ key_share_t **tc_generate_keys(key_metainfo_t **metainfo, size_t bit_size, uint1
  */
 signature_share_t *tc_node_sign(const key_share_t *share, const bytes_t *doc, const key_metainfo_t *info);
 
+/**
+ * @param [in] info the metainfo of the key shares array.
+ *
+ * @return the bytes a signature share of the key takes, for tc_node_sign_into.
+ */
+size_t tc_signature_share_size(const key_metainfo_t *info);
+
+/**
+ * Function that behaves like tc_node_sign, but lays out the signature share in a buffer of the caller instead of
+ * allocating it. The share is valid while the buffer is, and must not be deinitialized by tc_clear_signature_share.
+ *
+ * @param [out] buffer memory for the signature share, aligned like the memory returned by malloc.
+ * @param [in] size the bytes of buffer, at least tc_signature_share_size(info).
+ * @param [in] share the key share to be used in the signature operation.
+ * @param [in] doc the document to be signed.
+ * @param [in] info the metainfo of the key shares array.
+ *
+ * @return the signature share, at the start of buffer, or NULL if buffer is too small.
+ */
+signature_share_t *tc_node_sign_into(void *buffer, size_t size, const key_share_t *share, const bytes_t *doc,
+                                     const key_metainfo_t *info);
+
+/**
+ * Function that takes a signature share laid out by tc_node_sign_into, after its buffer has been copied or mapped at
+ * another address, as a shared memory ring buffer does between processes. The share is used in place, only its
+ * internal pointers are fixed, and it must not be deinitialized by tc_clear_signature_share.
+ *
+ * @param [in,out] buffer the bytes of the signature share, aligned like the memory returned by malloc.
+ * @param [in] size the bytes of buffer.
+ * @param [in] info the metainfo of the key the share is expected to be of.
+ *
+ * @return the signature share, at the start of buffer, or NULL if buffer can't hold a share of the key, or the share
+ * it describes has the size or the id of another key.
+ */
+signature_share_t *tc_signature_share_attach(void *buffer, size_t size, const key_metainfo_t *info);
+
+/**
+ * Function that generates the signature shares of one document with several key shares of the same key, as held by a
+ * node with more than one share. The result is the same as calling tc_node_sign with each share, but the values
+ * derived from the document are computed once, and the exponentiations of the shares share their squarings.
+ *
+ * @param [out] out the count signature shares, in the order of shares.
+ * @param [in] shares the key shares to be used in the signature operation.
+ * @param [in] count the number of key shares.
+ * @param [in] doc the document to be signed.
+ * @param [in] info the metainfo of the key shares array.
+ */
+void tc_node_sign_multi(signature_share_t **out, const key_share_t **shares, size_t count, const bytes_t *doc,
+                        const key_metainfo_t *info);
+
+/**
+ * Function that generates a signature share using a key share and the slim metainfo of its node. It behaves exactly
+ * like tc_node_sign, but it doesn't need the verification keys of the other nodes.
+ *
+ * @param [in] share the key share to be used in the signature operation.
+ * @param [in] doc the document to be signed.
+ * @param [in] info the signer metainfo of the node that owns share.
+ *
+ * @return a signature share.
+ */
+signature_share_t *tc_node_sign_slim(const key_share_t *share, const bytes_t *doc, const signer_metainfo_t *info);
+
+/**
+ * Function that generates the signature shares of several documents with the same key share. The result is the same
+ * as calling tc_node_sign on each document, but the modular exponentiations of the documents are computed together,
+ * several at a time, with the vector units of the CPU when it has them.
+ *
+ * @param [out] out array of count pointers, where the signature share of each document is stored.
+ * @param [in] share the key share to be used in the signature operation.
+ * @param [in] docs array of count documents to be signed.
+ * @param [in] count number of documents.
+ * @param [in] info the metainfo of the key shares array.
+ */
+void tc_node_sign_batch(signature_share_t **out, const key_share_t *share, const bytes_t **docs, size_t count,
+                        const key_metainfo_t *info);
+
+/**
+ * Function that computes once, for a prepared document and a key, the values that tc_node_sign_ctx,
+ * tc_verify_signature_ctx and tc_join_signatures_ctx would otherwise derive from the document on every call. The
+ * context doesn't refer to doc nor info, and can be used with any metainfo of the same key.
+ *
+ * @param [in] doc the prepared document.
+ * @param [in] info the metainfo of the key shares array.
+ *
+ * @return the document context, to be deinitialized by tc_clear_document_ctx.
+ */
+tc_document_ctx_t *tc_init_document_ctx(const bytes_t *doc, const key_metainfo_t *info);
+
+/**
+ * Releases a document context.
+ */
+void tc_clear_document_ctx(tc_document_ctx_t *ctx);
+
+/**
+ * Function that behaves like tc_node_sign, for the document of a document context.
+ *
+ * @param [in] share the key share to be used in the signature operation.
+ * @param [in] doc the context of the document to be signed.
+ * @param [in] info the metainfo of the key shares array.
+ *
+ * @return a signature share.
+ */
+signature_share_t *tc_node_sign_ctx(const key_share_t *share, const tc_document_ctx_t *doc,
+                                    const key_metainfo_t *info);
+
+/**
+ * Function that extracts the signer metainfo of the node id from the metainfo of the key shares array.
+ * The returned structure is independent of info, and should be deinitialized by tc_clear_signer_metainfo.
+ *
+ * @param [in] info the metainfo of the key shares array.
+ * @param [in] id the id of the node, between 1 and l.
+ *
+ * @return the signer metainfo of the node id.
+ */
+signer_metainfo_t *tc_extract_signer_metainfo(const key_metainfo_t *info, uint16_t id);
+
 /**
  * Function that takes several signature shares (at least the threshold number stored in info), and generates a 
  * standard RSA signature.
@@ -119,6 +434,49 @@ signature_share_t *tc_node_sign(const key_share_t *share, const bytes_t *doc, co
  */
 bytes_t *tc_join_signatures(const signature_share_t **signatures, const bytes_t *document, const key_metainfo_t *info);
 
+/**
+ * Function that behaves like tc_join_signatures, but writes the signature to a buffer of the caller. The signature is
+ * written as big-endian bytes padded with zeros to the length of the modulus, the data_len of tc_public_key_n, and it
+ * is verified as the signature of tc_join_signatures.
+ *
+ * @param [out] out the buffer for the signature.
+ * @param [in] len the bytes of out, at least the length of the modulus.
+ * @param [in] signatures an array of the needed number of signature shares to be joined.
+ * @param [in] document the prepared document to be signed.
+ * @param [in] info the key shares that were used to sign metainfo.
+ *
+ * @return 0 on success, -1 if out is too small.
+ */
+int tc_join_signatures_into(uint8_t *out, size_t len, const signature_share_t **signatures, const bytes_t *document,
+                            const key_metainfo_t *info);
+
+/**
+ * Function that behaves like tc_join_signatures, for the document of a document context.
+ *
+ * @param [in] signatures the signature shares to join, at least k of them.
+ * @param [in] doc the context of the signed document.
+ * @param [in] info the metainfo of the key shares array.
+ *
+ * @return a bytes_t structure with the regular RSA signature
+ */
+bytes_t *tc_join_signatures_ctx(const signature_share_t **signatures, const tc_document_ctx_t *doc,
+                                const key_metainfo_t *info);
+
+/**
+ * Function that joins the signature shares of several documents signed by the same nodes. The result is the same as
+ * calling tc_join_signatures on each document, but the coefficients of the signers are computed once, and the modular
+ * inversions of the documents are computed together.
+ *
+ * @param [out] out the count RSA signatures, in the order of docs.
+ * @param [in] signatures count rows of info->k signature shares, row i with the shares of docs[i]. Every row has the
+ * shares of the same nodes, in the same order.
+ * @param [in] docs the count prepared documents that have been signed.
+ * @param [in] count the number of documents.
+ * @param [in] info the metainfo of the key shares array used to sign.
+ */
+void tc_join_signatures_batch(bytes_t **out, const signature_share_t **signatures, const bytes_t **docs, size_t count,
+                              const key_metainfo_t *info);
+
 /**
  * Function that verifies that a signature share was generated by any key shares that shares the same key metainfo.
  * That means, any key shares that came from the same key_share array. 
@@ -131,6 +489,33 @@ bytes_t *tc_join_signatures(const signature_share_t **signatures, const bytes_t
  */
 int tc_verify_signature(const signature_share_t *signature, const bytes_t *doc, const key_metainfo_t *info);
 
+/**
+ * Function that behaves like tc_verify_signature, for the document of a document context. A combiner checking the k
+ * shares of a document only derives its values once.
+ *
+ * @param signature the signature to be verified.
+ * @param doc the context of the document used to generate the signature share.
+ * @param info the metainfo of the key shares array used to sign.
+ *
+ * @return 1 if the signature share was generated by any key from the original key shares array. 0 otherwise.
+ */
+int tc_verify_signature_ctx(const signature_share_t *signature, const tc_document_ctx_t *doc,
+                            const key_metainfo_t *info);
+
+/**
+ * Function that verifies several signature shares at once, each one against its own document. The results are the
+ * same as calling tc_verify_signature on each signature, but the modular exponentiations are computed together, as in
+ * tc_node_sign_batch.
+ *
+ * @param [out] results array of count integers, where 1 or 0 is stored as tc_verify_signature would return.
+ * @param [in] signatures array of count signature shares to be verified.
+ * @param [in] docs array of count documents, docs[i] is the document of signatures[i].
+ * @param [in] count number of signature shares.
+ * @param [in] info the metainfo of the key shares array used to sign.
+ */
+void tc_verify_signature_batch(int *results, const signature_share_t **signatures, const bytes_t **docs, size_t count,
+                               const key_metainfo_t *info);
+
 /**
  * Function that hashes and adds the PKCS1 padding to the document to be signed. This function should be only used in testing
  * environments. In production environments, any function that does the PSS padding should be used. Such functions are
@@ -144,6 +529,71 @@ int tc_verify_signature(const signature_share_t *signature, const bytes_t *doc,
  */
 bytes_t *tc_prepare_document(const bytes_t *doc, tc_hash_type_t hash_type, const key_metainfo_t *metainfo);
 
+/**
+ * Function that behaves like tc_prepare_document, but writes the prepared document to a buffer of the caller. It takes
+ * the length of the modulus, the data_len of tc_public_key_n.
+ *
+ * @param [out] out the buffer for the prepared document.
+ * @param [in] len the bytes of out, at least the length of the modulus.
+ * @param [in] doc the document to be prepared.
+ * @param [in] hash_type the hash function to be used in the document.
+ * @param [in] metainfo the metainfo of the key shares array, with the public key.
+ *
+ * @return 0 on success, -1 if out is too small.
+ */
+int tc_prepare_document_into(uint8_t *out, size_t len, const bytes_t *doc, tc_hash_type_t hash_type,
+                             const key_metainfo_t *metainfo);
+
+/**
+ * Function that prepares several documents, as tc_prepare_document does for each one, into a single array owned by
+ * the caller. The documents are hashed together, in the SIMD lanes of the CPU when it has them.
+ *
+ * Document i is prepared at out + i * len, where len is the length of the modulus in bytes, the data_len of
+ * tc_public_key_n. A bytes_t pointing there can be given to the signing functions.
+ *
+ * @param [out] out room for count prepared documents, count * len bytes.
+ * @param [in] docs the count documents to be prepared.
+ * @param [in] count the number of documents.
+ * @param [in] hash_type the hash function to be used in the documents.
+ * @param [in] metainfo the metainfo of the key shares array, with the public key.
+ */
+void tc_prepare_documents_batch(uint8_t *out, const bytes_t **docs, size_t count, tc_hash_type_t hash_type,
+                                const key_metainfo_t *metainfo);
+
+/**
+ * Function that starts to prepare a document that is given in pieces, as tc_prepare_document does. The memory used
+ * doesn't depend on the size of the document.
+ *
+ * @param [in] hash_type the hash function to be used in the document, it can't be TC_NONE.
+ * @param [in] metainfo the metainfo of the key shares array, with the public key.
+ *
+ * @return the preparation context, or NULL if the hash function isn't supported.
+ */
+tc_prepare_ctx_t *tc_init_prepare(tc_hash_type_t hash_type, const key_metainfo_t *metainfo);
+
+/**
+ * Function that adds the next len bytes of the document to a preparation.
+ */
+void tc_prepare_update(tc_prepare_ctx_t *ctx, const void *data, size_t len);
+
+/**
+ * Function that finishes a preparation, and releases its context.
+ *
+ * @return the prepared document, the same as tc_prepare_document returns for the whole document.
+ */
+bytes_t *tc_prepare_final(tc_prepare_ctx_t *ctx);
+
+/**
+ * Function that prepares the document stored in a file, reading it in pieces.
+ *
+ * @param [in] path the path of the file.
+ * @param [in] hash_type the hash function to be used in the document, it can't be TC_NONE.
+ * @param [in] metainfo the metainfo of the key shares array, with the public key.
+ *
+ * @return the prepared document, or NULL if the file can't be read or the hash function isn't supported.
+ */
+bytes_t *tc_prepare_file(const char *path, tc_hash_type_t hash_type, const key_metainfo_t *metainfo);
+
 /**
  * Function that verifies a standard RSA signature using the PKCS1 padding. Should be used only for testing purposed.
  *
@@ -156,6 +606,333 @@ bytes_t *tc_prepare_document(const bytes_t *doc, tc_hash_type_t hash_type, const
  */
 int tc_rsa_verify(bytes_t *signature, bytes_t *doc, key_metainfo_t *info, tc_hash_type_t hashtype);
 
+/**
+ * Function that decodes an RSA public key once, for the verification of standard RSA signatures.
+ *
+ * @param [in] pk the public key, it isn't referenced by the context.
+ *
+ * @return the public key context, to be deinitialized by tc_clear_public_key_ctx, or NULL if the modulus isn't odd.
+ */
+tc_public_key_ctx_t *tc_init_public_key_ctx(const public_key_t *pk);
+
+/**
+ * Releases a public key context.
+ */
+void tc_clear_public_key_ctx(tc_public_key_ctx_t *ctx);
+
+/**
+ * Function that verifies a standard RSA signature of a document that has already been prepared, as tc_prepare_document
+ * does.
+ *
+ * @param [in] ctx the public key context.
+ * @param [in] signature the signature to be verified.
+ * @param [in] prepared the prepared document.
+ *
+ * @return 1 if the signature verifies the document, 0 otherwise.
+ */
+int tc_rsa_verify_prepared(const tc_public_key_ctx_t *ctx, const bytes_t *signature, const bytes_t *prepared);
+
+/**
+ * Function that verifies several standard RSA signatures under the same key, each one against its own document. The
+ * results are the same as calling tc_rsa_verify on each signature, but the documents aren't prepared in allocated
+ * buffers, and the modular exponentiations are computed together, as in tc_verify_signature_batch.
+ *
+ * @param [out] results the result of each signature: 1 if it verifies its document, 0 otherwise.
+ * @param [in] ctx the public key context.
+ * @param [in] signatures the count signatures to be verified.
+ * @param [in] docs the signed documents, in the order of signatures.
+ * @param [in] count the number of signatures.
+ * @param [in] hash_type the hash function used in the PKCS1 padding.
+ */
+void tc_rsa_verify_batch(int *results, const tc_public_key_ctx_t *ctx, const bytes_t **signatures,
+                         const bytes_t **docs, size_t count, tc_hash_type_t hash_type);
+
+
+/* Engine */
+
+/*
+ * Every function of the library may be called from several threads at once, as long as no thread modifies an object
+ * that another one is using. Key metainfo, key shares and documents may be shared by any number of threads, the
+ * tables the library builds lazily for a key are published atomically. The functions that configure the library
+ * (tc_set_allocator, tc_set_backend, etc.) apply to every thread, and tc_set_allocator must not run concurrently with
+ * any other function.
+ *
+ * An engine runs operations in its own worker threads. The inputs of an operation are referenced, not copied, and
+ * must stay valid until its future is done.
+ */
+
+/**
+ * Function that starts a signing engine.
+ *
+ * @param [in] threads the number of worker threads.
+ * @param [in] queue_size the operations that can be queued at once, rounded up to a power of two.
+ * @param [in] pin if it isn't zero, each worker is pinned to one of the CPUs the process may run on.
+ *
+ * @return the engine, to be stopped by tc_clear_engine.
+ */
+tc_engine_t *tc_init_engine(int threads, size_t queue_size, int pin);
+
+/**
+ * Stops an engine once the operations already queued are done, and releases it. No operation may be submitted
+ * concurrently.
+ */
+void tc_clear_engine(tc_engine_t *engine);
+
+/**
+ * Submits tc_node_sign(share, doc, info) to an engine. It never blocks, any thread may submit.
+ *
+ * @return the future of the operation, or NULL if the queue of the engine is full.
+ */
+tc_future_t *tc_engine_sign(tc_engine_t *engine, const key_share_t *share, const bytes_t *doc,
+                            const key_metainfo_t *info);
+
+/**
+ * Submits tc_verify_signature(signature, doc, info) to an engine, like tc_engine_sign.
+ */
+tc_future_t *tc_engine_verify(tc_engine_t *engine, const signature_share_t *signature, const bytes_t *doc,
+                              const key_metainfo_t *info);
+
+/**
+ * Submits tc_join_signatures(signatures, doc, info) to an engine, like tc_engine_sign.
+ */
+tc_future_t *tc_engine_join(tc_engine_t *engine, const signature_share_t **signatures, const bytes_t *doc,
+                            const key_metainfo_t *info);
+
+/**
+ * @return 1 if the operation of the future is done, 0 otherwise. It never blocks.
+ */
+int tc_future_poll(const tc_future_t *future);
+
+/**
+ * Waits until the operation of the future is done.
+ */
+void tc_future_wait(tc_future_t *future);
+
+/**
+ * Waits for a future of tc_engine_sign.
+ *
+ * @return the signature share, owned by the caller.
+ */
+signature_share_t *tc_future_signature_share(tc_future_t *future);
+
+/**
+ * Waits for a future of tc_engine_verify.
+ *
+ * @return the result of tc_verify_signature.
+ */
+int tc_future_verified(tc_future_t *future);
+
+/**
+ * Waits for a future of tc_engine_join.
+ *
+ * @return the RSA signature, owned by the caller.
+ */
+bytes_t *tc_future_signature(tc_future_t *future);
+
+/**
+ * Waits for a future and releases it, but not its result, which is owned by the caller.
+ */
+void tc_clear_future(tc_future_t *future);
+
+/**
+ * Function that verifies k signature shares and joins them, for a combiner. The shares are verified in parallel by
+ * the workers of the engine while the calling thread joins them, on the assumption that they are valid; the
+ * signature is only returned if they are. The document is derived once, for the verifications and the join.
+ *
+ * @param [in] engine the engine whose workers verify the shares. If its queue is full, the calling thread verifies
+ * the shares it couldn't submit.
+ * @param [in] signatures the k signature shares.
+ * @param [in] doc the prepared document that was signed.
+ * @param [in] info the metainfo of the key shares array.
+ * @param [out] valid if it isn't NULL, array of k integers, where the result of tc_verify_signature for each share is
+ * stored.
+ *
+ * @return the RSA signature, as tc_join_signatures returns it, or NULL if any of the shares isn't valid.
+ */
+bytes_t *tc_engine_combine(tc_engine_t *engine, const signature_share_t **signatures, const bytes_t *doc,
+                           const key_metainfo_t *info, int *valid);
+
+/*
+ * A scheduler signs for many keys, grouping the requests for the same key share into batches for tc_node_sign_batch.
+ * The requests for a key share always go to the same worker, which keeps that key hot in its caches.
+ */
+
+/**
+ * Function that starts a key-affinity scheduler.
+ *
+ * @param [in] threads the number of worker threads.
+ * @param [in] queue_size the requests that can be queued at once for each worker, rounded up to a power of two.
+ * @param [in] max_batch the most requests signed in one batch, at most 64. A batch is signed as soon as it is full.
+ * @param [in] max_wait_us the longest a request is held waiting for others for the same key, in microseconds.
+ * @param [in] pin if it isn't zero, each worker is pinned to one of the CPUs the process may run on.
+ *
+ * @return the scheduler, to be stopped by tc_clear_scheduler.
+ */
+tc_scheduler_t *tc_init_scheduler(int threads, size_t queue_size, size_t max_batch, uint64_t max_wait_us, int pin);
+
+/**
+ * Stops a scheduler once the requests already queued are signed, without waiting for their batches to fill, and
+ * releases it. No request may be submitted concurrently.
+ */
+void tc_clear_scheduler(tc_scheduler_t *scheduler);
+
+/**
+ * Submits tc_node_sign(share, doc, info) to a scheduler. It never blocks, any thread may submit. The result is
+ * waited for with tc_future_signature_share, like the futures of tc_engine_sign.
+ *
+ * @return the future of the request, or NULL if the queue of the worker of the key share is full.
+ */
+tc_future_t *tc_scheduler_sign(tc_scheduler_t *scheduler, const key_share_t *share, const bytes_t *doc,
+                               const key_metainfo_t *info);
+
+/**
+ * Reads the batch size and added latency counters of a scheduler. Any thread may read them at any time.
+ */
+void tc_get_scheduler_stats(const tc_scheduler_t *scheduler, tc_scheduler_stats_t *stats);
+
+/*
+ * A completion queue lets an event loop submit operations to an engine without waiting for them. The queue has an
+ * eventfd that becomes readable when operations are done, to be watched with epoll, poll or select, after which
+ * tc_poll_completions returns them. A completion queue is owned by one thread, the one that polls it, but operations
+ * may be submitted to it from any thread.
+ */
+
+/**
+ * Function that creates a completion queue.
+ *
+ * @param [in] size the operations that may be pending at once, submitted and not polled yet, rounded up to a power of
+ * two.
+ *
+ * @return the completion queue, or NULL if the eventfd couldn't be created.
+ */
+tc_completion_queue_t *tc_init_completion_queue(size_t size);
+
+/**
+ * Releases a completion queue and closes its eventfd. Every operation submitted to it must have been polled.
+ */
+void tc_clear_completion_queue(tc_completion_queue_t *cq);
+
+/**
+ * @return the eventfd of the completion queue, readable when there are operations to poll. It is owned by the queue
+ * and it must not be read directly.
+ */
+int tc_completion_queue_fd(const tc_completion_queue_t *cq);
+
+/**
+ * Submits tc_node_sign(share, doc, info) to an engine, delivering its future to a completion queue once it is done.
+ * It never blocks. Until it is polled, the future must not be waited for or cleared.
+ *
+ * @return 0 on success, -1 if the completion queue or the queue of the engine is full.
+ */
+int tc_submit_sign(tc_engine_t *engine, tc_completion_queue_t *cq, const key_share_t *share, const bytes_t *doc,
+                   const key_metainfo_t *info, void *user_data);
+
+/**
+ * Submits tc_verify_signature(signature, doc, info) to an engine, like tc_submit_sign.
+ */
+int tc_submit_verify(tc_engine_t *engine, tc_completion_queue_t *cq, const signature_share_t *signature,
+                     const bytes_t *doc, const key_metainfo_t *info, void *user_data);
+
+/**
+ * Submits tc_join_signatures(signatures, doc, info) to an engine, like tc_submit_sign.
+ */
+int tc_submit_join(tc_engine_t *engine, tc_completion_queue_t *cq, const signature_share_t **signatures,
+                   const bytes_t *doc, const key_metainfo_t *info, void *user_data);
+
+/**
+ * Takes the operations of a completion queue that are done, and clears its eventfd. It never blocks. If it returns
+ * max, the eventfd is left readable so that the loop comes back for the rest.
+ *
+ * @param [out] out where the operations are stored.
+ * @param [in] max the most operations to take.
+ *
+ * @return the number of operations stored in out.
+ */
+size_t tc_poll_completions(tc_completion_queue_t *cq, tc_completion_t *out, size_t max);
+
+
+/* Shared memory rings */
+
+/*
+ * A shared memory ring carries messages between processes on the same machine, such as prepared documents to the
+ * signers and signature shares back to a combiner. Any number of processes may send to a ring, only one may receive
+ * from it. A sender can build a message in place, as with tc_node_sign_into followed by tc_shm_ring_commit, and the
+ * receiver uses it in place, as with tc_signature_share_attach, so a message is never copied. A receiver waiting on an
+ * empty ring sleeps on a futex, which senders only wake when it is asleep.
+ */
+
+/**
+ * Function that creates a shared memory ring, as a new POSIX shared memory object.
+ *
+ * @param [in] name the name of the object, as for shm_open: a slash followed by up to 254 other characters.
+ * @param [in] slots the messages the ring can hold at once, rounded up to a power of two.
+ * @param [in] slot_size the bytes each message may take, such as tc_signature_share_size of the key.
+ *
+ * @return the mapping of the ring, or NULL if the object exists or couldn't be created.
+ */
+tc_shm_ring_t *tc_shm_ring_create(const char *name, size_t slots, size_t slot_size);
+
+/**
+ * Function that maps a shared memory ring created by another process.
+ *
+ * @return the mapping of the ring, or NULL if it doesn't exist or isn't a ring of this version of the library.
+ */
+tc_shm_ring_t *tc_shm_ring_open(const char *name);
+
+/**
+ * Unmaps a shared memory ring. The ring remains until it is unlinked and every process has closed it.
+ */
+void tc_shm_ring_close(tc_shm_ring_t *ring);
+
+/**
+ * Removes the name of a shared memory ring, as shm_unlink does.
+ *
+ * @return 0 on success, -1 otherwise.
+ */
+int tc_shm_ring_unlink(const char *name);
+
+/**
+ * @return the bytes each message of the ring may take.
+ */
+size_t tc_shm_ring_slot_size(const tc_shm_ring_t *ring);
+
+/**
+ * Reserves the next slot of a ring for a message of len bytes, to be written in place and then committed. Other
+ * messages may be sent while it is reserved, but the receiver doesn't see the ones after it until it is committed.
+ *
+ * @return the slot, aligned to 64 bytes, or NULL if the ring is full or len is larger than its slot size.
+ */
+void *tc_shm_ring_reserve(tc_shm_ring_t *ring, size_t len);
+
+/**
+ * Commits a slot returned by tc_shm_ring_reserve, making its message visible to the receiver.
+ */
+void tc_shm_ring_commit(tc_shm_ring_t *ring, void *slot);
+
+/**
+ * Sends a copy of len bytes of data, like tc_shm_ring_reserve followed by tc_shm_ring_commit.
+ *
+ * @return 0 on success, -1 if the ring is full or len is larger than its slot size.
+ */
+int tc_shm_ring_send(tc_shm_ring_t *ring, const void *data, size_t len);
+
+/**
+ * Waits for the next message of a ring. The message is used in place, and must be released with tc_shm_ring_release
+ * before the next one is received. Only one process, and one thread of it, may receive from a ring. A message that
+ * claims to be longer than a slot is dropped.
+ *
+ * @param [out] len where the bytes of the message are stored.
+ * @param [in] timeout_ms the most milliseconds to wait, 0 to return at once, or a negative number to wait forever.
+ *
+ * @return the message, aligned to 64 bytes, or NULL if none arrived before the timeout.
+ */
+void *tc_shm_ring_receive(tc_shm_ring_t *ring, size_t *len, int timeout_ms);
+
+/**
+ * Releases the message returned by tc_shm_ring_receive, giving its slot back to the senders.
+ */
+void tc_shm_ring_release(tc_shm_ring_t *ring);
+
 
 /* Getters */
 
@@ -180,6 +957,20 @@ int tc_key_meta_info_l(const key_metainfo_t *i);
  */
 const public_key_t *tc_key_meta_info_public_key(const key_metainfo_t *i);
 
+/**
+ * @param [in] i the metainfo of a signer.
+ *
+ * @return the id of the node whose verification key is stored in i.
+ */
+int tc_signer_metainfo_id(const signer_metainfo_t *i);
+
+/**
+ * @param [in] i the metainfo of a signer.
+ *
+ * @return the public key structure of the key shares array
+ */
+const public_key_t *tc_signer_metainfo_public_key(const signer_metainfo_t *i);
+
 /**
  * @param [in] k a key share.
  *
@@ -218,6 +1009,15 @@ int tc_signature_share_id(const signature_share_t *s);
  */
 char *tc_bytes_b64(const bytes_t *b);
 
+/**
+ * @param [out] out the buffer for the C string.
+ * @param [in] len the chars of out, at least 4 * ((b->data_len + 2) / 3) + 1.
+ * @param [in] b a bytes_t structure.
+ *
+ * @returns 0 if the data of b was written to out in the Base64 format, -1 if out is too small.
+ */
+int tc_bytes_b64_into(char *out, size_t len, const bytes_t *b);
+
 /**
  * @param [in] s a C string in the Base64 format.
  *
@@ -231,10 +1031,14 @@ bytes_t *tc_b64_bytes(const char *s);
  *  Base64(version :: id :: n_len :: n :: si_len :: si)
  * SignatureShare:
  *  Base64(version :: id :: xi_len :: xi :: c_len :: c :: z_len :: z)
+ * SignatureShare, fixed length:
+ *  id :: n_len :: xi :: c :: z, with xi and c in n_len bytes, and z in 2 * n_len + 64 bytes
  * PublicKey:
  *  Bytes(n :: e :: m) -> pk_len :: pk
  * KeyMetainfo:
  *  Base64(version :: pk_len :: pk :: k :: l :: vk_len :: vk :: v0_len :: v0 :: ... :: v(l-1)_len :: v(l-1))
+ * SignerMetainfo:
+ *  Base64(version :: pk_len :: pk :: k :: l :: id :: vk_len :: vk :: vu_len :: vu :: vid_len :: vid)
  */
 
 /**
@@ -252,21 +1056,102 @@ char *tc_serialize_signature_share(const signature_share_t *ss);
  */
 char *tc_serialize_key_metainfo(const key_metainfo_t *kmi);
 
+/**
+ * Serializes a signer metainfo as a C string in the Base64 format
+ */
+char *tc_serialize_signer_metainfo(const signer_metainfo_t *smi);
+
 /**
  * Deserializes a key share from a C string in the Base64 format
  */
 key_share_t *tc_deserialize_key_share(const char *b64);
 
 /**
- * Deserializes a signature share from a C string in the Base64 format
+ * Deserializes a signature share from a C string in the Base64 format, or returns NULL if it is malformed. The
+ * numbers are serialized without leading zeros, so the share only takes as many limbs as its own fields need, which
+ * may be fewer than its key's.
  */
 signature_share_t *tc_deserialize_signature_share(const char *b64);
 
+/**
+ * Deserializes a signature share of a known key from a C string in the Base64 format. The share takes as many limbs
+ * as the key, like the shares of tc_node_sign, whatever the lengths of its fields.
+ *
+ * @param [in] b64 the serialized share.
+ * @param [in] info the metainfo of the key of the share.
+ *
+ * @return the signature share, or NULL if it is malformed, its numbers don't fit the key, or its id is out of it.
+ */
+signature_share_t *tc_deserialize_signature_share_for_key(const char *b64, const key_metainfo_t *info);
+
+/**
+ * Returns the bytes of a signature share of the key in the fixed length format, which has no version and no Base64,
+ * for transports between processes that already agree on the key.
+ */
+size_t tc_signature_share_fixed_size(const key_metainfo_t *info);
+
+/**
+ * Serializes a signature share of the key in the fixed length format. The numbers are big-endian and padded with
+ * zeros, so the bytes don't depend on the machine.
+ *
+ * @param [out] out the buffer, of tc_signature_share_fixed_size(info) bytes.
+ * @param [in] len the bytes of out.
+ * @param [in] ss the signature share.
+ * @param [in] info the metainfo of the key of the share.
+ *
+ * @return 0, or -1 if out is too small or the share isn't of the key.
+ */
+int tc_serialize_signature_share_fixed(void *out, size_t len, const signature_share_t *ss, const key_metainfo_t *info);
+
+/**
+ * Deserializes a signature share in the fixed length format, laid out in a buffer of the caller as
+ * tc_node_sign_into does.
+ *
+ * @param [out] buffer memory for the signature share, aligned like the memory returned by malloc.
+ * @param [in] size the bytes of buffer, at least tc_signature_share_size(info).
+ * @param [in] in the serialized share.
+ * @param [in] len the bytes of in.
+ * @param [in] info the metainfo of the key of the share.
+ *
+ * @return the signature share, at the start of buffer, or NULL if buffer is too small or in isn't a share of the key.
+ */
+signature_share_t *tc_deserialize_signature_share_fixed_into(void *buffer, size_t size, const void *in, size_t len,
+                                                             const key_metainfo_t *info);
+
 /**
  * Deserializes a key share from a C string in the Base64 format
  */
 key_metainfo_t *tc_deserialize_key_metainfo(const char *b64);
 
+/**
+ * Exports the precomputed tables of a key, building the ones it doesn't have yet within the budget set by
+ * tc_set_fixed_base_budget. The blob is meant to be stored next to the serialized metainfo, and loaded with
+ * tc_load_precomputation after a restart, so the first operations don't have to rebuild the tables. It is in the
+ * native format of the machine, and only loads on machines with the same limb size and byte order.
+ *
+ * @param [in] info the metainfo of the key.
+ *
+ * @return the blob, to be deinitialized with tc_clear_bytes.
+ */
+bytes_t *tc_serialize_precomputation(const key_metainfo_t *info);
+
+/**
+ * Maps a blob written from tc_serialize_precomputation, and uses its tables for the key. The tables are read in place
+ * from the mapping, which is kept until the metainfo is cleared. The blob is rejected if it was made for another key,
+ * by another version of the format, or on a different kind of machine; the key then builds its tables as usual.
+ *
+ * @param [in] info the metainfo of the key. At most one blob can be loaded for it.
+ * @param [in] path the file with the blob.
+ *
+ * @return 0 if the blob was loaded, -1 otherwise.
+ */
+int tc_load_precomputation(key_metainfo_t *info, const char *path);
+
+/**
+ * Deserializes a signer metainfo from a C string in the Base64 format
+ */
+signer_metainfo_t *tc_deserialize_signer_metainfo(const char *b64);
+
 /* Destructors */
 
 /**
@@ -293,6 +1178,11 @@ void tc_clear_bytes_n(bytes_t *bytes, ...);
  */
 void tc_clear_key_metainfo(key_metainfo_t *info);
 
+/**
+ * Clears the memory of the structure
+ */
+void tc_clear_signer_metainfo(signer_metainfo_t *info);
+
 /**
  * Clears the memory of the structure
  */
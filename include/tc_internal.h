@@ -1,52 +1,311 @@
 #ifndef TC_INTERNAL_H
 # define TC_INTERNAL_H
 
+#include <assert.h>
+#include <gmp.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "tc.h"
 
+/*
+ * Numbers are stored inline in their structures, as arrays of GMP limbs (least significant limb first) padded with
+ * zeros up to a fixed stride. The stride is derived from the size of the modulus n, so every structure is a single
+ * allocation. The big-endian representation is only used at the serialization boundary and for the public key.
+ */
+
+/* z = c*s_i + r is about twice as long as n, plus the 2*HASH_LEN*8 extra bits of r */
+#define TC_Z_EXTRA_LIMBS ((2 * 32 * 8) / GMP_NUMB_BITS + 1)
+#define TC_Z_LIMBS(n_limbs) (2 * (n_limbs) + TC_Z_EXTRA_LIMBS)
+#define TC_BYTES_TO_LIMBS(len) (((len) + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t))
+
 struct public_key {
-    bytes_t * n;
-    bytes_t * e;
+    bytes_t n;
+    bytes_t e;
+};
+
+struct mont_ctx;
+typedef void (*mont_redc_fn)(mp_limb_t *rp, mp_limb_t *tp, const struct mont_ctx *ctx);
+typedef void (*mont_mul_fn)(mp_limb_t *rp, const mp_limb_t *ap, const mp_limb_t *bp, mp_limb_t *tp,
+                            const struct mont_ctx *ctx);
+typedef void (*mont_sqr_fn)(mp_limb_t *rp, const mp_limb_t *ap, mp_limb_t *tp, const struct mont_ctx *ctx);
+
+/* Montgomery context of a modulus n, see montgomery.c. Numbers in the Montgomery form have size limbs. */
+struct mont_ctx {
+    mp_size_t size; /* Significant limbs of n */
+    mp_limb_t n_inv; /* -n^-1 mod B */
+    const mp_limb_t * n;
+    mp_limb_t * one; /* R mod n */
+    mp_limb_t * r2; /* R^2 mod n */
+    mont_redc_fn redc;
+    mont_mul_fn mul;
+    mont_sqr_fn sqr;
+};
+
+/* The public values of a key, shared by key_metainfo and signer_metainfo */
+struct key_params {
+    public_key_t public_key; /* Big-endian n and e, stored in the same allocation */
+    mp_size_t n_limbs; /* Stride of n, vk_v, vk_u and every vk_i */
+    mp_size_t e_limbs;
+    mp_limb_t * n;
+    mp_limb_t * e;
+    mp_limb_t * vk_v;
+    mp_limb_t * vk_u;
+    struct mont_ctx mont; /* Context of n, its tables are stored after vk_u */
+    _Atomic(void *) backend_ctx; /* Context of n for the alternative backend, created on first use */
+    _Atomic(struct fixed_base *) v_table; /* Fixed-base table of vk_v, built on first use */
 };
 
 struct key_metainfo {
-    public_key_t * public_key;
+    struct key_params params;
     uint16_t k;
     uint16_t l;
-    bytes_t * vk_v;
-    bytes_t * vk_u;
-    bytes_t * vk_i;
+    mp_limb_t * vk_i; /* l consecutive numbers */
+    _Atomic(struct fixed_base *) * vk_inverse_tables; /* l fixed-base tables of vk_i^-1, built on first use */
+    void * precomputation; /* Mapped precomputation blob the tables may point to, see precomputation.c */
+    size_t precomputation_len;
+};
+
+/* An RSA public key decoded for verification, see algorithms_rsa_verify.c. Only n and e of params are set. */
+struct public_key_ctx {
+    struct key_params params;
+};
+
+struct signer_metainfo {
+    struct key_params params;
+    uint16_t k;
+    uint16_t l;
+    uint16_t id;
+    mp_limb_t * vk_i;
 };
 
 struct key_share {
-    bytes_t * s_i;
-    bytes_t * n;
     uint16_t id;
+    mp_size_t n_limbs;
+    mp_limb_t * s_i;
 };
 
 struct signature_share {
-    bytes_t *x_i;
-    bytes_t *c;
-    bytes_t *z;
     uint16_t id;
+    mp_size_t n_limbs;
+    mp_limb_t * x_i; /* n_limbs */
+    mp_limb_t * c; /* n_limbs */
+    mp_limb_t * z; /* TC_Z_LIMBS(n_limbs) */
 };
 
+/* Values derived from a prepared document, see algorithms_document_ctx.c */
+struct document_ctx {
+    mp_size_t n_limbs;
+    int corrected; /* x is the document times u^e */
+    mp_limb_t * x; /* n_limbs */
+    mp_limb_t * x_tilde; /* n_limbs, x^4 mod n */
+};
+
+#define TC_VK_I(info, id) ((info)->vk_i + TC_ID_TO_INDEX(id) * (info)->params.n_limbs)
 
 #define TC_GET_OCTETS(z, bcount, op) mpz_import(z, bcount, 1, 1, 0, 0, op)
-#define TC_TO_OCTETS(count, op) mpz_export(NULL, count, 1, 1, 0, 0, op)
 #define TC_ID_TO_INDEX(id) (id-1)
 
+#define TC_OCTETS_SIZE(z) ((mpz_sizeinbase(z, 2) + 7) / 8)
+
 #define TC_MPZ_TO_BYTES(bytes, z) \
-    do { bytes_t * b = (bytes); size_t * len = (size_t*)&b->data_len; b->data = TC_TO_OCTETS(len, z); } while(0)
+    do { \
+        bytes_t * b = (bytes); size_t len; \
+        b->data = pool_alloc(TC_OCTETS_SIZE(z)); \
+        mpz_export(b->data, &len, 1, 1, 0, 0, z); \
+        b->data_len = len; \
+    } while(0)
 #define TC_BYTES_TO_MPZ(z, bytes) \
     do { const bytes_t * __b = (bytes); size_t len = __b->data_len; TC_GET_OCTETS(z, len, __b->data); } while(0)
 
+/* Read-only mpz view of the limbs, without copying them. Views must never be modified nor cleared. */
+#define TC_LIMBS_VIEW(z, limbs, count) mpz_roinit_n(z, limbs, count)
+#define TC_MPZ_TO_LIMBS(limbs, count, z) \
+    do { \
+        mp_limb_t * __l = (limbs); size_t __count = (count), __written; \
+        assert(mpz_sgn(z) >= 0 && mpz_size(z) <= __count); \
+        mpz_export(__l, &__written, -1, sizeof(mp_limb_t), 0, 0, z); \
+        memset(__l + __written, 0, (__count - __written) * sizeof(mp_limb_t)); \
+    } while(0)
+
 void *alloc(size_t size);
-public_key_t *tc_init_public_key();
-key_metainfo_t *tc_init_key_metainfo(uint16_t k, uint16_t l);
-signature_share_t *tc_init_signature_share();
-key_share_t *tc_init_key_share();
+void *ralloc(void *ptr, size_t size);
+void *pool_alloc(size_t size);
+void pool_free(void *ptr, size_t size);
+size_t tc_limbs_to_bytes(uint8_t *out, const mp_limb_t *limbs, mp_size_t count);
+void tc_mpz_to_fixed_bytes(uint8_t *out, size_t len, mpz_srcptr z);
+size_t tc_limbs_bytes_len(const mp_limb_t *limbs, mp_size_t count);
+void tc_bytes_to_limbs(mp_limb_t *limbs, mp_size_t count, const uint8_t *bytes, size_t len);
+void tc_set_public_key(struct key_params *params);
+void pkcs1_prepare(uint8_t *out, size_t len, const bytes_t *doc, tc_hash_type_t hash_type);
+
+int workspace_begin(mp_size_t n_limbs);
+mpz_ptr workspace_take(void);
+void workspace_end(int mark);
+const uint8_t *workspace_octets(size_t *len, const mpz_t z);
+mp_limb_t *workspace_limbs(mp_size_t count);
+
+void mont_init(struct mont_ctx *ctx, const mp_limb_t *n, mp_size_t n_limbs);
+mp_size_t mont_scratch_size(const struct mont_ctx *ctx);
+void mont_powm_limbs(mp_limb_t *rp, const mp_limb_t *bp, const mp_limb_t *ep, mp_bitcnt_t bits,
+                     const struct mont_ctx *ctx, mp_limb_t *scratch);
+void mont_powm_ui(mpz_ptr r, mpz_srcptr b, unsigned long e, const struct mont_ctx *ctx);
+void mont_powm(mpz_ptr r, mpz_srcptr b, mpz_srcptr e, const struct mont_ctx *ctx);
+void mont_multi_powm(mpz_ptr *r, mpz_srcptr b, mpz_srcptr *e, size_t count, const struct mont_ctx *ctx);
+
+/*
+ * Lim-Lee comb table of a fixed base g, see fixed_base.c. The table is either in the same allocation, or in a mapped
+ * precomputation blob.
+ */
+struct fixed_base {
+    int h; /* Rows of the exponent */
+    int v; /* Blocks of each row */
+    mp_bitcnt_t a; /* Bits of each row */
+    mp_bitcnt_t b; /* Bits of each block */
+    mp_bitcnt_t bits; /* Largest exponent the table covers */
+    mp_size_t size; /* Limbs of each entry */
+    const mp_limb_t *table; /* G[j][u] in the Montgomery form, at ((j << h) + u) * size. G[j][0] is unused. */
+};
+
+#define FIXED_BASE_LIMBS(h, v, size) (((size_t) (v) << (h)) * (size))
+#define FIXED_BASE_VK_BITS (32 * 8) /* The challenges are lower than 2^256 */
+
+int fixed_base_valid_shape(const struct fixed_base *fb);
+mp_bitcnt_t fixed_base_v_bits(const struct key_params *params);
+const struct fixed_base *fixed_base_v(const struct key_params *params);
+const struct fixed_base *fixed_base_vk_inverse(const key_metainfo_t *info, uint16_t id);
+int fixed_base_powm(mpz_ptr r, mpz_srcptr e, const struct fixed_base *fb, const struct key_params *params);
+void fixed_base_clear_key_params(struct key_params *params);
+void fixed_base_clear_key_metainfo(key_metainfo_t *info);
+void precomputation_clear(key_metainfo_t *info);
+
+/* Multi-buffer exponentiation, see multibuffer.c. The vector kernels need 64-bit limbs and x86-64. */
+#if GMP_NUMB_BITS == 64 && defined(__x86_64__) && defined(__GNUC__)
+#define MB_KERNELS
+#endif
+
+#define MB_MAX_LANES 8
+
+enum mb_kernel_id {
+    MB_KERNEL_AUTO = -1,
+    MB_KERNEL_SCALAR = 0,
+    MB_KERNEL_AVX2,
+    MB_KERNEL_IFMA,
+};
+
+/*
+ * Operands shared by the lanes of a kernel. n and rr = R^2 mod n are plain arrays of digits, e holds the exponents
+ * interleaved by limb (limb k of lane j at e[k * lanes + j]), with a zero limb past the longest one, 64-byte aligned.
+ */
+struct mb_args {
+    int digits;
+    const uint64_t *n;
+    const uint64_t *rr;
+    uint64_t k0; /* -n^-1 mod 2^digit_bits */
+    const uint64_t *e;
+    mp_bitcnt_t e_bits; /* Bits of the longest exponent, at least 1 */
+};
+
+#ifdef MB_KERNELS
+size_t mb_avx2_scratch_size(int digits);
+void mb_avx2_powm(uint64_t *r, const uint64_t *b, const struct mb_args *args, void *scratch);
+size_t mb_ifma_scratch_size(int digits);
+void mb_ifma_powm(uint64_t *r, const uint64_t *b, const struct mb_args *args, void *scratch);
+#endif
+
+int mb_set_kernel(int id);
+int mb_get_kernel(void);
+int mb_lanes(void);
+void mb_powm(mpz_ptr *r, mpz_srcptr *b, mpz_srcptr *e, size_t count, const struct key_params *params);
+
+/* Multi-buffer SHA-256, see multibuffer_sha256.c. MB_KERNEL_AUTO selects the widest kernel. */
+enum mb_sha256_kernel_id {
+    MB_SHA256_SCALAR = 0,
+    MB_SHA256_AVX2,
+    MB_SHA256_AVX512,
+};
+
+int mb_sha256_set_kernel(int id);
+int mb_sha256_get_kernel(void);
+void mb_sha256(uint8_t (*digests)[32], const bytes_t **docs, size_t count);
+
+int document_x(mpz_ptr x, mpz_ptr x_tilde, const bytes_t *doc, const struct key_params *params);
+int document_load(mpz_ptr x, mpz_ptr x_tilde, const bytes_t *doc, const tc_document_ctx_t *ctx,
+                  const struct key_params *params);
+
+void proof_challenge(mpz_ptr c, mpz_srcptr v, mpz_srcptr u, mpz_srcptr x_tilde, mpz_srcptr vk_i, mpz_srcptr xi_2,
+                     mpz_srcptr v_prime, mpz_srcptr x_prime, mpz_srcptr n);
+
+void backend_powm(mpz_ptr r, mpz_srcptr b, mpz_srcptr e, const struct key_params *params);
+void backend_multi_powm(mpz_ptr *r, mpz_srcptr b, mpz_srcptr *e, size_t count, const struct key_params *params);
+void backend_safe_prime(mpz_ptr out, int bit_len);
+void backend_clear_key_params(struct key_params *params);
+
+#ifdef TC_HAVE_OPENSSL
+void bn_powm(mpz_ptr r, mpz_srcptr b, mpz_srcptr e, const struct key_params *params);
+void bn_safe_prime(mpz_ptr out, int bit_len);
+void bn_clear_key_params(struct key_params *params);
+#endif
+
+key_metainfo_t *tc_init_key_metainfo(uint16_t k, uint16_t l, mp_size_t n_limbs, mp_size_t e_limbs);
+signer_metainfo_t *tc_init_signer_metainfo(uint16_t k, uint16_t l, uint16_t id, mp_size_t n_limbs,
+                                           mp_size_t e_limbs);
+signature_share_t *tc_init_signature_share(mp_size_t n_limbs);
+signature_share_t *signature_share_in(void *buffer, mp_size_t n_limbs);
+key_share_t *tc_init_key_share(mp_size_t n_limbs);
 key_share_t **tc_init_key_shares(key_metainfo_t *info);
 
+/* Futures, the bounded MPMC ring and the worker threads of the engine, see engine.c */
+enum task_kind {
+    TASK_SIGN,
+    TASK_VERIFY,
+    TASK_JOIN,
+};
+
+struct future {
+    atomic_int state;
+    enum task_kind kind;
+    const key_share_t * share;
+    const signature_share_t * signature;
+    const signature_share_t ** signatures;
+    const bytes_t * doc;
+    const tc_document_ctx_t * ctx; /* Instead of doc if it isn't NULL */
+    const key_metainfo_t * info;
+    uint64_t submitted; /* CLOCK_MONOTONIC nanoseconds, for the scheduler */
+    tc_completion_queue_t * cq; /* Where the future is delivered once done, if it isn't NULL */
+    void * user_data;
+    union {
+        signature_share_t * share;
+        int verified;
+        bytes_t * signature;
+    } result;
+};
+
+struct ring_cell {
+    atomic_size_t sequence;
+    void * item;
+};
+
+struct ring {
+    struct ring_cell * cells;
+    size_t mask;
+    _Alignas(64) atomic_size_t enqueue_pos;
+    _Alignas(64) atomic_size_t dequeue_pos;
+};
+
+void ring_init(struct ring *ring, size_t size);
+void ring_clear(struct ring *ring);
+int ring_push(struct ring *ring, void *item);
+void *ring_pop(struct ring *ring);
+int ring_drained(struct ring *ring);
+
+tc_future_t *future_new(enum task_kind kind);
+void future_complete(tc_future_t *future);
+tc_future_t *engine_submit(tc_engine_t *engine, tc_future_t *future);
+void completion_queue_deliver(tc_completion_queue_t *cq, tc_future_t *future);
+void start_worker(pthread_t *thread, void *(*fn)(void *), void *arg, int index, int pin);
+
 #endif
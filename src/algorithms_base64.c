@@ -30,17 +30,17 @@ static const char lookup_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqr
 static const char pad = '=';
 
 
-static char *b64_encode (const uint8_t * buffer, size_t len )
+/* For each 3 byte input->4 byte char output, plus the null-byte termination. */
+static size_t b64_size(size_t len) {
+    return 4*((len + 2)/3) + 1;
+}
+
+/* Writes the Base64 of buffer to out, with room for b64_size(len) chars. */
+static void b64_encode_into (char *out, const uint8_t * buffer, size_t len )
 {
     /* In Base 64 we represent 6 bits with each character */
     uint32_t temp;
-    char *out, *p;
-
-    // For each 3 byte input->4 byte char output. if there still need for 1 or 2 extra bytes,
-    // you need 4 extra bytes. The last 1 extra byte is for null-byte termination.
-    size_t buf_len = 4*(len/3) + 4 + 1;
-
-    p = out = alloc(buf_len);
+    char *p = out;
 
     const uint8_t * cur = buffer;
     for(size_t i = 0; i < len/3; i++) {
@@ -71,7 +71,12 @@ static char *b64_encode (const uint8_t * buffer, size_t len )
 	break;
     }
     *p = '\0';
+}
 
+static char *b64_encode (const uint8_t * buffer, size_t len )
+{
+    char *out = alloc(b64_size(len));
+    b64_encode_into(out, buffer, len);
     return out;
 }
 
@@ -85,7 +90,7 @@ static size_t b64_length(const char *input, size_t len) {
 
 static uint8_t *b64_decode ( const char *input, size_t len , size_t *out_size)
 {
-    if ( len % 4 ) { 
+    if ( len == 0 || len % 4 ) {
 	return NULL;
     }
 
@@ -133,7 +138,7 @@ static uint8_t *b64_decode ( const char *input, size_t len , size_t *out_size)
     return out;
 
 on_error:
-    free(out);
+    tc_free(out);
     return NULL;
 }
 
@@ -141,6 +146,14 @@ char *tc_bytes_b64(const bytes_t * b) {
     return b64_encode(b->data, b->data_len);
 }
 
+int tc_bytes_b64_into(char *out, size_t len, const bytes_t * b) {
+    if (len < b64_size(b->data_len)) {
+        return -1;
+    }
+    b64_encode_into(out, b->data, b->data_len);
+    return 0;
+}
+
 bytes_t * tc_b64_bytes(const char *b64){
     size_t b64_len = strlen(b64);
 
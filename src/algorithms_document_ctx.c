@@ -0,0 +1,82 @@
+#include <assert.h>
+#include <gmp.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * The values every algorithm derives from the prepared document: x is the document, multiplied by u^e when its Jacobi
+ * symbol is -1 so that it becomes 1, and x~ = x^4. A document context computes them once for sign, verify and join.
+ */
+
+/* Sets x and, if it isn't NULL, x_tilde from the document. Returns 1 if x was multiplied by u^e. */
+int document_x(mpz_ptr x, mpz_ptr x_tilde, const bytes_t * doc, const struct key_params * params) {
+    int mark = workspace_begin(params->n_limbs);
+    mpz_t n, e, u;
+    TC_LIMBS_VIEW(n, params->n, params->n_limbs);
+    TC_LIMBS_VIEW(e, params->e, params->e_limbs);
+    TC_LIMBS_VIEW(u, params->vk_u, params->n_limbs);
+
+    TC_BYTES_TO_MPZ(x, doc);
+
+    // x = doc if (doc | n) == 1 else doc * u^e
+    int corrected = 0;
+    if(mpz_jacobi(x, n) == -1) {
+        mpz_ptr ue = workspace_take();
+        backend_powm(ue, u, e, params);
+        mpz_mul(x, x, ue);
+        mpz_mod(x, x, n);
+        corrected = 1;
+    }
+
+    // x~ = x^4 % n
+    if (x_tilde != NULL) {
+        mpz_powm_ui(x_tilde, x, 4ul, n);
+    }
+
+    workspace_end(mark);
+    return corrected;
+}
+
+/* Like document_x, but from the context of the document if it isn't NULL. */
+int document_load(mpz_ptr x, mpz_ptr x_tilde, const bytes_t * doc, const tc_document_ctx_t * ctx,
+                  const struct key_params * params) {
+    if (ctx == NULL) {
+        return document_x(x, x_tilde, doc, params);
+    }
+
+    assert(ctx->n_limbs == params->n_limbs);
+    mpz_t view;
+    TC_LIMBS_VIEW(view, ctx->x, ctx->n_limbs);
+    mpz_set(x, view);
+    if (x_tilde != NULL) {
+        TC_LIMBS_VIEW(view, ctx->x_tilde, ctx->n_limbs);
+        mpz_set(x_tilde, view);
+    }
+    return ctx->corrected;
+}
+
+tc_document_ctx_t * tc_init_document_ctx(const bytes_t * doc, const key_metainfo_t * info) {
+    assert(doc != NULL && doc->data != NULL);
+    assert(info != NULL);
+
+    mp_size_t n_limbs = info->params.n_limbs;
+    tc_document_ctx_t * ctx = alloc(sizeof(tc_document_ctx_t) + 2 * n_limbs * sizeof(mp_limb_t));
+    ctx->n_limbs = n_limbs;
+    ctx->x = (mp_limb_t *) (ctx + 1);
+    ctx->x_tilde = ctx->x + n_limbs;
+
+    int mark = workspace_begin(n_limbs);
+    mpz_ptr x = workspace_take(), x_tilde = workspace_take();
+    ctx->corrected = document_x(x, x_tilde, doc, &info->params);
+    TC_MPZ_TO_LIMBS(ctx->x, n_limbs, x);
+    TC_MPZ_TO_LIMBS(ctx->x_tilde, n_limbs, x_tilde);
+    workspace_end(mark);
+
+    return ctx;
+}
+
+void tc_clear_document_ctx(tc_document_ctx_t * ctx) {
+    assert(ctx != NULL);
+    tc_free(ctx);
+}
@@ -62,9 +62,6 @@ key_share_t **tc_generate_keys(key_metainfo_t **out, size_t bit_size, uint16_t k
     assert(k <= l);
     assert(l / 2 + 1 <= k);
 
-    key_metainfo_t *info = *out = tc_init_key_metainfo(k, l);
-    key_share_t **ks = tc_init_key_shares(info);
-
     static const int F4 = 65537; // Fermat fourth number.
 
     size_t p_prime_size = (bit_size + 1) / 2;
@@ -92,8 +89,8 @@ key_share_t **tc_generate_keys(key_metainfo_t **out, size_t bit_size, uint16_t k
     mpz_init(vk_i);
 #endif
 
-    generate_safe_prime(p, p_prime_size, random_dev);
-    generate_safe_prime(q, q_prime_size, random_dev);
+    backend_safe_prime(p, p_prime_size);
+    backend_safe_prime(q, q_prime_size);
 
     // p' = (p-1)/2
     mpz_sub_ui(pr, p, 1);
@@ -106,8 +103,6 @@ key_share_t **tc_generate_keys(key_metainfo_t **out, size_t bit_size, uint16_t k
     // n = p * q, m = p' * q'
     mpz_mul(n, p, q);
     mpz_mul(m, pr, qr);
-    
-    TC_MPZ_TO_BYTES(info->public_key->n, n);
 
     mpz_set_ui(ll, l);
 
@@ -123,7 +118,13 @@ key_share_t **tc_generate_keys(key_metainfo_t **out, size_t bit_size, uint16_t k
         mpz_set_ui(e, F4); // l is always less than 65537 (l is an uint16_t)
     }
 
-    TC_MPZ_TO_BYTES(info->public_key->e, e);
+    key_metainfo_t *info = *out = tc_init_key_metainfo(k, l, mpz_size(n), mpz_size(e));
+    key_share_t **ks = tc_init_key_shares(info);
+    mp_size_t n_limbs = info->params.n_limbs;
+
+    TC_MPZ_TO_LIMBS(info->params.n, n_limbs, n);
+    TC_MPZ_TO_LIMBS(info->params.e, info->params.e_limbs, e);
+    tc_set_public_key(&info->params);
 
     // d = e^{-1} mod m
     mpz_invert(d, e, m);
@@ -134,14 +135,14 @@ key_share_t **tc_generate_keys(key_metainfo_t **out, size_t bit_size, uint16_t k
 	mpz_gcd(divisor, r, n);
     } while (mpz_cmp_ui(divisor, 1) != 0);
     mpz_powm_ui(vk_v, r, 2, n);
-    TC_MPZ_TO_BYTES(info->vk_v, vk_v);
+    TC_MPZ_TO_LIMBS(info->params.vk_v, n_limbs, vk_v);
 
     // Generate u
     do {
 	random_dev(vk_u, mpz_sizeinbase(n, 2));
 	mpz_mod(vk_u, vk_u, n);
     } while (mpz_jacobi(vk_u, n) != -1);
-    TC_MPZ_TO_BYTES(info->vk_u, vk_u);
+    TC_MPZ_TO_LIMBS(info->params.vk_u, n_limbs, vk_u);
 
     // Delta = l!
     mpz_fac_ui(delta_inv, l);
@@ -150,7 +151,8 @@ key_share_t **tc_generate_keys(key_metainfo_t **out, size_t bit_size, uint16_t k
     // Generate Polynomial with random coefficients
     poly_t *poly = create_random_poly(d, info->k-1, m);
 
-    // Calculate Key Shares
+    // Calculate Key Shares, every vk_i is a power of v
+    const struct fixed_base * v_table = fixed_base_v(&info->params);
     for(int i=1; i <= info->l; i++) {
 	key_share_t * key_share = ks[TC_ID_TO_INDEX(i)];
 	key_share->id = i;
@@ -159,11 +161,12 @@ key_share_t **tc_generate_keys(key_metainfo_t **out, size_t bit_size, uint16_t k
 	mpz_mul(s_i, s_i, delta_inv);
 	mpz_mod(s_i, s_i, m);
 
-	TC_MPZ_TO_BYTES(key_share->s_i, s_i);
-	TC_MPZ_TO_BYTES(key_share->n, n);
+	TC_MPZ_TO_LIMBS(key_share->s_i, n_limbs, s_i);
 
-	mpz_powm(vk_i, vk_v, s_i, n);
-	TC_MPZ_TO_BYTES(&info->vk_i[TC_ID_TO_INDEX(i)], vk_i);
+	if (!fixed_base_powm(vk_i, s_i, v_table, &info->params)) {
+	    backend_powm(vk_i, vk_v, s_i, &info->params);
+	}
+	TC_MPZ_TO_LIMBS(TC_VK_I(info, i), n_limbs, vk_i);
     }
 
     clear_poly(poly);
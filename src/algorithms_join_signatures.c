@@ -14,134 +14,211 @@ void lagrange_interpolation(mpz_t out, int j, int k,
  * TODO: verify if the array has less than info->l signatures.
  */
 
-/**
- * @param out the result of the algorithm.
- * @param document the document that has been signed.
- * @param signatures the array of pointers to si shares, that are received.
- * @param k the number of si shares received.
- * @param pk a pointer to the public key of this process
- * @param info a pointer to the meta info of the key set
+/*
+ * The signature is y = w^a * x^b * u^-1 if x was corrected, with w = prod x_i^(2*lambda_i) over the signers, and
+ * 4a + eb = 1. The exponents 2*lambda_i*a and b don't depend on the document, only on the signers, so they are computed
+ * once for JOIN_DOCUMENTS documents signed by the same subset, and the exponentiations of a signer for those documents
+ * are computed MB_MAX_LANES at a time by mb_powm.
+ *
+ * Some of those exponents are negative. Instead of inverting each base, the powers with a negative exponent are
+ * gathered in a denominator, y = num / den, and the denominators of the JOIN_DOCUMENTS documents are inverted together
+ * with Montgomery's trick: a single inversion and three multiplications per document.
  */
-bytes_t * tc_join_signatures(const signature_share_t ** signatures,
-			     const bytes_t * document, const key_metainfo_t * info) {
-    assert(signatures != NULL);
-#ifndef NDEBUG
-    for (int i = 0; i < info->k; i++) {
-	assert(signatures[i] != NULL);
+
+/* Documents joined at once, each takes four workspace variables */
+#define JOIN_DOCUMENTS 16
+
+/* Exponentiations waiting for mb_powm, each multiplied into its target once computed */
+struct join_queue {
+    size_t count;
+    mpz_ptr results[MB_MAX_LANES];
+    const mp_limb_t * bases[MB_MAX_LANES]; /* Limbs of the bases, viewed when the queue is flushed */
+    mp_size_t base_sizes[MB_MAX_LANES];
+    mpz_srcptr exponents[MB_MAX_LANES];
+    mpz_ptr targets[MB_MAX_LANES];
+};
+
+static void join_flush(struct join_queue * queue, mpz_srcptr n, const struct key_params * params) {
+    mpz_t views[MB_MAX_LANES];
+    mpz_srcptr bases[MB_MAX_LANES];
+    for (size_t i = 0; i < queue->count; i++) {
+        TC_LIMBS_VIEW(views[i], queue->bases[i], queue->base_sizes[i]);
+        bases[i] = views[i];
     }
-#endif
-    assert(document != NULL && document->data != NULL);
+    mb_powm(queue->results, bases, queue->exponents, queue->count, params);
+    for (size_t i = 0; i < queue->count; i++) {
+        mpz_mul(queue->targets[i], queue->targets[i], queue->results[i]);
+        mpz_mod(queue->targets[i], queue->targets[i], n);
+    }
+    queue->count = 0;
+}
+
+/* target *= base^exponent mod n, eventually. */
+static void join_push(struct join_queue * queue, mpz_ptr target, const mp_limb_t * base, mp_size_t base_size,
+                      mpz_srcptr exponent, mpz_srcptr n, const struct key_params * params) {
+    if (mpz_sgn(exponent) == 0) {
+        return;
+    }
+    queue->targets[queue->count] = target;
+    queue->bases[queue->count] = base;
+    queue->base_sizes[queue->count] = base_size;
+    queue->exponents[queue->count] = exponent;
+    queue->count++;
+    if (queue->count == MB_MAX_LANES) {
+        join_flush(queue, n, params);
+    }
+}
+
+/*
+ * Joins count documents, the signatures of document i are signatures[i * k, (i + 1) * k). The signature of document i
+ * is allocated in out[i], or written to fixed + i * |n| padded to the length of n if fixed isn't NULL.
+ */
+static void join_batch(bytes_t ** out, uint8_t * fixed, const signature_share_t ** signatures, const bytes_t ** docs,
+                       const tc_document_ctx_t ** ctxs, size_t count, const key_metainfo_t * info) {
+    assert(signatures != NULL);
+    assert(docs != NULL || ctxs != NULL);
     assert(info != NULL);
 
-    bytes_t * out = tc_init_bytes(NULL, 0);
-
-    mpz_t x, n, e, u, delta, e_prime, w, s_i, lambda_k_2, aux, a, b, wa, xb, y;
-#if (__GNU_MP_VERSION >= 5)
-    mpz_inits(x, n, e, u, delta, e_prime, w, s_i, lambda_k_2, aux, a, b, wa, xb, y,
-	      NULL);
-#else
-    mpz_init(x);
-    mpz_init(n);
-    mpz_init(e);
-    mpz_init(u);
-    mpz_init(delta);
-    mpz_init(e_prime);
-    mpz_init(w);
-    mpz_init(s_i);
-    mpz_init(lambda_k_2);
-    mpz_init(aux);
-    mpz_init(a);
-    mpz_init(b);
-    mpz_init(wa);
-    mpz_init(xb);
-    mpz_init(y);
-#endif
+    const struct key_params * params = &info->params;
+    const int k = info->k;
 
-    TC_BYTES_TO_MPZ(x, document);
-    TC_BYTES_TO_MPZ(n, info->public_key->n);
-    TC_BYTES_TO_MPZ(e, info->public_key->e);
-    TC_BYTES_TO_MPZ(u, info->vk_u);
-
-    // x = doc if (doc | n) == 1 else doc * u^e
-    int jacobied = 0;
-    if(mpz_jacobi(x, n) == -1) {
-	mpz_t ue;
-	mpz_init(ue);
-	mpz_powm(ue, u, e, n);
-	mpz_mul(x, x, ue);
-	mpz_mod(x, x, n);
-	mpz_clear(ue);
-	jacobied = 1;
+#ifndef NDEBUG
+    for (size_t i = 0; i < count; i++) {
+        assert(ctxs != NULL || (docs[i] != NULL && docs[i]->data != NULL));
+        for (int j = 0; j < k; j++) {
+            assert(signatures[i * k + j] != NULL);
+            assert(signatures[i * k + j]->id == signatures[j]->id);
+        }
     }
+#endif
+
+    int mark = workspace_begin(params->n_limbs);
+    mpz_ptr delta = workspace_take(), e_prime = workspace_take(), gcd = workspace_take(), a = workspace_take(),
+            b = workspace_take(), inverse = workspace_take(), exponent = workspace_take();
+    mpz_t n, e, u;
+    TC_LIMBS_VIEW(n, params->n, params->n_limbs);
+    TC_LIMBS_VIEW(e, params->e, params->e_limbs);
+    TC_LIMBS_VIEW(u, params->vk_u, params->n_limbs);
 
     mpz_fac_ui(delta, info->l);
     mpz_set_ui(e_prime, 4);
+    mpz_gcdext(gcd, a, b, e_prime, e);
 
-    /* Calculate w */
-    mpz_set_si(w, 1);
-
-    int k = info->k;
-    for (int i = 0; i < k; i++) {
-	int id = signatures[i]->id;
-	TC_BYTES_TO_MPZ(s_i, signatures[i]->x_i);
-	lagrange_interpolation(lambda_k_2, id, k, signatures, delta);
-	mpz_mul_ui(lambda_k_2, lambda_k_2, 2);
+    int b_negative = mpz_sgn(b) < 0;
+    mpz_abs(b, b);
 
-	mpz_powm(aux, s_i, lambda_k_2, n);
-	mpz_mul(w, w, aux);
+    struct join_queue queue = {.count = 0};
+    for (size_t i = 0; i < MB_MAX_LANES; i++) {
+        queue.results[i] = workspace_take();
     }
-    mpz_mod(w, w, n);
-
-    mpz_gcdext(aux, a, b, e_prime, e);
-
-    mpz_powm(wa, w, a, n);
-    mpz_powm(xb, x, b, n);
 
-    mpz_mul(y, wa, xb);
-
-    if (jacobied) {
-	mpz_t inv_u;
-	mpz_init(inv_u);
-	mpz_invert(inv_u, u, n);
-	mpz_mul(y, y, inv_u);
-	mpz_clear(inv_u);
+    for (size_t first = 0; first < count; first += JOIN_DOCUMENTS) {
+        size_t m = count - first < JOIN_DOCUMENTS ? count - first : JOIN_DOCUMENTS;
+        int chunk_mark = workspace_begin(params->n_limbs);
+        mpz_ptr x[JOIN_DOCUMENTS], num[JOIN_DOCUMENTS], den[JOIN_DOCUMENTS], prefix[JOIN_DOCUMENTS];
+
+        for (size_t d = 0; d < m; d++) {
+            size_t i = first + d;
+            x[d] = workspace_take(), num[d] = workspace_take(), den[d] = workspace_take();
+            prefix[d] = workspace_take();
+            mpz_set_ui(num[d], 1);
+            mpz_set_ui(den[d], 1);
+
+            // x = doc if (doc | n) == 1 else doc * u^e, the correction is undone with u^-1
+            if (document_load(x[d], NULL, docs ? docs[i] : NULL, ctxs ? ctxs[i] : NULL, params)) {
+                mpz_set(den[d], u);
+            }
+        }
+
+        /* x_i^(2 * lambda_i * a) of one signer for every document, the coefficient is computed once per chunk */
+        for (int j = 0; j < k; j++) {
+            lagrange_interpolation(exponent, signatures[j]->id, k, signatures, delta);
+            mpz_mul_ui(exponent, exponent, 2);
+            mpz_mul(exponent, exponent, a);
+            int negative = mpz_sgn(exponent) < 0;
+            mpz_abs(exponent, exponent);
+
+            for (size_t d = 0; d < m; d++) {
+                const signature_share_t * share = signatures[(first + d) * k + j];
+                join_push(&queue, negative ? den[d] : num[d], share->x_i, share->n_limbs, exponent, n, params);
+            }
+            if (queue.count > 0) {
+                join_flush(&queue, n, params);
+            }
+        }
+
+        for (size_t d = 0; d < m; d++) {
+            join_push(&queue, b_negative ? den[d] : num[d], mpz_limbs_read(x[d]), mpz_size(x[d]), b, n, params);
+        }
+        if (queue.count > 0) {
+            join_flush(&queue, n, params);
+        }
+
+        /* prefix[d] = den[0] * ... * den[d], then a single inversion gives every den[d]^-1 */
+        mpz_set(prefix[0], den[0]);
+        for (size_t d = 1; d < m; d++) {
+            mpz_mul(prefix[d], prefix[d - 1], den[d]);
+            mpz_mod(prefix[d], prefix[d], n);
+        }
+        int invertible = mpz_invert(inverse, prefix[m - 1], n);
+        assert(invertible);
+        (void) invertible;
+
+        for (size_t d = m; d-- > 0;) {
+            // inverse = (den[0] * ... * den[d])^-1, so den[d]^-1 = inverse * prefix[d - 1]
+            if (d > 0) {
+                mpz_mul(prefix[d], inverse, prefix[d - 1]);
+                mpz_mul(inverse, inverse, den[d]);
+                mpz_mod(inverse, inverse, n);
+            } else {
+                mpz_set(prefix[d], inverse);
+            }
+
+            mpz_mul(num[d], num[d], prefix[d]);
+            mpz_mod(num[d], num[d], n);
+
+            if (fixed != NULL) {
+                size_t len = params->public_key.n.data_len;
+                tc_mpz_to_fixed_bytes(fixed + (first + d) * len, len, num[d]);
+                continue;
+            }
+            out[first + d] = tc_init_bytes(NULL, 0);
+            TC_MPZ_TO_BYTES(out[first + d], num[d]);
+            assert(out[first + d] != NULL && out[first + d]->data != NULL);
+        }
+
+        workspace_end(chunk_mark);
     }
 
-    mpz_mod(y, y, n);
-
-    TC_MPZ_TO_BYTES(out, y);
-
-#if (__GNU_MP_VERSION >= 5)
-    mpz_clears(x, n, e, u, delta, e_prime, w, s_i, lambda_k_2, aux, a, b, wa, xb,
-	       y, NULL);
-#else
-    mpz_clear(x);
-    mpz_clear(n);
-    mpz_clear(e);
-    mpz_clear(u);
-    mpz_clear(delta);
-    mpz_clear(e_prime);
-    mpz_clear(w);
-    mpz_clear(s_i);
-    mpz_clear(lambda_k_2);
-    mpz_clear(aux);
-    mpz_clear(a);
-    mpz_clear(b);
-    mpz_clear(wa);
-    mpz_clear(xb);
-    mpz_clear(y);
-#endif
+    workspace_end(mark);
+}
+
+bytes_t * tc_join_signatures(const signature_share_t ** signatures,
+			     const bytes_t * document, const key_metainfo_t * info) {
+    bytes_t * out;
+    join_batch(&out, NULL, signatures, &document, NULL, 1, info);
+    return out;
+}
 
-    assert(out != NULL && out->data != NULL);
+bytes_t * tc_join_signatures_ctx(const signature_share_t ** signatures, const tc_document_ctx_t * doc,
+                                 const key_metainfo_t * info) {
+    bytes_t * out;
+    join_batch(&out, NULL, signatures, NULL, &doc, 1, info);
     return out;
 }
 
+void tc_join_signatures_batch(bytes_t ** out, const signature_share_t ** signatures, const bytes_t ** docs,
+                              size_t count, const key_metainfo_t * info) {
+    join_batch(out, NULL, signatures, docs, NULL, count, info);
+}
+
 void lagrange_interpolation(mpz_t out, int j, int k,
 			    const signature_share_t ** S, const mpz_t delta) {
     mpz_set(out, delta);
-    mpz_t num, den;
-    mpz_init_set_si(num, 1);
-    mpz_init_set_si(den, 1);
+    int mark = workspace_begin(0);
+    mpz_ptr num = workspace_take(), den = workspace_take();
+    mpz_set_si(num, 1);
+    mpz_set_si(den, 1);
 
     for (int i = 0; i < k; i++) {
 	int id = S[i]->id;
@@ -154,7 +231,15 @@ void lagrange_interpolation(mpz_t out, int j, int k,
     mpz_mul(out, out, num);
     mpz_fdiv_q(out, out, den);
 
-    mpz_clear(num);
-    mpz_clear(den);
+    workspace_end(mark);
 }
 
+
+int tc_join_signatures_into(uint8_t * out, size_t len, const signature_share_t ** signatures,
+                            const bytes_t * document, const key_metainfo_t * info) {
+    if (len < info->params.public_key.n.data_len) {
+        return -1;
+    }
+    join_batch(NULL, out, signatures, &document, NULL, 1, info);
+    return 0;
+}
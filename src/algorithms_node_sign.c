@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <gmp.h>
 #include <mhash.h>
 #include "mathutils.h"
@@ -18,139 +19,251 @@
   */
 
 
-const unsigned int HASH_LEN = 32; // sha256 => 256 bits => 32 bytes
+#define HASH_LEN 32 // sha256 => 256 bits => 32 bytes
 
-signature_share_t * tc_node_sign(const key_share_t * share, const bytes_t * doc, const key_metainfo_t * info){
-    signature_share_t * out = tc_init_signature_share();
-
-    mpz_t x, n, e, s_i, v, u, vk_i, xi, xi_2, r, v_prime, x_tilde, x_prime, c, z;
-#if (__GNU_MP_VERSION >= 5)
-    mpz_inits(x, n, e, s_i, v, u, vk_i, xi, xi_2, r, v_prime, x_tilde, x_prime, c, z, NULL);
-#else
-    mpz_init(x);
-    mpz_init(n);
-    mpz_init(e);
-    mpz_init(s_i);
-    mpz_init(v);
-    mpz_init(u);
-    mpz_init(vk_i);
-    mpz_init(xi);
-    mpz_init(xi_2);
-    mpz_init(r);
-    mpz_init(v_prime);
-    mpz_init(x_tilde);
-    mpz_init(x_prime);
-    mpz_init(c);
-    mpz_init(z);
-#endif
-
-    TC_BYTES_TO_MPZ(x, doc);
-    TC_BYTES_TO_MPZ(n, info->public_key->n);
-    TC_BYTES_TO_MPZ(e, info->public_key->e);
-    TC_BYTES_TO_MPZ(s_i, share->s_i);
-    TC_BYTES_TO_MPZ(v, info->vk_v);
-    TC_BYTES_TO_MPZ(u, info->vk_u);
-    TC_BYTES_TO_MPZ(vk_i, info->vk_i + TC_ID_TO_INDEX(share->id));
+/* Hashes the proof of correctness of a signature share into c, shared with tc_verify_signature. */
+void proof_challenge(mpz_ptr c, mpz_srcptr v, mpz_srcptr u, mpz_srcptr x_tilde, mpz_srcptr vk_i,
+                            mpz_srcptr xi_2, mpz_srcptr v_prime, mpz_srcptr x_prime, mpz_srcptr n) {
+    const uint8_t * bytes;
+    size_t len;
+
+    // Initialization of the digest context
+
+    unsigned char hash[HASH_LEN];
+    MHASH sha = mhash_init(MHASH_SHA256);
+
+    bytes = workspace_octets(&len, v);
+    mhash(sha, bytes, len);
+    bytes = workspace_octets(&len, u);
+    mhash(sha, bytes, len);
+    bytes = workspace_octets(&len, x_tilde);
+    mhash(sha, bytes, len);
+    bytes = workspace_octets(&len, vk_i);
+    mhash(sha, bytes, len);
+    bytes = workspace_octets(&len, xi_2);
+    mhash(sha, bytes, len);
+    bytes = workspace_octets(&len, v_prime);
+    mhash(sha, bytes, len);
+    bytes = workspace_octets(&len, x_prime);
+    mhash(sha, bytes, len);
+
+    mhash_deinit(sha, hash);
+
+    TC_GET_OCTETS(c, HASH_LEN, hash);
+    mpz_mod(c, c, n);
+}
+
+/*
+ * Signs count documents with the same share. The documents are signed MB_MAX_LANES at a time: v^r comes from the
+ * fixed-base table of v, and the other exponentiations of the chunk are computed together by mb_powm. A single
+ * signature is laid out in into if it isn't NULL.
+ */
+static void node_sign_batch(signature_share_t ** out, void * into, const key_share_t * share, const bytes_t ** docs,
+                            const tc_document_ctx_t ** ctxs, size_t count, const struct key_params * params,
+                            const mp_limb_t * vk_id) {
+    assert(into == NULL || count == 1);
+    mp_size_t n_limbs = params->n_limbs;
+
+    int mark = workspace_begin(n_limbs);
+    mpz_ptr s_i2 = workspace_take(), c = workspace_take(), z = workspace_take();
+    mpz_t n, s_i, v, u, vk_i;
+
+    TC_LIMBS_VIEW(n, params->n, n_limbs);
+    TC_LIMBS_VIEW(s_i, share->s_i, share->n_limbs);
+    TC_LIMBS_VIEW(v, params->vk_v, n_limbs);
+    TC_LIMBS_VIEW(u, params->vk_u, n_limbs);
+    TC_LIMBS_VIEW(vk_i, vk_id, n_limbs);
 
     const unsigned long n_bits = mpz_sizeinbase(n, 2); // Bit size of the key.
 
-    // x = doc if (doc | n) == 1 else doc * u^e
-    if(mpz_jacobi(x, n) == -1) {
-	mpz_t ue;
-	mpz_init(ue);
-	mpz_powm(ue, u, e, n);
-	mpz_mul(x, x, ue);
-	mpz_mod(x, x, n);
-	mpz_clear(ue);
+    mpz_mul_ui(s_i2, s_i, 2);
+    const struct fixed_base * v_table = fixed_base_v(params);
+
+    for (size_t first = 0; first < count; first += MB_MAX_LANES) {
+        size_t m = count - first < MB_MAX_LANES ? count - first : MB_MAX_LANES;
+        int chunk_mark = workspace_begin(n_limbs);
+        mpz_ptr x[MB_MAX_LANES], xi[MB_MAX_LANES], r[MB_MAX_LANES], v_prime[MB_MAX_LANES], x_tilde[MB_MAX_LANES],
+                x_prime[MB_MAX_LANES];
+        mpz_ptr results[3 * MB_MAX_LANES];
+        mpz_srcptr bases[3 * MB_MAX_LANES], exponents[3 * MB_MAX_LANES];
+        size_t pending = 0;
+
+        for (size_t j = 0; j < m; j++) {
+            x[j] = workspace_take(), xi[j] = workspace_take(), r[j] = workspace_take();
+            v_prime[j] = workspace_take(), x_tilde[j] = workspace_take(), x_prime[j] = workspace_take();
+
+            // x = doc if (doc | n) == 1 else doc * u^e, and x_tilde = x^4 % n
+            document_load(x[j], x_tilde[j], docs ? docs[first + j] : NULL, ctxs ? ctxs[first + j] : NULL, params);
+
+            // r = abs(random(bytes_len))
+            random_dev(r[j], n_bits + 2*HASH_LEN*8);
+
+            // v_prime = v^r % n, from the table of v if it has one
+            if (!fixed_base_powm(v_prime[j], r[j], v_table, params)) {
+                results[pending] = v_prime[j], bases[pending] = v, exponents[pending] = r[j];
+                pending++;
+            }
+        }
+
+        // xi = x^(2*share), x_prime = x_tilde^r, all mod n
+        for (size_t j = 0; j < m; j++) {
+            results[pending] = xi[j], bases[pending] = x[j], exponents[pending] = s_i2;
+            pending++;
+        }
+        for (size_t j = 0; j < m; j++) {
+            results[pending] = x_prime[j], bases[pending] = x_tilde[j], exponents[pending] = r[j];
+            pending++;
+        }
+
+        mb_powm(results, bases, exponents, pending, params);
+
+        for (size_t j = 0; j < m; j++) {
+            signature_share_t * sig = into ? signature_share_in(into, n_limbs) : tc_init_signature_share(n_limbs);
+
+            // xi_2 = xi^2, x is no longer needed
+            mpz_ptr xi_2 = x[j];
+            mpz_powm_ui(xi_2, xi[j], 2, n);
+
+            proof_challenge(c, v, u, x_tilde[j], vk_i, xi_2, v_prime[j], x_prime[j], n);
+
+            mpz_mul(z, c, s_i);
+            mpz_add(z, z, r[j]);
+
+            TC_MPZ_TO_LIMBS(sig->c, n_limbs, c);
+            TC_MPZ_TO_LIMBS(sig->z, TC_Z_LIMBS(n_limbs), z);
+            TC_MPZ_TO_LIMBS(sig->x_i, n_limbs, xi[j]);
+            sig->id = share->id;
+            out[first + j] = sig;
+        }
+
+        workspace_end(chunk_mark);
     }
 
-    // xi = x^(2*share) mod n
-    mpz_mul_ui(xi, s_i, 2);
-    mpz_powm(xi, x, xi, n);
+    workspace_end(mark);
+}
 
-    // xi_2 = xi^2
-    mpz_powm_ui(xi_2, xi, 2, n);
+signature_share_t * tc_node_sign(const key_share_t * share, const bytes_t * doc, const key_metainfo_t * info){
+    signature_share_t * out;
+    tc_node_sign_batch(&out, share, &doc, 1, info);
+    return out;
+}
 
-    // r = abs(random(bytes_len))
-    random_dev(r, n_bits + 2*HASH_LEN*8);
+signature_share_t * tc_node_sign_ctx(const key_share_t * share, const tc_document_ctx_t * doc,
+                                     const key_metainfo_t * info) {
+    assert(0 < share->id && share->id <= info->l);
+    signature_share_t * out;
+    node_sign_batch(&out, NULL, share, NULL, &doc, 1, &info->params, TC_VK_I(info, share->id));
+    return out;
+}
 
-    // v_prime = v^r % n
-    mpz_powm(v_prime, v, r, n);
+void tc_node_sign_batch(signature_share_t ** out, const key_share_t * share, const bytes_t ** docs, size_t count,
+                        const key_metainfo_t * info) {
+    assert(0 < share->id && share->id <= info->l);
+    node_sign_batch(out, NULL, share, docs, NULL, count, &info->params, TC_VK_I(info, share->id));
+}
 
-    // x_tilde = x^4 % n
-    mpz_powm_ui(x_tilde, x, 4ul, n);
+signature_share_t * tc_node_sign_into(void * buffer, size_t size, const key_share_t * share, const bytes_t * doc,
+                                      const key_metainfo_t * info) {
+    assert(0 < share->id && share->id <= info->l);
+    if (size < tc_signature_share_size(info)) {
+        return NULL;
+    }
+    signature_share_t * out;
+    node_sign_batch(&out, buffer, share, &doc, NULL, 1, &info->params, TC_VK_I(info, share->id));
+    return out;
+}
 
-    // x_prime = x_tilde^r % n
-    mpz_powm(x_prime, x_tilde, r, n);
+/* Shares of a node signed together by tc_node_sign_multi, each takes five workspace variables */
+#define MULTI_SHARES 16
 
-   // Every number calculated, now to bytes...
-    size_t v_len, u_len, x_tilde_len, v_i_len, xi_2_len, v_prime_len, x_prime_len;
+void tc_node_sign_multi(signature_share_t ** out, const key_share_t ** shares, size_t count, const bytes_t * doc,
+                        const key_metainfo_t * info) {
+    const struct key_params * params = &info->params;
+    mp_size_t n_limbs = params->n_limbs;
 
+    int mark = workspace_begin(n_limbs);
+    mpz_ptr x = workspace_take(), x_tilde = workspace_take(), xi_2 = workspace_take(), c = workspace_take(),
+            z = workspace_take();
+    mpz_t n, v, u;
 
-    void * v_bytes = TC_TO_OCTETS(&v_len, v);
-    void * u_bytes = TC_TO_OCTETS(&u_len, u);
-    void * x_tilde_bytes = TC_TO_OCTETS(&x_tilde_len, x_tilde);
-    void * v_i_bytes = TC_TO_OCTETS(&v_i_len, vk_i);
-    void * xi_2_bytes = TC_TO_OCTETS(&xi_2_len, xi_2);
-    void * v_prime_bytes = TC_TO_OCTETS(&v_prime_len, v_prime);
-    void * x_prime_bytes = TC_TO_OCTETS(&x_prime_len, x_prime);
+    TC_LIMBS_VIEW(n, params->n, n_limbs);
+    TC_LIMBS_VIEW(v, params->vk_v, n_limbs);
+    TC_LIMBS_VIEW(u, params->vk_u, n_limbs);
 
-    // Initialization of the digest context
+    const unsigned long n_bits = mpz_sizeinbase(n, 2); // Bit size of the key.
 
-    unsigned char * hash = alloc(HASH_LEN);
-    MHASH sha = mhash_init(MHASH_SHA256);
+    // x = doc if (doc | n) == 1 else doc * u^e, and x_tilde = x^4 % n, once for every share
+    document_x(x, x_tilde, doc, params);
+    const struct fixed_base * v_table = fixed_base_v(params);
 
-    mhash(sha, v_bytes, v_len);
-    mhash(sha, u_bytes, u_len);
-    mhash(sha, x_tilde_bytes, x_tilde_len);
-    mhash(sha, v_i_bytes, v_i_len);
-    mhash(sha, xi_2_bytes, xi_2_len);
-    mhash(sha, v_prime_bytes, v_prime_len);
-    mhash(sha, x_prime_bytes, x_prime_len);
+    for (size_t first = 0; first < count; first += MULTI_SHARES) {
+        size_t m = count - first < MULTI_SHARES ? count - first : MULTI_SHARES;
+        int chunk_mark = workspace_begin(n_limbs);
+        mpz_ptr s_i2[MULTI_SHARES], r[MULTI_SHARES], xi[MULTI_SHARES], v_prime[MULTI_SHARES],
+                x_prime[MULTI_SHARES];
+        mpz_srcptr exponents[MULTI_SHARES];
+        int v_pending = 0;
 
-    mhash_deinit(sha, hash);
+        for (size_t j = 0; j < m; j++) {
+            const key_share_t * share = shares[first + j];
+            assert(0 < share->id && share->id <= info->l);
+            s_i2[j] = workspace_take(), r[j] = workspace_take(), xi[j] = workspace_take();
+            v_prime[j] = workspace_take(), x_prime[j] = workspace_take();
 
-    void (*freefunc) (void *, size_t);
-    mp_get_memory_functions (NULL, NULL, &freefunc);
+            mpz_t s_i;
+            TC_LIMBS_VIEW(s_i, share->s_i, share->n_limbs);
+            mpz_mul_ui(s_i2[j], s_i, 2);
 
-    freefunc(v_bytes, v_len);
-    freefunc(u_bytes, u_len);
-    freefunc(x_tilde_bytes, x_tilde_len);
-    freefunc(v_i_bytes, v_i_len);
-    freefunc(xi_2_bytes, xi_2_len);
-    freefunc(v_prime_bytes, v_prime_len);
-    freefunc(x_prime_bytes, x_prime_len);
+            // r = abs(random(bytes_len))
+            random_dev(r[j], n_bits + 2*HASH_LEN*8);
 
-    TC_GET_OCTETS(c, HASH_LEN, hash);
-    mpz_mod(c, c, n);
-    free(hash);
-
-    mpz_mul(z, c, s_i);
-    mpz_add(z, z, r);
-
-    TC_MPZ_TO_BYTES(out->c, c);
-    TC_MPZ_TO_BYTES(out->z, z);
-    TC_MPZ_TO_BYTES(out->x_i, xi);
-    out->id = share->id;
-
-#if (__GNU_MP_VERSION >= 5)
-    mpz_clears(x, n, e, s_i, v, u, vk_i, xi, xi_2, r, v_prime, x_tilde, x_prime, c, z, NULL);
-#else
-    mpz_clear(x);
-    mpz_clear(n);
-    mpz_clear(e);
-    mpz_clear(s_i);
-    mpz_clear(v);
-    mpz_clear(u);
-    mpz_clear(vk_i);
-    mpz_clear(xi);
-    mpz_clear(xi_2);
-    mpz_clear(r);
-    mpz_clear(v_prime);
-    mpz_clear(x_tilde);
-    mpz_clear(x_prime);
-    mpz_clear(c);
-    mpz_clear(z);
-#endif
+            // v_prime = v^r % n, from the table of v if it has one
+            if (!fixed_base_powm(v_prime[j], r[j], v_table, params)) {
+                v_pending = 1;
+            }
+        }
+
+        // xi = x^(2*share), x_prime = x_tilde^r, and v_prime = v^r without a table, each base squared once
+        backend_multi_powm(xi, x, (mpz_srcptr *) s_i2, m, params);
+        for (size_t j = 0; j < m; j++) {
+            exponents[j] = r[j];
+        }
+        backend_multi_powm(x_prime, x_tilde, exponents, m, params);
+        if (v_pending) {
+            backend_multi_powm(v_prime, v, exponents, m, params);
+        }
+
+        for (size_t j = 0; j < m; j++) {
+            const key_share_t * share = shares[first + j];
+            signature_share_t * sig = tc_init_signature_share(n_limbs);
+            mpz_t s_i, vk_i;
+            TC_LIMBS_VIEW(s_i, share->s_i, share->n_limbs);
+            TC_LIMBS_VIEW(vk_i, TC_VK_I(info, share->id), n_limbs);
+
+            // xi_2 = xi^2
+            mpz_powm_ui(xi_2, xi[j], 2, n);
+
+            proof_challenge(c, v, u, x_tilde, vk_i, xi_2, v_prime[j], x_prime[j], n);
+
+            mpz_mul(z, c, s_i);
+            mpz_add(z, z, r[j]);
+
+            TC_MPZ_TO_LIMBS(sig->c, n_limbs, c);
+            TC_MPZ_TO_LIMBS(sig->z, TC_Z_LIMBS(n_limbs), z);
+            TC_MPZ_TO_LIMBS(sig->x_i, n_limbs, xi[j]);
+            sig->id = share->id;
+            out[first + j] = sig;
+        }
+
+        workspace_end(chunk_mark);
+    }
+
+    workspace_end(mark);
+}
+
+signature_share_t * tc_node_sign_slim(const key_share_t * share, const bytes_t * doc, const signer_metainfo_t * info){
+    assert(share->id == info->id);
+    signature_share_t * out;
+    node_sign_batch(&out, NULL, share, &doc, NULL, 1, &info->params, info->vk_i);
     return out;
 }
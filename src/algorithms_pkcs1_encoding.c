@@ -1,4 +1,9 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
 #include <mhash.h>
+#include <unistd.h>
 #include "tc_internal.h"
 
 const uint8_t MD2_PKCS_ID[] = {
@@ -88,15 +93,14 @@ static void tc_pkcs1_encoding(bytes_t * out, bytes_t * digest, tc_hash_type_t ha
     memcpy(p, digest->data, digest->data_len);
 }
 
-bytes_t * tc_prepare_document(const bytes_t * doc, tc_hash_type_t hash_type, const key_metainfo_t * metainfo) {
-    size_t data_len = metainfo->public_key->n->data_len;
-
-    bytes_t * out = tc_init_bytes(malloc(data_len), data_len);
+/* Writes the prepared document, of len bytes, to out. */
+void pkcs1_prepare(uint8_t * out, size_t len, const bytes_t * doc, tc_hash_type_t hash_type) {
+    bytes_t encoded = { .data = out, .data_len = len };
     bytes_t digest;
+    uint8_t hash[32];
     switch(hash_type) {
         case TC_SHA256:
             {
-                uint8_t hash[32];
                 MHASH sha = mhash_init(MHASH_SHA256);
                 mhash(sha, doc->data, doc->data_len);
                 mhash_deinit(sha, hash);
@@ -115,7 +119,128 @@ bytes_t * tc_prepare_document(const bytes_t * doc, tc_hash_type_t hash_type, con
             abort();
     };
 
-    assert(digest.data_len <= data_len);
-    tc_pkcs1_encoding(out, &digest, hash_type);
+    assert(digest.data_len <= len);
+    tc_pkcs1_encoding(&encoded, &digest, hash_type);
+}
+
+bytes_t * tc_prepare_document(const bytes_t * doc, tc_hash_type_t hash_type, const key_metainfo_t * metainfo) {
+    size_t data_len = metainfo->params.public_key.n.data_len;
+
+    bytes_t * out = tc_init_bytes(alloc(data_len), data_len);
+    pkcs1_prepare(out->data, data_len, doc, hash_type);
+    return out;
+}
+
+int tc_prepare_document_into(uint8_t * out, size_t len, const bytes_t * doc, tc_hash_type_t hash_type,
+                             const key_metainfo_t * metainfo) {
+    size_t data_len = metainfo->params.public_key.n.data_len;
+    if (len < data_len) {
+        return -1;
+    }
+    pkcs1_prepare(out, data_len, doc, hash_type);
+    return 0;
+}
+
+/* Documents hashed together by tc_prepare_documents_batch */
+#define PREPARE_BATCH 64
+
+void tc_prepare_documents_batch(uint8_t * out, const bytes_t ** docs, size_t count, tc_hash_type_t hash_type,
+                                const key_metainfo_t * metainfo) {
+    size_t len = metainfo->params.public_key.n.data_len;
+    if (hash_type != TC_SHA256) {
+        for (size_t i = 0; i < count; i++) {
+            pkcs1_prepare(out + i * len, len, docs[i], hash_type);
+        }
+        return;
+    }
+
+    uint8_t digests[PREPARE_BATCH][32];
+    for (size_t first = 0; first < count; first += PREPARE_BATCH) {
+        size_t chunk = count - first < PREPARE_BATCH ? count - first : PREPARE_BATCH;
+        mb_sha256(digests, docs + first, chunk);
+        for (size_t i = 0; i < chunk; i++) {
+            bytes_t encoded = { .data = out + (first + i) * len, .data_len = len };
+            bytes_t digest = { .data = digests[i], .data_len = 32 };
+            tc_pkcs1_encoding(&encoded, &digest, hash_type);
+        }
+    }
+}
+
+/*
+ * Incremental preparation, for documents that don't fit in memory: the document is hashed as it is read, so only the
+ * hash state and the prepared document are kept. Only hashed documents can be prepared this way, TC_NONE needs the
+ * whole document.
+ */
+
+struct prepare_ctx {
+    MHASH hash;
+    tc_hash_type_t hash_type;
+    size_t len; /* Bytes of the prepared document */
+};
+
+/* Bytes read at once by tc_prepare_file */
+#define PREPARE_READ_SIZE (1 << 20)
+
+tc_prepare_ctx_t * tc_init_prepare(tc_hash_type_t hash_type, const key_metainfo_t * metainfo) {
+    if (hash_type != TC_SHA256) {
+        return NULL;
+    }
+
+    tc_prepare_ctx_t * ctx = alloc(sizeof(tc_prepare_ctx_t));
+    ctx->hash = mhash_init(MHASH_SHA256);
+    ctx->hash_type = hash_type;
+    ctx->len = metainfo->params.public_key.n.data_len;
+    return ctx;
+}
+
+void tc_prepare_update(tc_prepare_ctx_t * ctx, const void * data, size_t len) {
+    mhash(ctx->hash, data, len);
+}
+
+bytes_t * tc_prepare_final(tc_prepare_ctx_t * ctx) {
+    uint8_t hash[32];
+    mhash_deinit(ctx->hash, hash);
+
+    bytes_t digest = { .data = hash, .data_len = sizeof(hash) };
+    bytes_t * out = tc_init_bytes(alloc(ctx->len), ctx->len);
+    tc_pkcs1_encoding(out, &digest, ctx->hash_type);
+    tc_free(ctx);
+    return out;
+}
+
+bytes_t * tc_prepare_file(const char * path, tc_hash_type_t hash_type, const key_metainfo_t * metainfo) {
+    /* Reading a large file is likely to be interrupted by a signal, which only makes it try again */
+    int fd;
+    while ((fd = open(path, O_RDONLY)) < 0 && errno == EINTR) {
+    }
+    if (fd < 0) {
+        return NULL;
+    }
+    tc_prepare_ctx_t * ctx = tc_init_prepare(hash_type, metainfo);
+    if (ctx == NULL) {
+        close(fd);
+        return NULL;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    uint8_t * buffer = alloc(PREPARE_READ_SIZE);
+    ssize_t count;
+    while ((count = read(fd, buffer, PREPARE_READ_SIZE)) != 0) {
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            break;
+        }
+        tc_prepare_update(ctx, buffer, count);
+    }
+    tc_free(buffer);
+    close(fd);
+
+    bytes_t * out = tc_prepare_final(ctx);
+    if (count < 0) {
+        tc_clear_bytes(out);
+        return NULL;
+    }
     return out;
 }
@@ -11,39 +11,88 @@
 #include "tc.h"
 #include "tc_internal.h"
 
+/*
+ * Standard RSA verification. A public key context keeps n, e and the Montgomery context of n decoded, so relying
+ * parties that only have the public key don't decode it on every call, and the documents are prepared in a buffer on
+ * the stack instead of an allocated one.
+ *
+ * The signatures of a batch are raised to e MB_MAX_LANES at a time by mb_powm. Each one is still checked on its own:
+ * screening the product of the signatures would only tell that every document was signed, not which signatures are
+ * valid. Exponents that fit in a word, as the usual 65537, take a square and multiply without the window table when
+ * there are too few signatures for the multi-buffer kernels.
+ */
+
+/* Verifies up to MB_MAX_LANES signatures against their documents, or against the already prepared documents. */
+static void verify_chunk(int * results, const bytes_t ** signatures, const bytes_t ** docs,
+                         const bytes_t ** prepared, size_t count, tc_hash_type_t hash_type,
+                         const struct key_params * params) {
+    size_t len = params->public_key.n.data_len;
+    uint8_t buffer[len];
+
+    int mark = workspace_begin(params->n_limbs);
+    mpz_ptr s[MB_MAX_LANES], x[MB_MAX_LANES], r[MB_MAX_LANES];
+    mpz_srcptr exponents[MB_MAX_LANES];
+    size_t lanes[MB_MAX_LANES];
+    size_t pending = 0;
+    mpz_t n, e;
+    TC_LIMBS_VIEW(n, params->n, params->n_limbs);
+    TC_LIMBS_VIEW(e, params->e, params->e_limbs);
+
+    for (size_t j = 0; j < count; j++) {
+        s[j] = workspace_take(), x[j] = workspace_take(), r[j] = workspace_take();
+    }
+
+    for (size_t j = 0; j < count; j++) {
+        results[j] = 0;
+
+        /* Signatures out of [0, n) are rejected */
+        TC_BYTES_TO_MPZ(s[pending], signatures[j]);
+        if (mpz_cmp(s[pending], n) >= 0) {
+            continue;
+        }
+
+        if (prepared != NULL) {
+            TC_BYTES_TO_MPZ(x[pending], prepared[j]);
+        } else {
+            pkcs1_prepare(buffer, len, docs[j], hash_type);
+            TC_GET_OCTETS(x[pending], len, buffer);
+        }
+        exponents[pending] = e;
+        lanes[pending] = j;
+        pending++;
+    }
+
+    if (tc_get_backend() == TC_BACKEND_GMP && mpz_sgn(e) > 0 && mpz_fits_ulong_p(e) && pending < MB_MAX_LANES / 2) {
+        for (size_t i = 0; i < pending; i++) {
+            mont_powm_ui(r[i], s[i], mpz_get_ui(e), &params->mont);
+        }
+    } else {
+        mb_powm(r, (mpz_srcptr *) s, exponents, pending, params);
+    }
+
+    for (size_t i = 0; i < pending; i++) {
+        results[lanes[i]] = mpz_cmp(r[i], x[i]) == 0;
+    }
+
+    workspace_end(mark);
+}
+
 int tc_rsa_verify(bytes_t * signature, bytes_t * doc, key_metainfo_t * info, tc_hash_type_t hashtype) {
+    int result;
+    verify_chunk(&result, (const bytes_t **) &signature, (const bytes_t **) &doc, NULL, 1, hashtype, &info->params);
+    return result;
+}
+
+int tc_rsa_verify_prepared(const tc_public_key_ctx_t * ctx, const bytes_t * signature, const bytes_t * prepared) {
+    int result;
+    verify_chunk(&result, &signature, NULL, &prepared, 1, TC_NONE, &ctx->params);
+    return result;
+}
 
-	bytes_t * doc_pkcs1 = tc_prepare_document(doc, hashtype, info);
-
-	mpz_t c, x, e, n, new_x;
-#if (__GNU_MP_VERSION >= 5)
-	mpz_inits(c, x, e, n, new_x, NULL);
-#else
-    mpz_init(c);
-    mpz_init(x);
-    mpz_init(e);
-    mpz_init(n);
-    mpz_init(new_x);
-#endif
-
-	TC_BYTES_TO_MPZ(x, doc_pkcs1);
-	TC_BYTES_TO_MPZ(c, signature);
-	TC_BYTES_TO_MPZ(e, info->public_key->e);
-	TC_BYTES_TO_MPZ(n, info->public_key->n);
-
-	mpz_powm(new_x, c, e, n);
-	int cmp = mpz_cmp(x, new_x);
-
-	tc_clear_bytes(doc_pkcs1);
-#if (__GNU_MP_VERSION >= 5)
-	mpz_clears(c, x, e, n, new_x, NULL);
-#else
-    mpz_clear(c);
-    mpz_clear(x);
-    mpz_clear(e);
-    mpz_clear(n);
-    mpz_clear(new_x);
-#endif
-
-	return cmp == 0;
+void tc_rsa_verify_batch(int * results, const tc_public_key_ctx_t * ctx, const bytes_t ** signatures,
+                         const bytes_t ** docs, size_t count, tc_hash_type_t hash_type) {
+    for (size_t first = 0; first < count; first += MB_MAX_LANES) {
+        size_t m = count - first < MB_MAX_LANES ? count - first : MB_MAX_LANES;
+        verify_chunk(results + first, signatures + first, docs + first, NULL, m, hash_type, &ctx->params);
+    }
 }
@@ -1,150 +1,117 @@
 #include <gmp.h>
-#include <mhash.h>
 
 #include "tc.h"
 #include "tc_internal.h"
 
-extern const unsigned int HASH_LEN; /* Defined somewhere :P */
+/* Checks the proof of correctness of a signature share, for up to MB_MAX_LANES shares. */
+static void verify_chunk(int * results, const signature_share_t ** signatures, const bytes_t ** docs,
+                         const tc_document_ctx_t ** ctxs, size_t count, const key_metainfo_t * info) {
+    const struct key_params * params = &info->params;
+    mp_size_t n_limbs = params->n_limbs;
+
+    int mark = workspace_begin(n_limbs);
+    mpz_ptr h = workspace_take();
+    mpz_ptr x[MB_MAX_LANES], xtilde[MB_MAX_LANES], neg_c[MB_MAX_LANES], neg_2c[MB_MAX_LANES],
+            vk_neg_c[MB_MAX_LANES], v_z[MB_MAX_LANES], xi_neg_2c[MB_MAX_LANES], xtilde_z[MB_MAX_LANES];
+    mpz_t xi[MB_MAX_LANES], z[MB_MAX_LANES], c[MB_MAX_LANES], vk_i[MB_MAX_LANES], n, v, u;
+    mpz_ptr powers[4 * MB_MAX_LANES];
+    mpz_srcptr bases[4 * MB_MAX_LANES], exponents[4 * MB_MAX_LANES];
+    size_t valid[MB_MAX_LANES];
+    size_t m = 0;
+
+    TC_LIMBS_VIEW(n, params->n, n_limbs);
+    TC_LIMBS_VIEW(v, params->vk_v, n_limbs);
+    TC_LIMBS_VIEW(u, params->vk_u, n_limbs);
+
+    for (size_t i = 0; i < count; i++) {
+        const signature_share_t * signature = signatures[i];
+        /* A deserialized share may be narrower than the key, one wider than it can't be of the key */
+        if (signature->id < 1 || signature->id > info->l || signature->n_limbs > n_limbs) {
+            results[i] = 0;
+            continue;
+        }
+        /* x_i is raised to -2c, so it has to be invertible mod n */
+        size_t j = m;
+        TC_LIMBS_VIEW(xi[j], signature->x_i, signature->n_limbs);
+        if (mpz_sgn(xi[j]) == 0 || mpz_cmp(xi[j], n) >= 0) {
+            results[i] = 0;
+            continue;
+        }
+        m++;
+        valid[j] = i;
+
+        x[j] = workspace_take(), xtilde[j] = workspace_take(), neg_c[j] = workspace_take();
+        neg_2c[j] = workspace_take(), vk_neg_c[j] = workspace_take(), v_z[j] = workspace_take();
+        xi_neg_2c[j] = workspace_take(), xtilde_z[j] = workspace_take();
+
+        TC_LIMBS_VIEW(z[j], signature->z, TC_Z_LIMBS(signature->n_limbs));
+        TC_LIMBS_VIEW(c[j], signature->c, signature->n_limbs);
+        TC_LIMBS_VIEW(vk_i[j], TC_VK_I(info, signature->id), n_limbs);
+
+        // x~ = x^4 % n, x is only used as scratch afterwards
+        document_load(x[j], xtilde[j], docs ? docs[i] : NULL, ctxs ? ctxs[i] : NULL, params);
+
+        mpz_neg(neg_c[j], c[j]);
+        mpz_mul_si(neg_2c[j], neg_c[j], 2);
+    }
 
-int tc_verify_signature(const signature_share_t * signature, const bytes_t * doc, const key_metainfo_t * info){
-    mpz_t x, xi, z, c, n, e, v, u, vk_i, delta, xtilde, xi2, neg_c, v_prime, xi_neg_2c, x_prime, aux;
-#if (__GNU_MP_VERSION >= 5)
-    mpz_inits(x, xi, z, c, n, e, v, u, vk_i, delta, xtilde, xi2, neg_c, v_prime, xi_neg_2c, x_prime, aux, NULL);
-#else
-    mpz_init(x);
-    mpz_init(xi);
-    mpz_init(z);
-    mpz_init(c);
-    mpz_init(n);
-    mpz_init(e);
-    mpz_init(v);
-    mpz_init(u);
-    mpz_init(vk_i);
-    mpz_init(delta);
-    mpz_init(xtilde);
-    mpz_init(xi2);
-    mpz_init(neg_c);
-    mpz_init(v_prime);
-    mpz_init(xi_neg_2c);
-    mpz_init(x_prime);
-    mpz_init(aux);
-#endif
-
-    TC_BYTES_TO_MPZ(x, doc);
-    TC_BYTES_TO_MPZ(xi, signature->x_i);
-    TC_BYTES_TO_MPZ(z, signature->z);
-    TC_BYTES_TO_MPZ(c, signature->c);
-    TC_BYTES_TO_MPZ(n, info->public_key->n);
-    TC_BYTES_TO_MPZ(e, info->public_key->e);
-    TC_BYTES_TO_MPZ(v, info->vk_v);
-    TC_BYTES_TO_MPZ(u, info->vk_u);
-
-    int idx = TC_ID_TO_INDEX(signature->id);
-    TC_BYTES_TO_MPZ(vk_i, info->vk_i + idx);
-
-    if(mpz_jacobi(x, n) == -1) {
-	mpz_t ue;
-	mpz_init(ue);
-	mpz_powm(ue, u, e, n);
-	mpz_mul(x, x, ue);
-	mpz_mod(x, x, n);
-	mpz_clear(ue);
+    // v' = v^z * v_i^(-c), x' = x~^z * x_i^(-2c). The powers of v and v_i^-1 come from their tables if they have one.
+    const struct fixed_base * v_table = fixed_base_v(params);
+    size_t pending = 0;
+    for (size_t j = 0; j < m; j++) {
+        if (!fixed_base_powm(vk_neg_c[j], c[j], fixed_base_vk_inverse(info, signatures[valid[j]]->id), params)) {
+            powers[pending] = vk_neg_c[j], bases[pending] = vk_i[j], exponents[pending] = neg_c[j];
+            pending++;
+        }
+        if (!fixed_base_powm(v_z[j], z[j], v_table, params)) {
+            powers[pending] = v_z[j], bases[pending] = v, exponents[pending] = z[j];
+            pending++;
+        }
+    }
+    for (size_t j = 0; j < m; j++) {
+        powers[pending] = xi_neg_2c[j], bases[pending] = xi[j], exponents[pending] = neg_2c[j];
+        pending++;
+    }
+    for (size_t j = 0; j < m; j++) {
+        powers[pending] = xtilde_z[j], bases[pending] = xtilde[j], exponents[pending] = z[j];
+        pending++;
+    }
+    mb_powm(powers, bases, exponents, pending, params);
+
+    for (size_t j = 0; j < m; j++) {
+        mpz_ptr v_prime = vk_neg_c[j], x_prime = xi_neg_2c[j], xi2 = x[j];
+        mpz_mul(v_prime, v_prime, v_z[j]);
+        mpz_mod(v_prime, v_prime, n);
+        mpz_mul(x_prime, x_prime, xtilde_z[j]);
+        mpz_mod(x_prime, x_prime, n);
+
+        // xi_2 = xi^2 % n
+        mpz_powm_ui(xi2, xi[j], 2, n);
+
+        proof_challenge(h, v, u, xtilde[j], vk_i[j], xi2, v_prime, x_prime, n);
+        results[valid[j]] = mpz_cmp(h, c[j]) == 0;
     }
 
-    // v
-
-    // u
-
-    // x~ = x^4 % n
-    mpz_powm_ui(xtilde, x, 4ul, n);
-
-    // v_i
-
-    // xi_2 = xi^2 % n
-    mpz_powm_ui(xi2, xi, 2, n);
-
-
-    // v' = v^z * v_i^(-c)
-    mpz_neg(neg_c, c);
-    mpz_powm(v_prime, vk_i, neg_c, n);
-
-    mpz_powm(aux, v, z, n);
-    mpz_mul(v_prime, v_prime, aux);
-    mpz_mod(v_prime, v_prime, n);
-
-    // x' = x~^z * x_i^(-2c)
-
-    mpz_mul_si(aux, neg_c, 2);
-    mpz_powm(xi_neg_2c, xi, aux, n);
-
-    mpz_powm(aux, xtilde, z, n);
-    mpz_mul(x_prime, aux, xi_neg_2c);
-    mpz_mod(x_prime, x_prime, n);
-
-    size_t v_len, u_len, xtilde_len, v_i_len, xi2_len, v_prime_len, x_prime_len;
-
-    void * v_bytes = TC_TO_OCTETS(&v_len, v);
-    void * u_bytes = TC_TO_OCTETS(&u_len, u);
-    void * xtilde_bytes = TC_TO_OCTETS(&xtilde_len, xtilde);
-    void * v_i_bytes = TC_TO_OCTETS(&v_i_len, vk_i);
-    void * xi2_bytes = TC_TO_OCTETS(&xi2_len, xi2);
-    void * v_prime_bytes = TC_TO_OCTETS(&v_prime_len, v_prime);
-    void * x_prime_bytes = TC_TO_OCTETS(&x_prime_len, x_prime);
-
-    // Initialization of the digest context
-
-    unsigned char hash[HASH_LEN];
-    MHASH sha = mhash_init(MHASH_SHA256);
-
-    mhash(sha, v_bytes, v_len);
-    mhash(sha, u_bytes, u_len);
-    mhash(sha, xtilde_bytes, xtilde_len);
-    mhash(sha, v_i_bytes, v_i_len);
-    mhash(sha, xi2_bytes, xi2_len);
-    mhash(sha, v_prime_bytes, v_prime_len);
-    mhash(sha, x_prime_bytes, x_prime_len);
-
-    mhash_deinit(sha, hash);
-
-    void (*freefunc) (void *, size_t);
-    mp_get_memory_functions (NULL, NULL, &freefunc);
-
-    freefunc(v_bytes, v_len);
-    freefunc(u_bytes, u_len);
-    freefunc(xtilde_bytes, xtilde_len);
-    freefunc(v_i_bytes, v_i_len);
-    freefunc(xi2_bytes, xi2_len);
-    freefunc(v_prime_bytes, v_prime_len);
-    freefunc(x_prime_bytes, x_prime_len);
-
-    mpz_t h;
-    mpz_init(h);
-    TC_GET_OCTETS(h, HASH_LEN, hash);
-    mpz_mod(h, h, n);
-    int result = mpz_cmp(h, c);
-    mpz_clear(h);
-
-#if (__GNU_MP_VERSION >= 5)
-    mpz_clears(x, xi, z, c, n, e, v, u, vk_i, delta, xtilde, xi2, neg_c, v_prime, xi_neg_2c, x_prime, aux, NULL);
-#else
-    mpz_clear(x);
-    mpz_clear(xi);
-    mpz_clear(z);
-    mpz_clear(c);
-    mpz_clear(n);
-    mpz_clear(e);
-    mpz_clear(v);
-    mpz_clear(u);
-    mpz_clear(vk_i);
-    mpz_clear(delta);
-    mpz_clear(xtilde);
-    mpz_clear(xi2);
-    mpz_clear(neg_c);
-    mpz_clear(v_prime);
-    mpz_clear(xi_neg_2c);
-    mpz_clear(x_prime);
-    mpz_clear(aux);
-#endif
-
-    return result == 0;
+    workspace_end(mark);
+}
+
+void tc_verify_signature_batch(int * results, const signature_share_t ** signatures, const bytes_t ** docs,
+                               size_t count, const key_metainfo_t * info) {
+    for (size_t first = 0; first < count; first += MB_MAX_LANES) {
+        size_t m = count - first < MB_MAX_LANES ? count - first : MB_MAX_LANES;
+        verify_chunk(results + first, signatures + first, docs + first, NULL, m, info);
+    }
+}
+
+int tc_verify_signature_ctx(const signature_share_t * signature, const tc_document_ctx_t * doc,
+                            const key_metainfo_t * info) {
+    int result;
+    verify_chunk(&result, &signature, NULL, &doc, 1, info);
+    return result;
+}
+
+int tc_verify_signature(const signature_share_t * signature, const bytes_t * doc, const key_metainfo_t * info){
+    int result;
+    tc_verify_signature_batch(&result, &signature, &doc, 1, info);
+    return result;
 }
@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "mathutils.h"
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Dispatch of the heavy arithmetic to the selected backend. GMP, with the Montgomery engine of montgomery.c, is always
+ * available; OpenSSL BIGNUM is only compiled with the TC_OPENSSL_BACKEND option. Both take and return mpz values, so
+ * the rest of the library doesn't depend on the backend.
+ */
+
+void generate_safe_prime(mpz_t out, int bit_len, random_fn random);
+
+static atomic_int backend = TC_BACKEND_GMP;
+
+int tc_set_backend(tc_backend_t b) {
+    switch (b) {
+        case TC_BACKEND_GMP:
+            break;
+        case TC_BACKEND_OPENSSL:
+#ifdef TC_HAVE_OPENSSL
+            break;
+#else
+            return -1;
+#endif
+        default:
+            return -1;
+    }
+
+    atomic_store(&backend, b);
+    return 0;
+}
+
+tc_backend_t tc_get_backend() {
+    return atomic_load_explicit(&backend, memory_order_relaxed);
+}
+
+/* r = b^e mod n, with mpz_powm semantics. */
+void backend_powm(mpz_ptr r, mpz_srcptr b, mpz_srcptr e, const struct key_params *params) {
+#ifdef TC_HAVE_OPENSSL
+    if (tc_get_backend() == TC_BACKEND_OPENSSL) {
+        bn_powm(r, b, e, params);
+        return;
+    }
+#endif
+    mont_powm(r, b, e, &params->mont);
+}
+
+/* r[i] = b^e[i] mod n for count non-negative exponents, the squarings of b shared when the backend can. */
+void backend_multi_powm(mpz_ptr *r, mpz_srcptr b, mpz_srcptr *e, size_t count, const struct key_params *params) {
+    if (count > 1 && tc_get_backend() == TC_BACKEND_GMP) {
+        mont_multi_powm(r, b, e, count, &params->mont);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        backend_powm(r[i], b, e[i], params);
+    }
+}
+
+void backend_safe_prime(mpz_ptr out, int bit_len) {
+#ifdef TC_HAVE_OPENSSL
+    if (tc_get_backend() == TC_BACKEND_OPENSSL) {
+        bn_safe_prime(out, bit_len);
+        return;
+    }
+#endif
+    generate_safe_prime(out, bit_len, random_dev);
+}
+
+/* Releases the backend contexts cached in params, whichever backend was selected when they were created. */
+void backend_clear_key_params(struct key_params *params) {
+#ifdef TC_HAVE_OPENSSL
+    bn_clear_key_params(params);
+#else
+    assert(atomic_load(&params->backend_ctx) == NULL);
+#endif
+}
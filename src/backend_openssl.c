@@ -0,0 +1,122 @@
+#include <assert.h>
+#include <gmp.h>
+#include <openssl/bn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * OpenSSL BIGNUM backend. Exponentiations go through BN_mod_exp_mont_consttime, which uses the RSAZ assembly
+ * kernels where OpenSSL has them, with a BN_MONT_CTX created on first use and cached in the key. Each thread keeps its
+ * own BN_CTX. OpenSSL allocates with its own allocator, not through tc_set_allocator.
+ */
+
+static _Thread_local BN_CTX *bn_ctx;
+
+static pthread_key_t bn_ctx_key;
+static pthread_once_t bn_ctx_key_once = PTHREAD_ONCE_INIT;
+
+static void release_thread_bn_ctx(void *ctx) {
+    BN_CTX_free(ctx);
+}
+
+static void create_bn_ctx_key(void) {
+    pthread_key_create(&bn_ctx_key, release_thread_bn_ctx);
+}
+
+static void check(int ok) {
+    if (!ok) {
+        fprintf(stderr, "OpenSSL BIGNUM operation failed\n");
+        abort();
+    }
+}
+
+/* The BN_CTX of the calling thread, released when it exits. */
+static BN_CTX *thread_bn_ctx(void) {
+    if (bn_ctx == NULL) {
+        bn_ctx = BN_CTX_new();
+        check(bn_ctx != NULL);
+        pthread_once(&bn_ctx_key_once, create_bn_ctx_key);
+        pthread_setspecific(bn_ctx_key, bn_ctx);
+    }
+    return bn_ctx;
+}
+
+/* bn = |z| */
+static void mpz_to_bn(BIGNUM *bn, mpz_srcptr z) {
+    size_t len;
+    const uint8_t *bytes = workspace_octets(&len, z);
+    check(BN_bin2bn(bytes, len, bn) != NULL);
+}
+
+static void bn_to_mpz(mpz_ptr z, const BIGNUM *bn) {
+    int len = BN_num_bytes(bn);
+    uint8_t *bytes = (uint8_t *) workspace_limbs(TC_BYTES_TO_LIMBS(len) + 1);
+    BN_bn2bin(bn, bytes);
+    TC_GET_OCTETS(z, len, bytes);
+}
+
+static BN_MONT_CTX *key_mont_ctx(const struct key_params *params, const BIGNUM *n, BN_CTX *ctx) {
+    BN_MONT_CTX *mont = atomic_load_explicit(&params->backend_ctx, memory_order_acquire);
+    if (mont != NULL) {
+        return mont;
+    }
+
+    BN_MONT_CTX *created = BN_MONT_CTX_new();
+    check(created != NULL && BN_MONT_CTX_set(created, n, ctx));
+
+    /* The context is a cache, threads racing to create it keep the first one */
+    void *expected = NULL;
+    if (atomic_compare_exchange_strong(&((struct key_params *) params)->backend_ctx, &expected, created)) {
+        return created;
+    }
+    BN_MONT_CTX_free(created);
+    return expected;
+}
+
+void bn_powm(mpz_ptr r, mpz_srcptr b, mpz_srcptr e, const struct key_params *params) {
+    int mark = workspace_begin(params->n_limbs);
+    BN_CTX *ctx = thread_bn_ctx();
+    BN_CTX_start(ctx);
+    BIGNUM *bn_r = BN_CTX_get(ctx);
+    BIGNUM *bn_b = BN_CTX_get(ctx);
+    BIGNUM *bn_e = BN_CTX_get(ctx);
+    BIGNUM *bn_n = BN_CTX_get(ctx);
+    check(bn_n != NULL);
+
+    mpz_t n;
+    TC_LIMBS_VIEW(n, params->n, params->n_limbs);
+    mpz_to_bn(bn_n, n);
+    mpz_to_bn(bn_b, b);
+    BN_set_negative(bn_b, mpz_sgn(b) < 0);
+    check(BN_nnmod(bn_b, bn_b, bn_n, ctx));
+
+    /* Like mpz_powm, a negative exponent means a power of the inverse */
+    if (mpz_sgn(e) < 0) {
+        check(BN_mod_inverse(bn_b, bn_b, bn_n, ctx) != NULL);
+    }
+    mpz_to_bn(bn_e, e);
+
+    BN_MONT_CTX *mont = key_mont_ctx(params, bn_n, ctx);
+    check(BN_mod_exp_mont_consttime(bn_r, bn_b, bn_e, bn_n, ctx, mont));
+    bn_to_mpz(r, bn_r);
+
+    BN_CTX_end(ctx);
+    workspace_end(mark);
+}
+
+void bn_safe_prime(mpz_ptr out, int bit_len) {
+    BIGNUM *p = BN_new();
+    check(p != NULL && BN_generate_prime_ex(p, bit_len, 1, NULL, NULL, NULL));
+    bn_to_mpz(out, p);
+    BN_free(p);
+}
+
+void bn_clear_key_params(struct key_params *params) {
+    BN_MONT_CTX_free(atomic_load(&params->backend_ctx));
+    atomic_store(&params->backend_ctx, NULL);
+}
@@ -0,0 +1,194 @@
+#define _GNU_SOURCE
+
+#include "tc.h"
+#include "tc_internal.h"
+
+#include <gmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Compares the exponentiation of each backend against mpz_powm on random odd moduli, with full size exponents, and the
+ * throughput of batches of MB_MAX_LANES exponentiations with each multi-buffer kernel and of one base with shared
+ * squarings, and the fixed-base table of v for exponents as long as the ones of the signatures.
+ */
+
+static int iterations = 50;
+
+void set_parameters(int argc, char ** argv)
+{
+    int opt;
+    while((opt = getopt(argc, argv, "i:")) != -1){
+	switch(opt) {
+	case 'i':
+	    iterations = strtol(optarg, NULL, 10);
+	    break;
+	}
+    }
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double time_powm(mpz_ptr r, mpz_srcptr b, mpz_srcptr e, const struct key_params * params)
+{
+    double start = now();
+    for (int i = 0; i < iterations; i++) {
+	backend_powm(r, b, e, params);
+    }
+    return (now() - start) / iterations;
+}
+
+static void bench(gmp_randstate_t state, int bits)
+{
+    mpz_t n, b, e, r1, r2;
+    mpz_inits(n, b, e, r1, r2, NULL);
+
+    mpz_urandomb(n, state, bits);
+    mpz_setbit(n, bits - 1);
+    mpz_setbit(n, 0);
+    mpz_urandomm(b, state, n);
+    mpz_urandomb(e, state, bits);
+
+    key_metainfo_t * info = tc_init_key_metainfo(1, 1, mpz_size(n), 1);
+    TC_MPZ_TO_LIMBS(info->params.n, info->params.n_limbs, n);
+    info->params.e[0] = 65537;
+    tc_set_public_key(&info->params);
+
+    double start = now();
+    for (int i = 0; i < iterations; i++) {
+	mpz_powm(r1, b, e, n);
+    }
+    double gmp = (now() - start) / iterations;
+    printf("%5d bits: mpz_powm %8.3f ms", bits, gmp * 1e3);
+
+    const tc_backend_t backends[] = {TC_BACKEND_GMP, TC_BACKEND_OPENSSL};
+    const char * names[] = {"mont_powm", "openssl"};
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+	if (tc_set_backend(backends[i]) != 0) {
+	    continue;
+	}
+	double t = time_powm(r2, b, e, &info->params);
+	if (mpz_cmp(r1, r2) != 0) {
+	    fprintf(stderr, "%d bits: %s results differ\n", bits, names[i]);
+	    exit(EXIT_FAILURE);
+	}
+	printf("  %s %8.3f ms (%.2fx)", names[i], t * 1e3, gmp / t);
+    }
+    printf("\n");
+    tc_set_backend(TC_BACKEND_GMP);
+
+    /* Batches, in exponentiations per second */
+    mpz_t rs[MB_MAX_LANES], bs[MB_MAX_LANES], es[MB_MAX_LANES];
+    mpz_ptr rp[MB_MAX_LANES];
+    mpz_srcptr bp[MB_MAX_LANES], ep[MB_MAX_LANES];
+    for (int i = 0; i < MB_MAX_LANES; i++) {
+	mpz_inits(rs[i], bs[i], es[i], NULL);
+	mpz_urandomm(bs[i], state, n);
+	mpz_urandomb(es[i], state, bits);
+	rp[i] = rs[i], bp[i] = bs[i], ep[i] = es[i];
+    }
+    const int kernels[] = {MB_KERNEL_SCALAR, MB_KERNEL_AVX2, MB_KERNEL_IFMA};
+    const char * kernel_names[] = {"scalar", "avx2", "ifma"};
+    printf("%16s", "batch:");
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+	if (mb_set_kernel(kernels[i]) != 0) {
+	    continue;
+	}
+	double start = now();
+	for (int j = 0; j < iterations; j++) {
+	    mb_powm(rp, bp, ep, MB_MAX_LANES, &info->params);
+	}
+	double t = (now() - start) / iterations;
+	mpz_powm(r1, bs[0], es[0], n);
+	if (mpz_cmp(r1, rs[0]) != 0) {
+	    fprintf(stderr, "%d bits: %s kernel results differ\n", bits, kernel_names[i]);
+	    exit(EXIT_FAILURE);
+	}
+	printf("  %s %8.0f/s", kernel_names[i], MB_MAX_LANES / t);
+    }
+    printf("\n");
+    mb_set_kernel(MB_KERNEL_AUTO);
+
+    /* One base to MB_MAX_LANES exponents, as a node signing with several shares */
+    mpz_srcptr same[MB_MAX_LANES];
+    for (int i = 0; i < MB_MAX_LANES; i++) {
+	same[i] = bs[0];
+    }
+    printf("%16s", "one base:");
+    start = now();
+    for (int j = 0; j < iterations; j++) {
+	for (int i = 0; i < MB_MAX_LANES; i++) {
+	    mont_powm(rp[i], bs[0], ep[i], &info->params.mont);
+	}
+    }
+    double single = (now() - start) / iterations;
+    start = now();
+    for (int j = 0; j < iterations; j++) {
+	mb_powm(rp, same, ep, MB_MAX_LANES, &info->params);
+    }
+    double batch = (now() - start) / iterations;
+    start = now();
+    for (int j = 0; j < iterations; j++) {
+	mont_multi_powm(rp, bs[0], ep, MB_MAX_LANES, &info->params.mont);
+    }
+    double multi = (now() - start) / iterations;
+    mpz_powm(r1, bs[0], es[MB_MAX_LANES - 1], n);
+    if (mpz_cmp(r1, rs[MB_MAX_LANES - 1]) != 0) {
+	fprintf(stderr, "%d bits: shared squarings results differ\n", bits);
+	exit(EXIT_FAILURE);
+    }
+    printf("  mont_powm %8.0f/s  batch %8.0f/s  shared squarings %8.0f/s\n", MB_MAX_LANES / single,
+	   MB_MAX_LANES / batch, MB_MAX_LANES / multi);
+
+    for (int i = 0; i < MB_MAX_LANES; i++) {
+	mpz_clears(rs[i], bs[i], es[i], NULL);
+    }
+
+    /* v^z, z of the length of the signature exponents */
+    TC_MPZ_TO_LIMBS(info->params.vk_v, info->params.n_limbs, b);
+    mpz_urandomb(e, state, bits + 2 * 32 * 8);
+    mpz_powm(r1, b, e, n);
+    start = now();
+    const struct fixed_base * table = fixed_base_v(&info->params);
+    double build = now() - start;
+    start = now();
+    for (int i = 0; i < iterations; i++) {
+	fixed_base_powm(r2, e, table, &info->params);
+    }
+    double fixed = (now() - start) / iterations;
+    if (mpz_cmp(r1, r2) != 0) {
+	fprintf(stderr, "%d bits: fixed base results differ\n", bits);
+	exit(EXIT_FAILURE);
+    }
+    double plain = time_powm(r2, b, e, &info->params);
+    printf("%16s  mont_powm %8.3f ms  table %8.3f ms (%.2fx), built in %.3f ms\n", "fixed base:", plain * 1e3,
+	   fixed * 1e3, plain / fixed, build * 1e3);
+
+    tc_clear_key_metainfo(info);
+    mpz_clears(n, b, e, r1, r2, NULL);
+}
+
+int main(int argc, char ** argv)
+{
+    set_parameters(argc, argv);
+
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, 42);
+
+    const int sizes[] = {1024, 2048, 3072, 4096};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+	bench(state, sizes[i]);
+    }
+
+    gmp_randclear(state);
+    tc_release_workspace();
+    return 0;
+}
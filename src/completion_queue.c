@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Completion queues: the futures of the operations submitted with tc_submit_* are delivered, once done, to the ring
+ * of their queue, and an eventfd tells the event loop of the owner that there is something to poll.
+ *
+ * Every submission reserves a place in the ring, so a delivery always finds one. The eventfd is written only when the
+ * queue goes from quiet to signaled: a worker that finds it already signaled doesn't make a system call, and the
+ * owner clears the signal before draining the ring, so a delivery after the drain signals it again.
+ */
+
+struct completion_queue {
+    struct ring ring;
+    size_t capacity;
+    int fd;
+    _Alignas(64) atomic_size_t reserved; /* Operations submitted and not polled yet */
+    _Alignas(64) atomic_int signaled;
+};
+
+tc_completion_queue_t * tc_init_completion_queue(size_t size) {
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    tc_completion_queue_t * cq = alloc(sizeof(tc_completion_queue_t));
+    ring_init(&cq->ring, size);
+    cq->capacity = cq->ring.mask + 1;
+    cq->fd = fd;
+    atomic_init(&cq->reserved, 0);
+    atomic_init(&cq->signaled, 0);
+    return cq;
+}
+
+void tc_clear_completion_queue(tc_completion_queue_t * cq) {
+    assert(atomic_load(&cq->reserved) == 0);
+    close(cq->fd);
+    ring_clear(&cq->ring);
+    tc_free(cq);
+}
+
+int tc_completion_queue_fd(const tc_completion_queue_t * cq) {
+    return cq->fd;
+}
+
+/* Writes the eventfd, unless it is already signaled. */
+static void signal_owner(tc_completion_queue_t * cq) {
+    if (atomic_exchange(&cq->signaled, 1) == 0) {
+        uint64_t one = 1;
+        while (write(cq->fd, &one, sizeof one) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+void completion_queue_deliver(tc_completion_queue_t * cq, tc_future_t * future) {
+    int pushed = ring_push(&cq->ring, future);
+    assert(pushed == 0);
+    (void) pushed;
+    signal_owner(cq);
+}
+
+size_t tc_poll_completions(tc_completion_queue_t * cq, tc_completion_t * out, size_t max) {
+    uint64_t count;
+    while (read(cq->fd, &count, sizeof count) < 0 && errno == EINTR) {
+    }
+    atomic_store(&cq->signaled, 0);
+
+    size_t polled = 0;
+    tc_future_t * future;
+    while (polled < max && (future = ring_pop(&cq->ring)) != NULL) {
+        out[polled].future = future;
+        out[polled].user_data = future->user_data;
+        polled++;
+    }
+    atomic_fetch_sub_explicit(&cq->reserved, polled, memory_order_relaxed);
+
+    /* Whatever is left over for the next poll must wake the loop again */
+    if (polled == max) {
+        signal_owner(cq);
+    }
+    return polled;
+}
+
+/* Reserves a place for the future in the queue and submits it. */
+static int submit(tc_engine_t * engine, tc_completion_queue_t * cq, tc_future_t * future, void * user_data) {
+    if (atomic_fetch_add_explicit(&cq->reserved, 1, memory_order_relaxed) >= cq->capacity) {
+        atomic_fetch_sub_explicit(&cq->reserved, 1, memory_order_relaxed);
+        pool_free(future, sizeof(tc_future_t));
+        return -1;
+    }
+    future->cq = cq;
+    future->user_data = user_data;
+    if (engine_submit(engine, future) == NULL) {
+        atomic_fetch_sub_explicit(&cq->reserved, 1, memory_order_relaxed);
+        return -1;
+    }
+    return 0;
+}
+
+int tc_submit_sign(tc_engine_t * engine, tc_completion_queue_t * cq, const key_share_t * share, const bytes_t * doc,
+                   const key_metainfo_t * info, void * user_data) {
+    tc_future_t * future = future_new(TASK_SIGN);
+    future->share = share;
+    future->doc = doc;
+    future->info = info;
+    return submit(engine, cq, future, user_data);
+}
+
+int tc_submit_verify(tc_engine_t * engine, tc_completion_queue_t * cq, const signature_share_t * signature,
+                     const bytes_t * doc, const key_metainfo_t * info, void * user_data) {
+    tc_future_t * future = future_new(TASK_VERIFY);
+    future->signature = signature;
+    future->doc = doc;
+    future->info = info;
+    return submit(engine, cq, future, user_data);
+}
+
+int tc_submit_join(tc_engine_t * engine, tc_completion_queue_t * cq, const signature_share_t ** signatures,
+                   const bytes_t * doc, const key_metainfo_t * info, void * user_data) {
+    tc_future_t * future = future_new(TASK_JOIN);
+    future->signatures = signatures;
+    future->doc = doc;
+    future->info = info;
+    return submit(engine, cq, future, user_data);
+}
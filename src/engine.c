@@ -0,0 +1,355 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Signing engine: worker threads that run the operations submitted by any number of threads. Submissions go through
+ * a bounded lock-free MPMC queue (Vyukov's, each cell with a sequence number that tells whether it is free or full
+ * for the position that reaches it), and a semaphore counts the queued operations so that idle workers sleep.
+ *
+ * Each operation is its own future: the submitter keeps it, the worker fills in the result and marks it done, waking
+ * the submitter if it is waiting. Workers keep their workspace and pools warm across operations.
+ */
+
+enum future_state {
+    FUTURE_PENDING = 0,
+    FUTURE_WAITING, /* Pending, with a thread waiting for it */
+    FUTURE_DONE,
+};
+
+struct engine {
+    struct ring queue;
+    _Alignas(64) sem_t ready;
+    atomic_int stopping;
+    int threads;
+    pthread_t * workers;
+};
+
+void ring_init(struct ring * ring, size_t size) {
+    size_t capacity = 2;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    ring->cells = alloc(capacity * sizeof(struct ring_cell));
+    ring->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&ring->cells[i].sequence, i);
+    }
+    atomic_init(&ring->enqueue_pos, 0);
+    atomic_init(&ring->dequeue_pos, 0);
+}
+
+void ring_clear(struct ring * ring) {
+    tc_free(ring->cells);
+}
+
+/* Returns -1 if the ring is full. */
+int ring_push(struct ring * ring, void * item) {
+    size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        struct ring_cell * cell = &ring->cells[pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                cell->item = item;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/* Returns NULL if the cell of the next position hasn't been filled yet. */
+void * ring_pop(struct ring * ring) {
+    size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        struct ring_cell * cell = &ring->cells[pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                void * item = cell->item;
+                atomic_store_explicit(&cell->sequence, pos + ring->mask + 1, memory_order_release);
+                return item;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/* Whether every position taken by a push has been popped. */
+int ring_drained(struct ring * ring) {
+    return atomic_load(&ring->enqueue_pos) == atomic_load(&ring->dequeue_pos);
+}
+
+static void futex_wait(atomic_int * word, int value) {
+#ifdef __linux__
+    syscall(SYS_futex, (int *) word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+    (void) word, (void) value;
+    sched_yield();
+#endif
+}
+
+static void futex_wake(atomic_int * word) {
+#ifdef __linux__
+    syscall(SYS_futex, (int *) word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    (void) word;
+#endif
+}
+
+tc_future_t * future_new(enum task_kind kind) {
+    tc_future_t * future = pool_alloc(sizeof(tc_future_t));
+    atomic_init(&future->state, FUTURE_PENDING);
+    future->kind = kind;
+    future->cq = NULL;
+    future->ctx = NULL;
+    return future;
+}
+
+void future_complete(tc_future_t * future) {
+    /* Once delivered to its completion queue, the future belongs to the thread that polls it */
+    tc_completion_queue_t * cq = future->cq;
+    if (atomic_exchange_explicit(&future->state, FUTURE_DONE, memory_order_acq_rel) == FUTURE_WAITING) {
+        futex_wake(&future->state);
+    }
+    if (cq != NULL) {
+        completion_queue_deliver(cq, future);
+    }
+}
+
+static void run(tc_future_t * future) {
+    switch (future->kind) {
+        case TASK_SIGN:
+            future->result.share = tc_node_sign(future->share, future->doc, future->info);
+            break;
+        case TASK_VERIFY:
+            future->result.verified = future->ctx != NULL
+                                      ? tc_verify_signature_ctx(future->signature, future->ctx, future->info)
+                                      : tc_verify_signature(future->signature, future->doc, future->info);
+            break;
+        case TASK_JOIN:
+            future->result.signature = tc_join_signatures(future->signatures, future->doc, future->info);
+            break;
+    }
+    future_complete(future);
+}
+
+static void * worker(void * arg) {
+    tc_engine_t * engine = arg;
+    for (;;) {
+        while (sem_wait(&engine->ready) != 0) {
+            assert(errno == EINTR);
+        }
+
+        /*
+         * Every post is a queued operation or, once stopping, a worker to stop. A pop can still miss an operation
+         * whose submitter hasn't filled its cell yet, so it is retried until the queue is really empty.
+         */
+        tc_future_t * future;
+        while ((future = ring_pop(&engine->queue)) == NULL) {
+            if (atomic_load(&engine->stopping) && ring_drained(&engine->queue)) {
+                tc_release_workspace();
+                return NULL;
+            }
+            sched_yield();
+        }
+        run(future);
+    }
+}
+
+/* Starts thread number index, pinned to the index-th CPU the process may use if pin isn't zero. */
+void start_worker(pthread_t * thread, void * (* fn)(void *), void * arg, int index, int pin) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    cpu_set_t allowed;
+    if (pin && sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0) {
+        int skip = index % CPU_COUNT(&allowed), cpu = 0;
+        while (!CPU_ISSET(cpu, &allowed) || skip-- > 0) {
+            cpu++;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+
+    int created = pthread_create(thread, &attr, fn, arg);
+    assert(created == 0);
+    (void) created;
+    pthread_attr_destroy(&attr);
+}
+
+tc_engine_t * tc_init_engine(int threads, size_t queue_size, int pin) {
+    assert(threads > 0);
+    tc_engine_t * engine = alloc(sizeof(tc_engine_t));
+    ring_init(&engine->queue, queue_size);
+    atomic_init(&engine->stopping, 0);
+    sem_init(&engine->ready, 0, 0);
+    engine->threads = threads;
+    engine->workers = alloc(threads * sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        start_worker(&engine->workers[i], worker, engine, i, pin);
+    }
+    return engine;
+}
+
+void tc_clear_engine(tc_engine_t * engine) {
+    atomic_store(&engine->stopping, 1);
+    for (int i = 0; i < engine->threads; i++) {
+        sem_post(&engine->ready);
+    }
+    for (int i = 0; i < engine->threads; i++) {
+        pthread_join(engine->workers[i], NULL);
+    }
+
+    sem_destroy(&engine->ready);
+    tc_free(engine->workers);
+    ring_clear(&engine->queue);
+    tc_free(engine);
+}
+
+tc_future_t * engine_submit(tc_engine_t * engine, tc_future_t * future) {
+    if (ring_push(&engine->queue, future) != 0) {
+        pool_free(future, sizeof(tc_future_t));
+        return NULL;
+    }
+    sem_post(&engine->ready);
+    return future;
+}
+
+tc_future_t * tc_engine_sign(tc_engine_t * engine, const key_share_t * share, const bytes_t * doc,
+                             const key_metainfo_t * info) {
+    tc_future_t * future = future_new(TASK_SIGN);
+    future->share = share;
+    future->doc = doc;
+    future->info = info;
+    return engine_submit(engine, future);
+}
+
+tc_future_t * tc_engine_verify(tc_engine_t * engine, const signature_share_t * signature, const bytes_t * doc,
+                               const key_metainfo_t * info) {
+    tc_future_t * future = future_new(TASK_VERIFY);
+    future->signature = signature;
+    future->doc = doc;
+    future->info = info;
+    return engine_submit(engine, future);
+}
+
+tc_future_t * tc_engine_join(tc_engine_t * engine, const signature_share_t ** signatures, const bytes_t * doc,
+                             const key_metainfo_t * info) {
+    tc_future_t * future = future_new(TASK_JOIN);
+    future->signatures = signatures;
+    future->doc = doc;
+    future->info = info;
+    return engine_submit(engine, future);
+}
+
+int tc_future_poll(const tc_future_t * future) {
+    return atomic_load_explicit(&future->state, memory_order_acquire) == FUTURE_DONE;
+}
+
+void tc_future_wait(tc_future_t * future) {
+    int state = atomic_load_explicit(&future->state, memory_order_acquire);
+    while (state != FUTURE_DONE) {
+        if (state == FUTURE_PENDING &&
+            !atomic_compare_exchange_weak_explicit(&future->state, &state, FUTURE_WAITING, memory_order_acquire,
+                                                   memory_order_acquire)) {
+            continue;
+        }
+        futex_wait(&future->state, FUTURE_WAITING);
+        state = atomic_load_explicit(&future->state, memory_order_acquire);
+    }
+}
+
+signature_share_t * tc_future_signature_share(tc_future_t * future) {
+    assert(future->kind == TASK_SIGN);
+    tc_future_wait(future);
+    return future->result.share;
+}
+
+int tc_future_verified(tc_future_t * future) {
+    assert(future->kind == TASK_VERIFY);
+    tc_future_wait(future);
+    return future->result.verified;
+}
+
+bytes_t * tc_future_signature(tc_future_t * future) {
+    assert(future->kind == TASK_JOIN);
+    tc_future_wait(future);
+    return future->result.signature;
+}
+
+void tc_clear_future(tc_future_t * future) {
+    tc_future_wait(future);
+    pool_free(future, sizeof(tc_future_t));
+}
+
+bytes_t * tc_engine_combine(tc_engine_t * engine, const signature_share_t ** signatures, const bytes_t * doc,
+                            const key_metainfo_t * info, int * valid) {
+    const int k = info->k;
+    tc_document_ctx_t * ctx = tc_init_document_ctx(doc, info);
+
+    /* The shares are verified by the workers, the ones the engine can't take by this thread after the join */
+    tc_future_t * futures[k];
+    for (int j = 0; j < k; j++) {
+        futures[j] = future_new(TASK_VERIFY);
+        futures[j]->signature = signatures[j];
+        futures[j]->ctx = ctx;
+        futures[j]->info = info;
+        futures[j] = engine_submit(engine, futures[j]);
+    }
+
+    /* Speculatively, the shares are most likely valid */
+    bytes_t * signature = tc_join_signatures_ctx(signatures, ctx, info);
+
+    int all_valid = 1;
+    for (int j = 0; j < k; j++) {
+        int verified;
+        if (futures[j] != NULL) {
+            verified = tc_future_verified(futures[j]);
+            tc_clear_future(futures[j]);
+        } else {
+            verified = tc_verify_signature_ctx(signatures[j], ctx, info);
+        }
+        if (valid != NULL) {
+            valid[j] = verified;
+        }
+        all_valid &= verified;
+    }
+
+    tc_clear_document_ctx(ctx);
+    if (!all_valid) {
+        tc_clear_bytes(signature);
+        return NULL;
+    }
+    return signature;
+}
@@ -0,0 +1,248 @@
+#include <assert.h>
+#include <gmp.h>
+#include <stdatomic.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Fixed-base exponentiation for the bases that never change for a key: v, and the inverse of each vk_i for the
+ * negative exponent of the verification. Each base gets a Lim-Lee comb table, built the first time it is used and
+ * published with a compare and swap, like the backend contexts.
+ *
+ * The exponent, of up to bits bits, is split in h rows of a bits, and each row in v blocks of b bits. The table holds
+ * G[j][u] = prod_{i in u} g^(2^(i*a + j*b)) for every j < v and every set u of rows, so the exponentiation takes b - 1
+ * squarings and up to v * b multiplications, instead of one squaring per bit. The shape (h, v) is the cheapest one that
+ * fits the memory budget of the table.
+ */
+
+/* Tables that don't fit their budget are remembered as this one, so they aren't tried again */
+static struct fixed_base no_table;
+
+int fixed_base_valid_shape(const struct fixed_base *fb) {
+    return 2 <= fb->h && fb->h <= 12 && 1 <= fb->v && fb->v <= 16 && fb->a == (fb->bits + fb->h - 1) / fb->h &&
+           fb->b == (fb->a + fb->v - 1) / fb->v;
+}
+
+static atomic_size_t key_budget = 1 << 20;
+
+void tc_set_fixed_base_budget(size_t bytes) {
+    atomic_store(&key_budget, bytes);
+}
+
+/* Chooses the cheapest shape within budget bytes, returns 0 if no comb is worth it. */
+static int choose_shape(struct fixed_base *fb, mp_bitcnt_t bits, mp_size_t size, size_t budget) {
+    mp_bitcnt_t best_cost = bits; /* A square and multiply takes at least one operation per bit */
+    int found = 0;
+
+    for (int h = 2; h <= 12; h++) {
+        for (int v = 1; v <= 16; v++) {
+            size_t bytes = sizeof(struct fixed_base) + FIXED_BASE_LIMBS(h, v, size) * sizeof(mp_limb_t);
+            if (bytes > budget) {
+                break;
+            }
+            mp_bitcnt_t a = (bits + h - 1) / h;
+            mp_bitcnt_t b = (a + v - 1) / v;
+            mp_bitcnt_t cost = b - 1 + v * b;
+            if (cost < best_cost) {
+                best_cost = cost;
+                fb->h = h;
+                fb->v = v;
+                fb->a = a;
+                fb->b = b;
+                found = 1;
+            }
+        }
+    }
+    return found;
+}
+
+/* Builds the table of g, or returns &no_table if it doesn't fit budget bytes. */
+static struct fixed_base *build(mpz_srcptr g, mp_bitcnt_t bits, size_t budget, const struct mont_ctx *ctx) {
+    struct fixed_base shape;
+    mp_size_t size = ctx->size;
+    if (!choose_shape(&shape, bits, size, budget)) {
+        return &no_table;
+    }
+
+    int h = shape.h, v = shape.v;
+    struct fixed_base *fb = alloc(sizeof(struct fixed_base) + FIXED_BASE_LIMBS(h, v, size) * sizeof(mp_limb_t));
+    mp_limb_t *table = (mp_limb_t *) (fb + 1);
+    *fb = shape;
+    fb->bits = bits;
+    fb->size = size;
+    fb->table = table;
+
+    mp_limb_t *scratch = workspace_limbs(3 * size);
+    mp_limb_t *cur = scratch, *tp = scratch + size;
+    mp_size_t g_size = mpz_size(g);
+    mpn_copyi(cur, mpz_limbs_read(g), g_size);
+    mpn_zero(cur + g_size, size - g_size);
+    ctx->mul(cur, cur, ctx->r2, tp, ctx);
+
+    /* G[j][2^i] = g^(2^(i*a + j*b)), the offsets grow with i and then j */
+    mp_bitcnt_t pos = 0;
+    for (int i = 0; i < h; i++) {
+        for (int j = 0; j < v && j * fb->b < fb->a; j++) {
+            for (; pos < i * fb->a + j * fb->b; pos++) {
+                ctx->sqr(cur, cur, tp, ctx);
+            }
+            mpn_copyi(table + (((mp_size_t) j << h) + (1 << i)) * size, cur, size);
+        }
+    }
+
+    /* Blocks past the end of the rows are never read */
+    for (int j = 0; j < v && j * fb->b < fb->a; j++) {
+        mp_limb_t *block = table + ((mp_size_t) j << h) * size;
+        for (int u = 3; u < (1 << h); u++) {
+            int low = u & -u;
+            if (u != low) {
+                ctx->mul(block + u * size, block + (u - low) * size, block + low * size, tp, ctx);
+            }
+        }
+    }
+
+    return fb;
+}
+
+/* Returns the table in slot, building it from g on first use. */
+static const struct fixed_base *lazy_table(_Atomic(struct fixed_base *) *slot, mpz_srcptr g, mp_bitcnt_t bits,
+                                           size_t budget, const struct mont_ctx *ctx) {
+    struct fixed_base *fb = atomic_load_explicit(slot, memory_order_acquire);
+    if (fb == NULL) {
+        struct fixed_base *created = build(g, bits, budget, ctx);
+
+        /* Threads racing to build it keep the first one */
+        if (atomic_compare_exchange_strong(slot, &fb, created)) {
+            fb = created;
+        } else if (created != &no_table) {
+            tc_free(created);
+        }
+    }
+    return fb == &no_table ? NULL : fb;
+}
+
+/*
+ * The table of v covers the exponents of the algorithms: r has two hash lengths more than n, and z = c*s_i + r one
+ * bit more. It takes half the budget of the key.
+ */
+mp_bitcnt_t fixed_base_v_bits(const struct key_params *params) {
+    mpz_t n;
+    TC_LIMBS_VIEW(n, params->n, params->n_limbs);
+    return mpz_sizeinbase(n, 2) + 2 * 32 * 8 + 1;
+}
+
+const struct fixed_base *fixed_base_v(const struct key_params *params) {
+    if (tc_get_backend() != TC_BACKEND_GMP) {
+        return NULL;
+    }
+
+    mpz_t v;
+    TC_LIMBS_VIEW(v, params->vk_v, params->n_limbs);
+    return lazy_table(&((struct key_params *) params)->v_table, v, fixed_base_v_bits(params),
+                      atomic_load(&key_budget) / 2, &params->mont);
+}
+
+/* The tables of the vk_i^-1 cover the challenges, and share the other half of the budget. */
+const struct fixed_base *fixed_base_vk_inverse(const key_metainfo_t *info, uint16_t id) {
+    assert(0 < id && id <= info->l);
+    _Atomic(struct fixed_base *) *slot = &info->vk_inverse_tables[TC_ID_TO_INDEX(id)];
+    if (tc_get_backend() != TC_BACKEND_GMP) {
+        return NULL;
+    }
+
+    struct fixed_base *fb = atomic_load_explicit(slot, memory_order_acquire);
+    if (fb != NULL) {
+        return fb == &no_table ? NULL : fb;
+    }
+
+    const struct key_params *params = &info->params;
+    int mark = workspace_begin(params->n_limbs);
+    mpz_ptr inverse = workspace_take();
+    mpz_t vk_i, n;
+    TC_LIMBS_VIEW(vk_i, TC_VK_I(info, id), params->n_limbs);
+    TC_LIMBS_VIEW(n, params->n, params->n_limbs);
+    if (!mpz_invert(inverse, vk_i, n)) {
+        workspace_end(mark);
+        return NULL;
+    }
+
+    const struct fixed_base *table = lazy_table(slot, inverse, FIXED_BASE_VK_BITS,
+                                                atomic_load(&key_budget) / 2 / info->l, &params->mont);
+    workspace_end(mark);
+    return table;
+}
+
+/*
+ * r = g^e mod n, g the base of table. Returns 0 without touching r if there is no table, or if e is negative or
+ * longer than the table covers.
+ */
+int fixed_base_powm(mpz_ptr r, mpz_srcptr e, const struct fixed_base *fb, const struct key_params *params) {
+    if (fb == NULL || mpz_sgn(e) < 0 || mpz_sizeinbase(e, 2) > fb->bits) {
+        return 0;
+    }
+    if (mpz_sgn(e) == 0) {
+        mpz_set_ui(r, 1);
+        return 1;
+    }
+
+    const struct mont_ctx *ctx = &params->mont;
+    mp_size_t size = fb->size;
+    mp_limb_t *scratch = workspace_limbs(3 * size);
+    mp_limb_t *acc = scratch, *tp = scratch + size;
+    const mp_limb_t *ep = mpz_limbs_read(e);
+    mp_bitcnt_t e_bits = mpz_size(e) * GMP_NUMB_BITS;
+    int started = 0;
+
+    for (mp_bitcnt_t k = fb->b; k-- > 0;) {
+        if (started) {
+            ctx->sqr(acc, acc, tp, ctx);
+        }
+        for (int j = 0; j < fb->v && j * fb->b + k < fb->a; j++) {
+            int u = 0;
+            for (int i = 0; i < fb->h; i++) {
+                mp_bitcnt_t pos = i * fb->a + j * fb->b + k;
+                if (pos < e_bits) {
+                    u |= ((ep[pos / GMP_NUMB_BITS] >> (pos % GMP_NUMB_BITS)) & 1) << i;
+                }
+            }
+            if (u == 0) {
+                continue;
+            }
+            const mp_limb_t *entry = fb->table + (((mp_size_t) j << fb->h) + u) * size;
+            if (started) {
+                ctx->mul(acc, acc, entry, tp, ctx);
+            } else {
+                mpn_copyi(acc, entry, size);
+                started = 1;
+            }
+        }
+    }
+
+    /* Out of the Montgomery form. e isn't read anymore, so r may be e */
+    mpn_copyi(tp, acc, size);
+    mpn_zero(tp + size, size);
+    ctx->redc(acc, tp, ctx);
+    mpn_copyi(mpz_limbs_write(r, size), acc, size);
+    mpz_limbs_finish(r, size);
+    return 1;
+}
+
+static void release(_Atomic(struct fixed_base *) *slot) {
+    struct fixed_base *fb = atomic_load(slot);
+    if (fb != NULL && fb != &no_table) {
+        tc_free(fb);
+    }
+    atomic_store(slot, NULL);
+}
+
+void fixed_base_clear_key_params(struct key_params *params) {
+    release(&params->v_table);
+}
+
+void fixed_base_clear_key_metainfo(key_metainfo_t *info) {
+    for (int i = 0; i < info->l; i++) {
+        release(&info->vk_inverse_tables[i]);
+    }
+    fixed_base_clear_key_params(&info->params);
+}
@@ -0,0 +1,94 @@
+#include <assert.h>
+#include <gmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/* Default allocator, backed by the C library. */
+
+static void *default_malloc(void *ctx, size_t size) {
+    (void) ctx;
+    return malloc(size);
+}
+
+static void *default_realloc(void *ctx, void *ptr, size_t size) {
+    (void) ctx;
+    return realloc(ptr, size);
+}
+
+static void default_free(void *ctx, void *ptr) {
+    (void) ctx;
+    free(ptr);
+}
+
+static struct {
+    tc_malloc_fn malloc_fn;
+    tc_realloc_fn realloc_fn;
+    tc_free_fn free_fn;
+    void *ctx;
+} allocator = { default_malloc, default_realloc, default_free, NULL };
+
+void * alloc(size_t size) {
+    void * b = allocator.malloc_fn(allocator.ctx, size);
+    if (b == NULL) {
+        perror("alloc");
+        abort();
+    }
+    return b;
+}
+
+void * ralloc(void * ptr, size_t size) {
+    void * b = allocator.realloc_fn(allocator.ctx, ptr, size);
+    if (b == NULL) {
+        perror("ralloc");
+        abort();
+    }
+    return b;
+}
+
+void tc_free(void * ptr) {
+    if (ptr != NULL) {
+        allocator.free_fn(allocator.ctx, ptr);
+    }
+}
+
+/* GMP doesn't carry a context pointer, so its hooks go through the global allocator. */
+
+static void *gmp_alloc(size_t size) {
+    return alloc(size);
+}
+
+static void *gmp_realloc(void *ptr, size_t old_size, size_t new_size) {
+    (void) old_size;
+    return ralloc(ptr, new_size);
+}
+
+static void gmp_free(void *ptr, size_t size) {
+    (void) size;
+    tc_free(ptr);
+}
+
+void tc_set_allocator(tc_malloc_fn malloc_fn, tc_realloc_fn realloc_fn, tc_free_fn free_fn, void *ctx, int gmp) {
+    assert((malloc_fn == NULL) == (realloc_fn == NULL) && (realloc_fn == NULL) == (free_fn == NULL));
+
+    if (malloc_fn == NULL) {
+        allocator.malloc_fn = default_malloc;
+        allocator.realloc_fn = default_realloc;
+        allocator.free_fn = default_free;
+        allocator.ctx = NULL;
+    } else {
+        allocator.malloc_fn = malloc_fn;
+        allocator.realloc_fn = realloc_fn;
+        allocator.free_fn = free_fn;
+        allocator.ctx = ctx;
+    }
+
+    if (gmp) {
+        mp_set_memory_functions(gmp_alloc, gmp_realloc, gmp_free);
+    } else {
+        /* NULL restores the GMP defaults */
+        mp_set_memory_functions(NULL, NULL, NULL);
+    }
+}
@@ -0,0 +1,390 @@
+#include <assert.h>
+#include <gmp.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tc_internal.h"
+
+/*
+ * Modular exponentiation with a Montgomery context precomputed once per key, on top of the mpn layer. mpz_powm
+ * rebuilds its reduction setup on every call; here -n^-1 mod B, R mod n and R^2 mod n (R = B^size, B the limb base)
+ * live in the key.
+ *
+ * The products themselves use GMP's assembly mpn_mul_n and mpn_sqr. The reduction is a word-by-word REDC written as a
+ * loop over the size of n; for the common key sizes it is instantiated with a constant size, so the compiler unrolls
+ * it and the products are dispatched to fixed-size code.
+ *
+ * mont_multi_powm raises one base to several exponents. The squarings of the base only depend on the base, so they
+ * are computed once for all the exponents, and each exponent only adds its multiplications.
+ */
+
+#define MONT_MAX_WINDOW 6
+
+/* rp = tp / R mod n. tp has 2 * size limbs and is destroyed. */
+static inline __attribute__((always_inline)) void redc_n(mp_limb_t *rp, mp_limb_t *tp, const mp_limb_t *np,
+                                                          mp_size_t size, mp_limb_t n_inv) {
+    /* The carry out of each step belongs size limbs above, it is kept in the limb the step just cleared */
+#pragma GCC unroll 8
+    for (mp_size_t i = 0; i < size; i++) {
+        mp_limb_t q = tp[i] * n_inv;
+        tp[i] = mpn_addmul_1(tp + i, np, size, q);
+    }
+
+    mp_limb_t carry = mpn_add_n(rp, tp + size, tp, size);
+    if (carry != 0 || mpn_cmp(rp, np, size) >= 0) {
+        mpn_sub_n(rp, rp, np, size);
+    }
+}
+
+static void redc_generic(mp_limb_t *rp, mp_limb_t *tp, const struct mont_ctx *ctx) {
+    redc_n(rp, tp, ctx->n, ctx->size, ctx->n_inv);
+}
+
+static void mul_generic(mp_limb_t *rp, const mp_limb_t *ap, const mp_limb_t *bp, mp_limb_t *tp,
+                        const struct mont_ctx *ctx) {
+    mpn_mul_n(tp, ap, bp, ctx->size);
+    redc_n(rp, tp, ctx->n, ctx->size, ctx->n_inv);
+}
+
+static void sqr_generic(mp_limb_t *rp, const mp_limb_t *ap, mp_limb_t *tp, const struct mont_ctx *ctx) {
+    mpn_sqr(tp, ap, ctx->size);
+    redc_n(rp, tp, ctx->n, ctx->size, ctx->n_inv);
+}
+
+#define MONT_FIXED(bits) \
+    static void redc_##bits(mp_limb_t *rp, mp_limb_t *tp, const struct mont_ctx *ctx) { \
+        redc_n(rp, tp, ctx->n, (bits) / GMP_NUMB_BITS, ctx->n_inv); \
+    } \
+    static void mul_##bits(mp_limb_t *rp, const mp_limb_t *ap, const mp_limb_t *bp, mp_limb_t *tp, \
+                           const struct mont_ctx *ctx) { \
+        mpn_mul_n(tp, ap, bp, (bits) / GMP_NUMB_BITS); \
+        redc_n(rp, tp, ctx->n, (bits) / GMP_NUMB_BITS, ctx->n_inv); \
+    } \
+    static void sqr_##bits(mp_limb_t *rp, const mp_limb_t *ap, mp_limb_t *tp, const struct mont_ctx *ctx) { \
+        mpn_sqr(tp, ap, (bits) / GMP_NUMB_BITS); \
+        redc_n(rp, tp, ctx->n, (bits) / GMP_NUMB_BITS, ctx->n_inv); \
+    }
+
+MONT_FIXED(2048)
+MONT_FIXED(3072)
+MONT_FIXED(4096)
+
+/* -n0^-1 mod B, by Newton iteration. Each step doubles the correct low bits, n0 * n0 = 1 mod 8 to start with. */
+static mp_limb_t limb_neg_inverse(mp_limb_t n0) {
+    assert(n0 & 1);
+    mp_limb_t inv = n0;
+    for (int bits = 3; bits < GMP_NUMB_BITS; bits *= 2) {
+        inv *= 2 - n0 * inv;
+    }
+    return -inv;
+}
+
+void mont_init(struct mont_ctx *ctx, const mp_limb_t *n, mp_size_t n_limbs) {
+    mp_size_t size = n_limbs;
+    while (size > 0 && n[size - 1] == 0) {
+        size--;
+    }
+    assert(size > 0 && (n[0] & 1));
+
+    ctx->size = size;
+    ctx->n = n;
+    ctx->n_inv = limb_neg_inverse(n[0]);
+
+    mpz_t nz, r;
+    mpz_roinit_n(nz, n, size);
+    mpz_init(r);
+    mpz_setbit(r, size * GMP_NUMB_BITS);
+    mpz_mod(r, r, nz);
+    TC_MPZ_TO_LIMBS(ctx->one, size, r);
+    mpz_mul(r, r, r);
+    mpz_mod(r, r, nz);
+    TC_MPZ_TO_LIMBS(ctx->r2, size, r);
+    mpz_clear(r);
+
+    switch (size * GMP_NUMB_BITS) {
+        case 2048:
+            ctx->redc = redc_2048;
+            ctx->mul = mul_2048;
+            ctx->sqr = sqr_2048;
+            break;
+        case 3072:
+            ctx->redc = redc_3072;
+            ctx->mul = mul_3072;
+            ctx->sqr = sqr_3072;
+            break;
+        case 4096:
+            ctx->redc = redc_4096;
+            ctx->mul = mul_4096;
+            ctx->sqr = sqr_4096;
+            break;
+        default:
+            ctx->redc = redc_generic;
+            ctx->mul = mul_generic;
+            ctx->sqr = sqr_generic;
+    }
+}
+
+static int window_size(mp_bitcnt_t bits) {
+    return bits > 671 ? 6 : bits > 239 ? 5 : bits > 79 ? 4 : bits > 23 ? 3 : 1;
+}
+
+/* Bits [pos, pos + count) of the exponent. */
+static mp_limb_t exponent_bits(const mp_limb_t *ep, mp_bitcnt_t pos, int count) {
+    mp_size_t i = pos / GMP_NUMB_BITS;
+    int shift = pos % GMP_NUMB_BITS;
+    mp_limb_t bits = ep[i] >> shift;
+    if (shift + count > GMP_NUMB_BITS) {
+        bits |= ep[i + 1] << (GMP_NUMB_BITS - shift);
+    }
+    return bits & (((mp_limb_t) 1 << count) - 1);
+}
+
+mp_size_t mont_scratch_size(const struct mont_ctx *ctx) {
+    return ((1 << (MONT_MAX_WINDOW - 1)) + 3) * ctx->size;
+}
+
+/*
+ * rp = bp^ep mod n with a sliding window, left to right. bp has size limbs and is lower than n, ep has bits > 0
+ * significant bits. scratch has mont_scratch_size limbs and must not overlap rp nor bp.
+ */
+void mont_powm_limbs(mp_limb_t *rp, const mp_limb_t *bp, const mp_limb_t *ep, mp_bitcnt_t bits,
+                     const struct mont_ctx *ctx, mp_limb_t *scratch) {
+    assert(bits > 0);
+    mp_size_t size = ctx->size;
+    int w = window_size(bits);
+
+    /* table[i] = b^(2i+1) * R mod n, the odd powers a window can end with */
+    mp_limb_t *table = scratch;
+    mp_limb_t *b2 = table + ((mp_size_t) 1 << (w - 1)) * size;
+    mp_limb_t *tp = b2 + size;
+    ctx->mul(table, bp, ctx->r2, tp, ctx);
+    ctx->sqr(b2, table, tp, ctx);
+    for (mp_size_t i = 1; i < ((mp_size_t) 1 << (w - 1)); i++) {
+        ctx->mul(table + i * size, table + (i - 1) * size, b2, tp, ctx);
+    }
+
+    int started = 0;
+    mp_bitcnt_t pos = bits; /* Bits of the exponent still to process */
+    while (pos > 0) {
+        if (((ep[(pos - 1) / GMP_NUMB_BITS] >> ((pos - 1) % GMP_NUMB_BITS)) & 1) == 0) {
+            ctx->sqr(rp, rp, tp, ctx);
+            pos--;
+            continue;
+        }
+
+        int len = pos < (mp_bitcnt_t) w ? (int) pos : w;
+        mp_limb_t window = exponent_bits(ep, pos - len, len);
+        while ((window & 1) == 0) {
+            window >>= 1;
+            len--;
+        }
+        pos -= len;
+
+        if (started) {
+            for (int i = 0; i < len; i++) {
+                ctx->sqr(rp, rp, tp, ctx);
+            }
+            ctx->mul(rp, rp, table + (window >> 1) * size, tp, ctx);
+        } else {
+            mpn_copyi(rp, table + (window >> 1) * size, size);
+            started = 1;
+        }
+    }
+
+    /* Out of the Montgomery form */
+    mpn_copyi(tp, rp, size);
+    mpn_zero(tp + size, size);
+    ctx->redc(rp, tp, ctx);
+}
+
+/* r = b^e mod n for b in [0, n) and a word e > 0, by square and multiply: short exponents don't need a window table. */
+void mont_powm_ui(mpz_ptr r, mpz_srcptr b, unsigned long e, const struct mont_ctx *ctx) {
+    assert(e > 0 && mpz_sgn(b) >= 0 && mpz_size(b) <= (size_t) ctx->size);
+    mp_size_t size = ctx->size;
+    mp_limb_t *scratch = workspace_limbs(4 * size);
+    mp_limb_t *bm = scratch, *rp = scratch + size, *tp = rp + size;
+
+    mp_size_t b_size = mpz_size(b);
+    mpn_copyi(rp, mpz_limbs_read(b), b_size);
+    mpn_zero(rp + b_size, size - b_size);
+    ctx->mul(bm, rp, ctx->r2, tp, ctx);
+    mpn_copyi(rp, bm, size);
+
+    int top = 8 * sizeof(unsigned long) - 1;
+    while (((e >> top) & 1) == 0) {
+        top--;
+    }
+    for (int i = top - 1; i >= 0; i--) {
+        ctx->sqr(rp, rp, tp, ctx);
+        if ((e >> i) & 1) {
+            ctx->mul(rp, rp, bm, tp, ctx);
+        }
+    }
+
+    /* Out of the Montgomery form */
+    mpn_copyi(tp, rp, size);
+    mpn_zero(tp + size, size);
+    ctx->redc(rp, tp, ctx);
+    mpn_copyi(mpz_limbs_write(r, size), rp, size);
+    mpz_limbs_finish(r, size);
+}
+
+void mont_powm(mpz_ptr r, mpz_srcptr b, mpz_srcptr e, const struct mont_ctx *ctx) {
+    mp_size_t size = ctx->size;
+    mpz_t n;
+    mpz_roinit_n(n, ctx->n, size);
+
+    int mark = workspace_begin(size);
+
+    /* Like mpz_powm, a negative exponent means a power of the inverse */
+    if (mpz_sgn(e) < 0) {
+        mpz_ptr inverse = workspace_take();
+        int invertible = mpz_invert(inverse, b, n);
+        assert(invertible);
+        (void) invertible;
+        b = inverse;
+    } else if (mpz_sgn(b) < 0 || mpz_cmp(b, n) >= 0) {
+        mpz_ptr reduced = workspace_take();
+        mpz_mod(reduced, b, n);
+        b = reduced;
+    }
+
+    if (mpz_sgn(e) == 0) {
+        mpz_set_ui(r, 1);
+        workspace_end(mark);
+        return;
+    }
+
+    mp_limb_t *scratch = workspace_limbs(mont_scratch_size(ctx) + 2 * size);
+    mp_limb_t *bp = scratch + mont_scratch_size(ctx);
+    mp_limb_t *rp = bp + size;
+
+    mp_size_t b_size = mpz_size(b);
+    mpn_copyi(bp, mpz_limbs_read(b), b_size);
+    mpn_zero(bp + b_size, size - b_size);
+    mont_powm_limbs(rp, bp, mpz_limbs_read(e), mpz_sizeinbase(e, 2), ctx, scratch);
+
+    /* r may be b or e, it is only written once both have been read */
+    mpn_copyi(mpz_limbs_write(r, size), rp, size);
+    mpz_limbs_finish(r, size);
+
+    workspace_end(mark);
+}
+
+/* Window of mont_multi_powm: a multiplication per window of the exponent, and two per bucket to combine them. */
+static int multi_window_size(mp_bitcnt_t bits) {
+    int best = 1;
+    mp_bitcnt_t best_cost = bits + 4;
+    for (int w = 2; w <= MONT_MAX_WINDOW; w++) {
+        mp_bitcnt_t cost = (bits + w - 1) / w + ((mp_bitcnt_t) 2 << w);
+        if (cost < best_cost) {
+            best = w;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+/* Bits [pos, pos + count) of e, zero past its end. */
+static mp_limb_t exponent_digit(mpz_srcptr e, mp_bitcnt_t pos, int count) {
+    mp_size_t i = pos / GMP_NUMB_BITS;
+    int shift = pos % GMP_NUMB_BITS;
+    mp_limb_t bits = mpz_getlimbn(e, i) >> shift;
+    if (shift + count > GMP_NUMB_BITS) {
+        bits |= mpz_getlimbn(e, i + 1) << (GMP_NUMB_BITS - shift);
+    }
+    return bits & (((mp_limb_t) 1 << count) - 1);
+}
+
+/*
+ * r[i] = b^e[i] mod n for count non-negative exponents, with Yao's method: the base is squared along the longest
+ * exponent once, and g = b^(2^(w*k)) is multiplied into the bucket of the k-th window digit of every exponent. Then
+ * each exponent is prod_d bucket[d]^d, which takes two multiplications per bucket. The results may be the exponents.
+ */
+void mont_multi_powm(mpz_ptr *r, mpz_srcptr b, mpz_srcptr *e, size_t count, const struct mont_ctx *ctx) {
+    mp_size_t size = ctx->size;
+    mpz_t n;
+    mpz_roinit_n(n, ctx->n, size);
+
+    int mark = workspace_begin(size);
+    if (mpz_sgn(b) < 0 || mpz_cmp(b, n) >= 0) {
+        mpz_ptr reduced = workspace_take();
+        mpz_mod(reduced, b, n);
+        b = reduced;
+    }
+
+    mp_bitcnt_t bits = 0;
+    for (size_t i = 0; i < count; i++) {
+        assert(mpz_sgn(e[i]) >= 0);
+        if (mpz_sgn(e[i]) > 0 && mpz_sizeinbase(e[i], 2) > bits) {
+            bits = mpz_sizeinbase(e[i], 2);
+        }
+    }
+
+    int w = multi_window_size(bits);
+    size_t buckets = (size_t) 1 << w; /* Bucket 0 of every exponent is unused */
+    mp_size_t flag_limbs = (count * buckets + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t);
+    mp_limb_t *bucket = workspace_limbs(count * buckets * size + 5 * size + flag_limbs);
+    mp_limb_t *g = bucket + count * buckets * size, *acc = g + size, *run = acc + size, *tp = run + size;
+    uint8_t *used = (uint8_t *) (tp + 2 * size); /* Buckets that hold a product */
+    memset(used, 0, count * buckets);
+
+    mp_size_t b_size = mpz_size(b);
+    mpn_copyi(acc, mpz_limbs_read(b), b_size);
+    mpn_zero(acc + b_size, size - b_size);
+    ctx->mul(g, acc, ctx->r2, tp, ctx);
+
+    for (mp_bitcnt_t pos = 0; pos < bits; pos += w) {
+        if (pos > 0) {
+            for (int i = 0; i < w; i++) {
+                ctx->sqr(g, g, tp, ctx);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            mp_limb_t d = exponent_digit(e[i], pos, w);
+            if (d == 0) {
+                continue;
+            }
+            size_t slot = i * buckets + d;
+            if (used[slot]) {
+                ctx->mul(bucket + slot * size, bucket + slot * size, g, tp, ctx);
+            } else {
+                mpn_copyi(bucket + slot * size, g, size);
+                used[slot] = 1;
+            }
+        }
+    }
+
+    /* The exponents have been read, the results can be written */
+    for (size_t i = 0; i < count; i++) {
+        int started = 0;
+        for (size_t d = buckets - 1; d > 0; d--) {
+            size_t slot = i * buckets + d;
+            if (used[slot]) {
+                if (started) {
+                    ctx->mul(run, run, bucket + slot * size, tp, ctx);
+                } else {
+                    mpn_copyi(run, bucket + slot * size, size);
+                }
+            }
+            if (started) {
+                ctx->mul(acc, acc, run, tp, ctx);
+            } else if (used[slot]) {
+                mpn_copyi(acc, run, size);
+                started = 1;
+            }
+        }
+
+        if (!started) {
+            mpz_set_ui(r[i], 1);
+            continue;
+        }
+        mpn_copyi(tp, acc, size);
+        mpn_zero(tp + size, size);
+        ctx->redc(acc, tp, ctx);
+        mpn_copyi(mpz_limbs_write(r[i], size), acc, size);
+        mpz_limbs_finish(r[i], size);
+    }
+
+    workspace_end(mark);
+}
@@ -0,0 +1,125 @@
+#include "tc_internal.h"
+
+#ifdef MB_KERNELS
+
+#include <immintrin.h>
+#include <stdint.h>
+
+/*
+ * AVX2 kernel: 4 lanes of 27-bit digits, multiplied with vpmuludq. Products take 54 bits, so the 64-bit accumulators
+ * hold the 2 * digits products a digit can receive without carrying in between, for any supported key size.
+ */
+
+#define TARGET __attribute__((target("avx2")))
+#define LANES 4
+#define DIGIT_BITS 27
+#define WINDOW 5
+
+/*
+ * Almost Montgomery multiplication: r = a * b / R mod n, lower than 2n as long as a and b are and 4n < R. t is
+ * scratch for 2 * digits + 1 vectors. r may be a or b.
+ */
+TARGET static void amm(__m256i *r, const __m256i *a, const __m256i *b, const __m256i *n, __m256i k0, int digits,
+                       __m256i *t) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mask = _mm256_set1_epi64x((1LL << DIGIT_BITS) - 1);
+    for (int i = 0; i < 2 * digits + 1; i++) {
+        t[i] = zero;
+    }
+
+    for (int i = 0; i < digits; i++) {
+        __m256i *ti = t + i;
+        __m256i ai = a[i];
+        for (int j = 0; j < digits; j++) {
+            ti[j] = _mm256_add_epi64(ti[j], _mm256_mul_epu32(ai, b[j]));
+        }
+
+        /* Every contribution to digit i is in, q clears its low bits */
+        __m256i q = _mm256_and_si256(_mm256_mul_epu32(ti[0], k0), mask);
+        for (int j = 0; j < digits; j++) {
+            ti[j] = _mm256_add_epi64(ti[j], _mm256_mul_epu32(q, n[j]));
+        }
+        ti[1] = _mm256_add_epi64(ti[1], _mm256_srli_epi64(ti[0], DIGIT_BITS));
+    }
+
+    __m256i carry = zero;
+    for (int j = 0; j < digits; j++) {
+        __m256i digit = _mm256_add_epi64(t[digits + j], carry);
+        r[j] = _mm256_and_si256(digit, mask);
+        carry = _mm256_srli_epi64(digit, DIGIT_BITS);
+    }
+}
+
+/* r = table[index], for the index of each lane. Reads every entry, so the access pattern doesn't depend on it. */
+TARGET static void select_entry(__m256i *r, const __m256i *table, __m256i index, int digits) {
+    for (int j = 0; j < digits; j++) {
+        r[j] = table[j];
+    }
+    for (int k = 1; k < (1 << WINDOW); k++) {
+        __m256i match = _mm256_cmpeq_epi64(index, _mm256_set1_epi64x(k));
+        const __m256i *entry = table + k * digits;
+        for (int j = 0; j < digits; j++) {
+            r[j] = _mm256_blendv_epi8(r[j], entry[j], match);
+        }
+    }
+}
+
+/* Bits [pos, pos + count) of the exponent of each lane. */
+TARGET static __m256i exponent_window(const uint64_t *e, mp_bitcnt_t pos, int count) {
+    const __m256i *limbs = (const __m256i *) e;
+    int shift = pos % 64;
+    __m256i window = _mm256_srl_epi64(limbs[pos / 64], _mm_cvtsi32_si128(shift));
+    if (shift + count > 64) {
+        window = _mm256_or_si256(window, _mm256_sll_epi64(limbs[pos / 64 + 1], _mm_cvtsi32_si128(64 - shift)));
+    }
+    return _mm256_and_si256(window, _mm256_set1_epi64x((1LL << count) - 1));
+}
+
+size_t mb_avx2_scratch_size(int digits) {
+    /* table, t, n, rr, one, acc and entry */
+    return (((size_t) 1 << WINDOW) * digits + 2 * digits + 1 + 5 * digits) * sizeof(__m256i);
+}
+
+TARGET void mb_avx2_powm(uint64_t *r, const uint64_t *b, const struct mb_args *args, void *scratch) {
+    int digits = args->digits;
+    __m256i *table = scratch;
+    __m256i *t = table + (1 << WINDOW) * digits;
+    __m256i *n = t + 2 * digits + 1;
+    __m256i *rr = n + digits;
+    __m256i *one = rr + digits;
+    __m256i *acc = one + digits;
+    __m256i *entry = acc + digits;
+
+    for (int j = 0; j < digits; j++) {
+        n[j] = _mm256_set1_epi64x(args->n[j]);
+        rr[j] = _mm256_set1_epi64x(args->rr[j]);
+        one[j] = _mm256_set1_epi64x(j == 0);
+    }
+    __m256i k0 = _mm256_set1_epi64x(args->k0);
+
+    /* table[i] = b^i * R mod n */
+    amm(table, one, rr, n, k0, digits, t);
+    amm(table + digits, (const __m256i *) b, rr, n, k0, digits, t);
+    for (int i = 2; i < (1 << WINDOW); i++) {
+        amm(table + i * digits, table + (i - 1) * digits, table + digits, n, k0, digits, t);
+    }
+
+    mp_bitcnt_t bits = args->e_bits;
+    int first = bits % WINDOW ? bits % WINDOW : WINDOW;
+    mp_bitcnt_t pos = bits - first;
+    select_entry(acc, table, exponent_window(args->e, pos, first), digits);
+
+    while (pos > 0) {
+        pos -= WINDOW;
+        for (int i = 0; i < WINDOW; i++) {
+            amm(acc, acc, acc, n, k0, digits, t);
+        }
+        select_entry(entry, table, exponent_window(args->e, pos, WINDOW), digits);
+        amm(acc, acc, entry, n, k0, digits, t);
+    }
+
+    /* Out of the Montgomery form, the result may still be n */
+    amm((__m256i *) r, acc, one, n, k0, digits, t);
+}
+
+#endif
@@ -0,0 +1,127 @@
+#include "tc_internal.h"
+
+#ifdef MB_KERNELS
+
+#include <immintrin.h>
+#include <stdint.h>
+
+/*
+ * AVX-512 IFMA kernel: 8 lanes of 52-bit digits, multiplied with vpmadd52luq/vpmadd52huq. Compiled for the target
+ * through function attributes, it only runs when the CPU reports avx512ifma.
+ */
+
+#define TARGET __attribute__((target("avx512f,avx512ifma")))
+#define LANES 8
+#define DIGIT_BITS 52
+#define WINDOW 5
+
+/*
+ * Almost Montgomery multiplication: r = a * b / R mod n, lower than 2n as long as a and b are and 4n < R. t is
+ * scratch for 2 * digits + 1 vectors. r may be a or b.
+ */
+TARGET static void amm(__m512i *r, const __m512i *a, const __m512i *b, const __m512i *n, __m512i k0, int digits,
+                       __m512i *t) {
+    const __m512i zero = _mm512_setzero_si512();
+    for (int i = 0; i < 2 * digits + 1; i++) {
+        t[i] = zero;
+    }
+
+    for (int i = 0; i < digits; i++) {
+        __m512i *ti = t + i;
+        __m512i ai = a[i];
+        for (int j = 0; j < digits; j++) {
+            ti[j] = _mm512_madd52lo_epu64(ti[j], ai, b[j]);
+            ti[j + 1] = _mm512_madd52hi_epu64(ti[j + 1], ai, b[j]);
+        }
+
+        /* Every contribution to digit i is in, q clears its low 52 bits */
+        __m512i q = _mm512_madd52lo_epu64(zero, ti[0], k0);
+        for (int j = 0; j < digits; j++) {
+            ti[j] = _mm512_madd52lo_epu64(ti[j], q, n[j]);
+            ti[j + 1] = _mm512_madd52hi_epu64(ti[j + 1], q, n[j]);
+        }
+        ti[1] = _mm512_add_epi64(ti[1], _mm512_srli_epi64(ti[0], DIGIT_BITS));
+    }
+
+    const __m512i mask = _mm512_set1_epi64((1ULL << DIGIT_BITS) - 1);
+    __m512i carry = zero;
+    for (int j = 0; j < digits; j++) {
+        __m512i digit = _mm512_add_epi64(t[digits + j], carry);
+        r[j] = _mm512_and_si512(digit, mask);
+        carry = _mm512_srli_epi64(digit, DIGIT_BITS);
+    }
+}
+
+/* r = table[index], for the index of each lane. Reads every entry, so the access pattern doesn't depend on it. */
+TARGET static void select_entry(__m512i *r, const __m512i *table, __m512i index, int digits) {
+    for (int j = 0; j < digits; j++) {
+        r[j] = table[j];
+    }
+    for (int k = 1; k < (1 << WINDOW); k++) {
+        __mmask8 match = _mm512_cmpeq_epi64_mask(index, _mm512_set1_epi64(k));
+        const __m512i *entry = table + k * digits;
+        for (int j = 0; j < digits; j++) {
+            r[j] = _mm512_mask_blend_epi64(match, r[j], entry[j]);
+        }
+    }
+}
+
+/* Bits [pos, pos + WINDOW) of the exponent of each lane. */
+TARGET static __m512i exponent_window(const uint64_t *e, mp_bitcnt_t pos, int count) {
+    const __m512i *limbs = (const __m512i *) e;
+    int shift = pos % 64;
+    __m512i window = _mm512_srl_epi64(limbs[pos / 64], _mm_cvtsi32_si128(shift));
+    if (shift + count > 64) {
+        window = _mm512_or_si512(window, _mm512_sll_epi64(limbs[pos / 64 + 1], _mm_cvtsi32_si128(64 - shift)));
+    }
+    return _mm512_and_si512(window, _mm512_set1_epi64((1ULL << count) - 1));
+}
+
+size_t mb_ifma_scratch_size(int digits) {
+    /* table, t, n, rr, one, acc and entry */
+    return (((size_t) 1 << WINDOW) * digits + 2 * digits + 1 + 5 * digits) * sizeof(__m512i);
+}
+
+TARGET void mb_ifma_powm(uint64_t *r, const uint64_t *b, const struct mb_args *args, void *scratch) {
+    int digits = args->digits;
+    __m512i *table = scratch;
+    __m512i *t = table + (1 << WINDOW) * digits;
+    __m512i *n = t + 2 * digits + 1;
+    __m512i *rr = n + digits;
+    __m512i *one = rr + digits;
+    __m512i *acc = one + digits;
+    __m512i *entry = acc + digits;
+
+    for (int j = 0; j < digits; j++) {
+        n[j] = _mm512_set1_epi64(args->n[j]);
+        rr[j] = _mm512_set1_epi64(args->rr[j]);
+        one[j] = _mm512_set1_epi64(j == 0);
+    }
+    __m512i k0 = _mm512_set1_epi64(args->k0);
+
+    /* table[i] = b^i * R mod n */
+    amm(table, one, rr, n, k0, digits, t);
+    amm(table + digits, (const __m512i *) b, rr, n, k0, digits, t);
+    for (int i = 2; i < (1 << WINDOW); i++) {
+        amm(table + i * digits, table + (i - 1) * digits, table + digits, n, k0, digits, t);
+    }
+
+    mp_bitcnt_t bits = args->e_bits;
+    int first = bits % WINDOW ? bits % WINDOW : WINDOW;
+    mp_bitcnt_t pos = bits - first;
+    select_entry(acc, table, exponent_window(args->e, pos, first), digits);
+
+    while (pos > 0) {
+        pos -= WINDOW;
+        for (int i = 0; i < WINDOW; i++) {
+            amm(acc, acc, acc, n, k0, digits, t);
+        }
+        select_entry(entry, table, exponent_window(args->e, pos, WINDOW), digits);
+        amm(acc, acc, entry, n, k0, digits, t);
+    }
+
+    /* Out of the Montgomery form, the result may still be n */
+    amm((__m512i *) r, acc, one, n, k0, digits, t);
+}
+
+#endif
@@ -0,0 +1,370 @@
+#include <mhash.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Multi-buffer SHA-256: independent messages are hashed together, one per 32-bit SIMD lane, 8 with AVX2 and 16 with
+ * AVX-512. Each lane runs its message blocks and then the padded tail, and takes the next message as soon as it
+ * finishes, so messages of different lengths keep the lanes busy. Lanes without a message compute on the blocks of
+ * another lane, and their results are dropped.
+ *
+ * The kernels keep the state of the lanes transposed: word i of lane j at state[i * lanes + j]. Without a vector
+ * kernel, or for a single message, every message is hashed by mhash.
+ */
+
+static const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+struct sha256_kernel {
+    int lanes;
+    void (*compress)(uint32_t *state, const uint8_t *const *data, size_t count);
+};
+
+#ifdef MB_KERNELS
+
+#include <immintrin.h>
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+
+#define ROR256(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+/* Words t to t + 7 of 8 blocks, transposed: out[i] holds word t + i of every block, from big-endian. */
+AVX2 static void load_words_avx2(__m256i *out, const uint8_t *const *blocks, int t) {
+    const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256i r[8], u[8];
+    for (int j = 0; j < 8; j++) {
+        r[j] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (blocks[j] + 4 * t)), swap);
+    }
+    for (int j = 0; j < 8; j += 4) {
+        __m256i t0 = _mm256_unpacklo_epi32(r[j], r[j + 1]), t1 = _mm256_unpackhi_epi32(r[j], r[j + 1]);
+        __m256i t2 = _mm256_unpacklo_epi32(r[j + 2], r[j + 3]), t3 = _mm256_unpackhi_epi32(r[j + 2], r[j + 3]);
+        u[j] = _mm256_unpacklo_epi64(t0, t2);
+        u[j + 1] = _mm256_unpackhi_epi64(t0, t2);
+        u[j + 2] = _mm256_unpacklo_epi64(t1, t3);
+        u[j + 3] = _mm256_unpackhi_epi64(t1, t3);
+    }
+    for (int i = 0; i < 4; i++) {
+        out[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        out[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+/* Compresses count consecutive blocks of each of the 8 lanes into state. */
+AVX2 static void sha256_avx2(uint32_t *state, const uint8_t *const *data, size_t count) {
+    __m256i s[8], w[16];
+    for (int i = 0; i < 8; i++) {
+        s[i] = _mm256_loadu_si256((const __m256i *) (state + 8 * i));
+    }
+
+    const uint8_t *blocks[8];
+    memcpy(blocks, data, sizeof blocks);
+    for (size_t block = 0; block < count; block++) {
+        load_words_avx2(w, blocks, 0);
+        load_words_avx2(w + 8, blocks, 8);
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        for (int t = 0; t < 64; t++) {
+            if (t >= 16) {
+                __m256i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROR256(w15, 7), ROR256(w15, 18)),
+                                              _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROR256(w2, 17), ROR256(w2, 19)),
+                                              _mm256_srli_epi32(w2, 10));
+                w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0),
+                                             _mm256_add_epi32(w[(t - 7) & 15], s1));
+            }
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROR256(e, 6), ROR256(e, 11)), ROR256(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, s1),
+                                          _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32(K[t])), w[t & 15]));
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROR256(a, 2), ROR256(a, 13)), ROR256(a, 22));
+            __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm256_add_epi32(t1, _mm256_add_epi32(s0, maj));
+        }
+        s[0] = _mm256_add_epi32(s[0], a);
+        s[1] = _mm256_add_epi32(s[1], b);
+        s[2] = _mm256_add_epi32(s[2], c);
+        s[3] = _mm256_add_epi32(s[3], d);
+        s[4] = _mm256_add_epi32(s[4], e);
+        s[5] = _mm256_add_epi32(s[5], f);
+        s[6] = _mm256_add_epi32(s[6], g);
+        s[7] = _mm256_add_epi32(s[7], h);
+
+        for (int j = 0; j < 8; j++) {
+            blocks[j] += 64;
+        }
+    }
+
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i *) (state + 8 * i), s[i]);
+    }
+}
+
+/* Word t of 16 blocks, gathered from their addresses and converted from big-endian. */
+AVX512 static __m512i load_word_avx512(__m512i lo, __m512i hi, int t) {
+    __m256i x = _mm512_i64gather_epi32(lo, (const void *) (uintptr_t) (4 * t), 1);
+    __m256i y = _mm512_i64gather_epi32(hi, (const void *) (uintptr_t) (4 * t), 1);
+    __m512i w = _mm512_inserti64x4(_mm512_castsi256_si512(x), y, 1);
+    return _mm512_ternarylogic_epi32(_mm512_ror_epi32(w, 8), _mm512_rol_epi32(w, 8), _mm512_set1_epi32(0xff00ff00),
+                                     0xe4);
+}
+
+/* Compresses count consecutive blocks of each of the 16 lanes into state. */
+AVX512 static void sha256_avx512(uint32_t *state, const uint8_t *const *data, size_t count) {
+    __m512i s[8], w[16];
+    for (int i = 0; i < 8; i++) {
+        s[i] = _mm512_loadu_si512(state + 16 * i);
+    }
+
+    uint64_t addresses[16];
+    for (int j = 0; j < 16; j++) {
+        addresses[j] = (uintptr_t) data[j];
+    }
+    __m512i lo = _mm512_loadu_si512(addresses), hi = _mm512_loadu_si512(addresses + 8);
+    const __m512i step = _mm512_set1_epi64(64);
+
+    for (size_t block = 0; block < count; block++) {
+        for (int t = 0; t < 16; t++) {
+            w[t] = load_word_avx512(lo, hi, t);
+        }
+
+        __m512i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        for (int t = 0; t < 64; t++) {
+            if (t >= 16) {
+                __m512i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+                __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18),
+                                                       _mm512_srli_epi32(w15, 3), 0x96);
+                __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19),
+                                                       _mm512_srli_epi32(w2, 10), 0x96);
+                w[t & 15] = _mm512_add_epi32(_mm512_add_epi32(w[t & 15], s0),
+                                             _mm512_add_epi32(w[(t - 7) & 15], s1));
+            }
+            /* 0x96 is x ^ y ^ z, 0xca is x ? y : z, 0xe8 is the majority */
+            __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11),
+                                                   _mm512_ror_epi32(e, 25), 0x96);
+            __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xca);
+            __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(h, s1),
+                                          _mm512_add_epi32(_mm512_add_epi32(ch, _mm512_set1_epi32(K[t])), w[t & 15]));
+            __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13),
+                                                   _mm512_ror_epi32(a, 22), 0x96);
+            __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xe8);
+            h = g;
+            g = f;
+            f = e;
+            e = _mm512_add_epi32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm512_add_epi32(t1, _mm512_add_epi32(s0, maj));
+        }
+        s[0] = _mm512_add_epi32(s[0], a);
+        s[1] = _mm512_add_epi32(s[1], b);
+        s[2] = _mm512_add_epi32(s[2], c);
+        s[3] = _mm512_add_epi32(s[3], d);
+        s[4] = _mm512_add_epi32(s[4], e);
+        s[5] = _mm512_add_epi32(s[5], f);
+        s[6] = _mm512_add_epi32(s[6], g);
+        s[7] = _mm512_add_epi32(s[7], h);
+
+        lo = _mm512_add_epi64(lo, step);
+        hi = _mm512_add_epi64(hi, step);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        _mm512_storeu_si512(state + 16 * i, s[i]);
+    }
+}
+
+static const struct sha256_kernel kernels[] = {
+    [MB_SHA256_SCALAR] = {1, NULL},
+    [MB_SHA256_AVX2] = {8, sha256_avx2},
+    [MB_SHA256_AVX512] = {16, sha256_avx512},
+};
+
+static int kernel_supported(int id) {
+    __builtin_cpu_init();
+    switch (id) {
+        case MB_SHA256_SCALAR:
+            return 1;
+        case MB_SHA256_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case MB_SHA256_AVX512:
+            return __builtin_cpu_supports("avx512f");
+        default:
+            return 0;
+    }
+}
+#else
+
+static const struct sha256_kernel kernels[] = {
+    [MB_SHA256_SCALAR] = {1, NULL},
+};
+
+static int kernel_supported(int id) {
+    return id == MB_SHA256_SCALAR;
+}
+#endif
+
+#define SHA256_MAX_LANES 16
+
+static atomic_int selected = MB_KERNEL_AUTO;
+
+static int best_kernel(void) {
+    for (int id = MB_SHA256_AVX512; id > MB_SHA256_SCALAR; id--) {
+        if (kernel_supported(id)) {
+            return id;
+        }
+    }
+    return MB_SHA256_SCALAR;
+}
+
+int mb_sha256_set_kernel(int id) {
+    if (id != MB_KERNEL_AUTO && !kernel_supported(id)) {
+        return -1;
+    }
+    atomic_store(&selected, id == MB_KERNEL_AUTO ? best_kernel() : id);
+    return 0;
+}
+
+int mb_sha256_get_kernel(void) {
+    int id = atomic_load_explicit(&selected, memory_order_relaxed);
+    if (id == MB_KERNEL_AUTO) {
+        id = best_kernel();
+        atomic_store(&selected, id);
+    }
+    return id;
+}
+
+/* A message in a lane: its whole blocks, then one or two padded blocks with the rest of it and its length. */
+struct sha256_lane {
+    size_t doc;
+    const uint8_t *next;
+    size_t blocks; /* Left before switching to the tail, or before finishing */
+    int in_tail;
+    uint8_t tail[128];
+};
+
+static void lane_start(struct sha256_lane *lane, uint32_t *state, int lanes, int j, const bytes_t *doc, size_t i) {
+    size_t len = doc->data_len, rest = len % 64;
+    lane->doc = i;
+    lane->next = doc->data;
+    lane->blocks = len / 64;
+    lane->in_tail = 0;
+
+    int tail_len = rest < 56 ? 64 : 128;
+    memset(lane->tail, 0, tail_len);
+    if (rest > 0) {
+        memcpy(lane->tail, (const uint8_t *) doc->data + len - rest, rest);
+    }
+    lane->tail[rest] = 0x80;
+    uint64_t bits = (uint64_t) len * 8;
+    for (int k = 0; k < 8; k++) {
+        lane->tail[tail_len - 1 - k] = (uint8_t) (bits >> (8 * k));
+    }
+    if (lane->blocks == 0) {
+        lane->next = lane->tail;
+        lane->blocks = tail_len / 64;
+        lane->in_tail = 1;
+    }
+
+    for (int k = 0; k < 8; k++) {
+        state[k * lanes + j] = IV[k];
+    }
+}
+
+/* Digest i is the SHA-256 of docs[i]. */
+void mb_sha256(uint8_t (*digests)[32], const bytes_t **docs, size_t count) {
+    const struct sha256_kernel *kernel = &kernels[mb_sha256_get_kernel()];
+    int lanes = kernel->lanes;
+    if (lanes == 1 || count < 2) {
+        for (size_t i = 0; i < count; i++) {
+            MHASH sha = mhash_init(MHASH_SHA256);
+            mhash(sha, docs[i]->data, docs[i]->data_len);
+            mhash_deinit(sha, digests[i]);
+        }
+        return;
+    }
+
+    uint32_t state[8 * SHA256_MAX_LANES];
+    struct sha256_lane lane[SHA256_MAX_LANES];
+    int active[SHA256_MAX_LANES] = {0};
+    size_t started = 0;
+
+    for (;;) {
+        int first = -1;
+        for (int j = 0; j < lanes; j++) {
+            if (!active[j] && started < count) {
+                lane_start(&lane[j], state, lanes, j, docs[started], started);
+                started++;
+                active[j] = 1;
+            }
+            if (active[j] && first < 0) {
+                first = j;
+            }
+        }
+        if (first < 0) {
+            break;
+        }
+
+        size_t run = SIZE_MAX;
+        const uint8_t *data[SHA256_MAX_LANES];
+        for (int j = 0; j < lanes; j++) {
+            if (active[j] && lane[j].blocks < run) {
+                run = lane[j].blocks;
+            }
+            data[j] = active[j] ? lane[j].next : lane[first].next;
+        }
+        kernel->compress(state, data, run);
+
+        for (int j = 0; j < lanes; j++) {
+            if (!active[j]) {
+                continue;
+            }
+            lane[j].next += 64 * run;
+            lane[j].blocks -= run;
+            if (lane[j].blocks > 0) {
+                continue;
+            }
+            if (!lane[j].in_tail) {
+                size_t rest = docs[lane[j].doc]->data_len % 64;
+                lane[j].next = lane[j].tail;
+                lane[j].blocks = rest < 56 ? 1 : 2;
+                lane[j].in_tail = 1;
+                continue;
+            }
+            for (int k = 0; k < 8; k++) {
+                uint32_t word = state[k * lanes + j];
+                digests[lane[j].doc][4 * k] = word >> 24;
+                digests[lane[j].doc][4 * k + 1] = word >> 16;
+                digests[lane[j].doc][4 * k + 2] = word >> 8;
+                digests[lane[j].doc][4 * k + 3] = word;
+            }
+            active[j] = 0;
+        }
+    }
+}
@@ -3,17 +3,18 @@
 #include <stdlib.h>
 
 #include "mathutils.h"
+#include "tc_internal.h"
 
 /** GMP-based polynomial library **/
 
 poly_t * create_random_poly(mpz_t d, size_t size, mpz_t m) {
   assert(mpz_sgn(m) > 0);
-  poly_t * poly = malloc(sizeof(*poly));
+  poly_t * poly = alloc(sizeof(*poly));
 
   int bit_len = mpz_sizeinbase(m, 2) - 1;
 
   poly->size = size;
-  mpz_t * coeff = malloc(size * sizeof(*coeff));
+  mpz_t * coeff = alloc(size * sizeof(*coeff));
 
   mpz_init_set(coeff[0], d);
   for (int i = 1; i < size; i++) {
@@ -39,10 +40,10 @@ void clear_poly(poly_t * poly) {
   for(i=0; i<poly->size; i++) {
     mpz_clear(coeff[i]);
   }
-  free(coeff);
+  tc_free(coeff);
 
   poly->coeff = NULL; // To force segfaults...
-  free(poly);
+  tc_free(poly);
 }
 
 /* Horner's method */
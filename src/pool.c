@@ -0,0 +1,173 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Recycling pools for the objects the library allocates all the time: the bytes_t and share structures and the
+ * buffers holding their numbers. Each thread keeps a free list per size class, bounded by max_cached, so taking
+ * and returning objects never needs a lock.
+ *
+ * Every pool_alloc rounds the request up to its size class, whether pools are enabled or not. That way any buffer
+ * obtained by pool_alloc can be recycled later, and it can also be released with a plain tc_free.
+ */
+
+#define POOL_MIN_SIZE 16
+#define POOL_MAX_SIZE (16 * 1024)
+#define POOL_STEPS 4 /* Size classes between consecutive powers of two */
+#define POOL_CLASSES 41 /* 4 classes for each power of two between 16 and 8K, plus 16K */
+
+struct free_node {
+    struct free_node *next;
+};
+
+struct pool_cache {
+    struct free_node *head[POOL_CLASSES];
+    size_t count[POOL_CLASSES];
+    int registered;
+};
+
+static _Thread_local struct pool_cache cache;
+
+static atomic_size_t max_cached = 0;
+
+static atomic_uint_fast64_t hits = 0;
+static atomic_uint_fast64_t misses = 0;
+static atomic_uint_fast64_t recycled = 0;
+static atomic_uint_fast64_t dropped = 0;
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+/* Returns the index of the size class of size, and stores its size in class_size. -1 if it isn't pooled. */
+static int size_class(size_t size, size_t *class_size) {
+    if (size > POOL_MAX_SIZE) {
+        return -1;
+    }
+
+    int index = 0;
+    for (size_t base = POOL_MIN_SIZE; base < POOL_MAX_SIZE; base *= 2) {
+        for (int step = 0; step < POOL_STEPS; step++, index++) {
+            size_t cs = base + step * (base / POOL_STEPS);
+            if (size <= cs) {
+                *class_size = cs;
+                return index;
+            }
+        }
+    }
+
+    *class_size = POOL_MAX_SIZE;
+    assert(index < POOL_CLASSES);
+    return index;
+}
+
+static void flush_cache(struct pool_cache *c) {
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        struct free_node *node = c->head[i];
+        while (node != NULL) {
+            struct free_node *next = node->next;
+            tc_free(node);
+            node = next;
+        }
+        c->head[i] = NULL;
+        c->count[i] = 0;
+    }
+}
+
+static void release_thread_cache(void *c) {
+    flush_cache(c);
+}
+
+static void create_cache_key(void) {
+    pthread_key_create(&cache_key, release_thread_cache);
+}
+
+/* The cached objects of a thread are released when it exits. */
+static void register_cache(void) {
+    pthread_once(&cache_key_once, create_cache_key);
+    pthread_setspecific(cache_key, &cache);
+    cache.registered = 1;
+}
+
+void *pool_alloc(size_t size) {
+    size_t class_size;
+    int i = size_class(size, &class_size);
+    if (i < 0) {
+        return alloc(size);
+    }
+
+    if (atomic_load_explicit(&max_cached, memory_order_relaxed) == 0) {
+        return alloc(class_size);
+    }
+
+    struct free_node *node = cache.head[i];
+    if (node == NULL) {
+        atomic_fetch_add_explicit(&misses, 1, memory_order_relaxed);
+        return alloc(class_size);
+    }
+
+    cache.head[i] = node->next;
+    cache.count[i]--;
+    atomic_fetch_add_explicit(&hits, 1, memory_order_relaxed);
+    return node;
+}
+
+void pool_free(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    size_t class_size;
+    int i = size_class(size, &class_size);
+    size_t max = atomic_load_explicit(&max_cached, memory_order_relaxed);
+    if (i < 0 || max == 0) {
+        tc_free(ptr);
+        return;
+    }
+
+    if (cache.count[i] >= max) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        tc_free(ptr);
+        return;
+    }
+
+    if (!cache.registered) {
+        register_cache();
+    }
+
+    struct free_node *node = ptr;
+    node->next = cache.head[i];
+    cache.head[i] = node;
+    cache.count[i]++;
+    atomic_fetch_add_explicit(&recycled, 1, memory_order_relaxed);
+}
+
+void tc_enable_pools(size_t max) {
+    assert(max > 0);
+    atomic_store(&max_cached, max);
+}
+
+void tc_disable_pools() {
+    atomic_store(&max_cached, 0);
+    tc_flush_pools();
+}
+
+void tc_flush_pools() {
+    flush_cache(&cache);
+}
+
+void tc_get_pool_stats(tc_pool_stats_t *stats) {
+    assert(stats != NULL);
+    stats->hits = atomic_load(&hits);
+    stats->misses = atomic_load(&misses);
+    stats->recycled = atomic_load(&recycled);
+    stats->dropped = atomic_load(&dropped);
+
+    stats->cached = 0;
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        stats->cached += cache.count[i];
+    }
+}
@@ -0,0 +1,288 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <gmp.h>
+#include <mhash.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Precomputation blobs: the fixed-base tables of a key, in a file that can be mapped back after a restart instead of
+ * being rebuilt. The blob starts with a header, followed by a descriptor for each table. The tables themselves are
+ * stored as native limbs, aligned to 64 bytes, and are used in place from the mapping.
+ *
+ * Limbs are only meaningful on the same kind of machine, so the header records the limb size and the byte order,
+ * and the fingerprint of the key the tables were computed for. A blob that doesn't match is rejected as a whole.
+ * The header also carries a digest of the tables, so a damaged file is not used in place of the real ones.
+ */
+
+#define BLOB_MAGIC "TCPC"
+#define BLOB_VERSION 2
+#define BLOB_BYTE_ORDER 0x01020304u
+#define BLOB_ALIGN 64
+#define FINGERPRINT_LEN 32
+#define DIGEST_LEN 32
+
+enum blob_table_kind {
+    BLOB_TABLE_V = 1,
+    BLOB_TABLE_VK_INVERSE = 2,
+};
+
+struct blob_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t limb_bits;
+    uint32_t byte_order;
+    uint32_t count; /* Tables in the blob */
+    uint64_t size; /* Bytes of the whole blob */
+    uint8_t fingerprint[FINGERPRINT_LEN];
+    uint8_t digest[DIGEST_LEN]; /* Of the tables, from the first one to the end of the blob */
+};
+
+struct blob_table {
+    uint32_t kind;
+    uint32_t id; /* Node of a BLOB_TABLE_VK_INVERSE table */
+    uint32_t h;
+    uint32_t v;
+    uint64_t a;
+    uint64_t b;
+    uint64_t bits;
+    uint64_t size;
+    uint64_t offset; /* Of the limbs, from the start of the blob */
+};
+
+#define ALIGN_UP(x) (((x) + BLOB_ALIGN - 1) / BLOB_ALIGN * BLOB_ALIGN)
+#define TABLES_OFFSET(count) ALIGN_UP(sizeof(struct blob_header) + (size_t) (count) * sizeof(struct blob_table))
+
+static void tables_digest(uint8_t *out, const uint8_t *blob, size_t size, size_t count) {
+    MHASH sha = mhash_init(MHASH_SHA256);
+    mhash(sha, blob + TABLES_OFFSET(count), size - TABLES_OFFSET(count));
+    mhash_deinit(sha, out);
+}
+
+/* SHA-256 of every public value of the key. */
+static void key_fingerprint(uint8_t *out, const key_metainfo_t *info) {
+    const struct key_params *params = &info->params;
+    uint8_t kl[4] = {info->k >> 8, info->k & 0xff, info->l >> 8, info->l & 0xff};
+    MHASH sha = mhash_init(MHASH_SHA256);
+    mhash(sha, BLOB_MAGIC, 4);
+    mhash(sha, kl, sizeof kl);
+
+    int mark = workspace_begin(params->n_limbs);
+    const mp_limb_t *numbers[] = {params->n, params->e, params->vk_v, params->vk_u};
+    const mp_size_t counts[] = {params->n_limbs, params->e_limbs, params->n_limbs, params->n_limbs};
+    for (int i = 0; i < 4 + info->l; i++) {
+        mpz_t z;
+        if (i < 4) {
+            TC_LIMBS_VIEW(z, numbers[i], counts[i]);
+        } else {
+            TC_LIMBS_VIEW(z, TC_VK_I(info, i - 3), params->n_limbs);
+        }
+        size_t len;
+        const uint8_t *bytes = workspace_octets(&len, z);
+        uint8_t len_bytes[4] = {len >> 24, (len >> 16) & 0xff, (len >> 8) & 0xff, len & 0xff};
+        mhash(sha, len_bytes, sizeof len_bytes);
+        mhash(sha, bytes, len);
+    }
+    workspace_end(mark);
+
+    mhash_deinit(sha, out);
+}
+
+bytes_t *tc_serialize_precomputation(const key_metainfo_t *info) {
+    const struct fixed_base **tables = alloc((1 + info->l) * sizeof(*tables));
+    uint32_t *ids = alloc((1 + info->l) * sizeof(*ids));
+    uint32_t count = 0;
+
+    const struct fixed_base *fb = fixed_base_v(&info->params);
+    if (fb != NULL) {
+        ids[count] = 0;
+        tables[count++] = fb;
+    }
+    for (uint16_t id = 1; id <= info->l; id++) {
+        fb = fixed_base_vk_inverse(info, id);
+        if (fb != NULL) {
+            ids[count] = id;
+            tables[count++] = fb;
+        }
+    }
+
+    size_t size = TABLES_OFFSET(count);
+    for (uint32_t i = 0; i < count; i++) {
+        size += ALIGN_UP(FIXED_BASE_LIMBS(tables[i]->h, tables[i]->v, tables[i]->size) * sizeof(mp_limb_t));
+    }
+
+    uint8_t *data = alloc(size);
+    memset(data, 0, size);
+
+    struct blob_header header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, BLOB_MAGIC, 4);
+    header.version = BLOB_VERSION;
+    header.limb_bits = GMP_NUMB_BITS;
+    header.byte_order = BLOB_BYTE_ORDER;
+    header.count = count;
+    header.size = size;
+    key_fingerprint(header.fingerprint, info);
+
+    size_t offset = TABLES_OFFSET(count);
+    for (uint32_t i = 0; i < count; i++) {
+        fb = tables[i];
+        struct blob_table table = {
+            .kind = ids[i] == 0 ? BLOB_TABLE_V : BLOB_TABLE_VK_INVERSE,
+            .id = ids[i],
+            .h = fb->h,
+            .v = fb->v,
+            .a = fb->a,
+            .b = fb->b,
+            .bits = fb->bits,
+            .size = fb->size,
+            .offset = offset,
+        };
+        memcpy(data + sizeof header + i * sizeof table, &table, sizeof table);
+
+        size_t bytes = FIXED_BASE_LIMBS(fb->h, fb->v, fb->size) * sizeof(mp_limb_t);
+        memcpy(data + offset, fb->table, bytes);
+        offset += ALIGN_UP(bytes);
+    }
+
+    tables_digest(header.digest, data, size, count);
+    memcpy(data, &header, sizeof header);
+
+    tc_free(tables);
+    tc_free(ids);
+    return tc_init_bytes(data, size);
+}
+
+/* Checks a table descriptor against the key, returns its slot or NULL. */
+static _Atomic(struct fixed_base *) *table_slot(const struct blob_table *table, size_t blob_size,
+                                                key_metainfo_t *info) {
+    struct key_params *params = &info->params;
+    struct fixed_base shape = {
+        .h = table->h, .v = table->v, .a = table->a, .b = table->b, .bits = table->bits, .size = table->size,
+    };
+    if (table->h > 12 || table->v > 16 || !fixed_base_valid_shape(&shape) ||
+        table->size != (uint64_t) params->mont.size || table->offset % BLOB_ALIGN != 0 || table->offset > blob_size ||
+        FIXED_BASE_LIMBS(shape.h, shape.v, shape.size) * sizeof(mp_limb_t) > blob_size - table->offset) {
+        return NULL;
+    }
+
+    switch (table->kind) {
+        case BLOB_TABLE_V:
+            return table->bits == fixed_base_v_bits(params) ? &params->v_table : NULL;
+        case BLOB_TABLE_VK_INVERSE:
+            if (table->bits != FIXED_BASE_VK_BITS || table->id < 1 || table->id > info->l) {
+                return NULL;
+            }
+            return &info->vk_inverse_tables[TC_ID_TO_INDEX(table->id)];
+        default:
+            return NULL;
+    }
+}
+
+/* Validates the mapped blob, and installs its tables in the empty slots of the key. */
+static int install(key_metainfo_t *info, const uint8_t *blob, size_t size) {
+    struct blob_header header;
+    if (size < sizeof header) {
+        return -1;
+    }
+    memcpy(&header, blob, sizeof header);
+
+    uint8_t fingerprint[FINGERPRINT_LEN];
+    key_fingerprint(fingerprint, info);
+    if (memcmp(header.magic, BLOB_MAGIC, 4) != 0 || header.version != BLOB_VERSION ||
+        header.limb_bits != GMP_NUMB_BITS || header.byte_order != BLOB_BYTE_ORDER || header.size != size ||
+        header.count > 1u + info->l || TABLES_OFFSET(header.count) > size ||
+        memcmp(header.fingerprint, fingerprint, FINGERPRINT_LEN) != 0) {
+        return -1;
+    }
+
+    _Atomic(struct fixed_base *) **slots = alloc((1 + info->l) * sizeof(*slots));
+    struct blob_table *tables = alloc((1 + info->l) * sizeof(*tables));
+    int ret = 0;
+    for (uint32_t i = 0; i < header.count && ret == 0; i++) {
+        memcpy(&tables[i], blob + sizeof header + i * sizeof(struct blob_table), sizeof(struct blob_table));
+        slots[i] = table_slot(&tables[i], size, info);
+        if (slots[i] == NULL) {
+            ret = -1;
+        }
+    }
+
+    uint8_t digest[DIGEST_LEN];
+    if (ret == 0) {
+        tables_digest(digest, blob, size, header.count);
+        if (memcmp(header.digest, digest, DIGEST_LEN) != 0) {
+            ret = -1;
+        }
+    }
+    if (ret != 0) {
+        tc_free(slots);
+        tc_free(tables);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < header.count; i++) {
+        struct fixed_base *fb = alloc(sizeof(struct fixed_base));
+        fb->h = tables[i].h;
+        fb->v = tables[i].v;
+        fb->a = tables[i].a;
+        fb->b = tables[i].b;
+        fb->bits = tables[i].bits;
+        fb->size = tables[i].size;
+        fb->table = (const mp_limb_t *) (blob + tables[i].offset);
+
+        /* Tables the key already has are kept */
+        struct fixed_base *expected = NULL;
+        if (!atomic_compare_exchange_strong(slots[i], &expected, fb)) {
+            tc_free(fb);
+        }
+    }
+    tc_free(slots);
+    tc_free(tables);
+    return 0;
+}
+
+int tc_load_precomputation(key_metainfo_t *info, const char *path) {
+    if (info->precomputation != NULL) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(struct blob_header)) {
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    void *blob = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (blob == MAP_FAILED) {
+        return -1;
+    }
+
+    if (install(info, blob, size) != 0) {
+        munmap(blob, size);
+        return -1;
+    }
+    info->precomputation = blob;
+    info->precomputation_len = size;
+    return 0;
+}
+
+void precomputation_clear(key_metainfo_t *info) {
+    if (info->precomputation != NULL) {
+        munmap(info->precomputation, info->precomputation_len);
+        info->precomputation = NULL;
+        info->precomputation_len = 0;
+    }
+}
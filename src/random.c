@@ -1,24 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <gmp.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/random.h>
+#include <unistd.h>
 
 #include "mathutils.h"
+#include "tc_internal.h"
+
+/*
+ * Random bytes come from getrandom, which needs no file and is safe to call from any number of threads. Kernels
+ * without it fall back to /dev/urandom, opened once for the whole process.
+ */
+
+static int urandom = -1;
+static pthread_once_t urandom_once = PTHREAD_ONCE_INIT;
+
+static void open_urandom(void) {
+  urandom = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+}
+
+static void random_bytes(uint8_t * buffer, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t count = getrandom(buffer + done, len - done, 0);
+    if (count < 0 && errno == ENOSYS) {
+      pthread_once(&urandom_once, open_urandom);
+      count = urandom < 0 ? -1 : read(urandom, buffer + done, len - done);
+    }
+    if (count < 0 && errno != EINTR) {
+      perror("random_bytes");
+      abort();
+    }
+    if (count > 0) {
+      done += count;
+    }
+  }
+}
 
 void random_dev(mpz_t rop, int bit_len) {
   assert(bit_len > 0);
   int byte_size = bit_len / 8;
-  void * buffer = malloc(byte_size);
+  uint8_t buffer[byte_size];
 
-  FILE * dev = fopen("/dev/urandom", "r");
-  int read = fread(buffer, 1, byte_size, dev);
-  while(read < byte_size) {
-    read += fread(buffer + read, 1, byte_size - read, dev);
-  }
-  fclose(dev);
+  random_bytes(buffer, byte_size);
 
   mpz_import(rop, byte_size, 1, 1, 0, 0, buffer);
-  free(buffer);
 
   assert(mpz_sizeinbase(rop, 2) <= bit_len);
 }
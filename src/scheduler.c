@@ -0,0 +1,277 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Key-affinity scheduler: the requests for the same key share always go to the same worker, so the key, its
+ * Montgomery context and its tables stay in the caches of one CPU. Each worker has its own queue, the ring of the
+ * engine, and holds the requests it takes from it in a group per key. A group is signed with tc_node_sign_batch as
+ * soon as it has max_batch requests or its oldest request has waited max_wait, whichever comes first.
+ *
+ * A worker sleeps on its semaphore until the next request or the deadline of its oldest group.
+ */
+
+#define SCHEDULER_MAX_BATCH 64
+#define SCHEDULER_GROUPS 32 /* Keys a worker holds requests for at once */
+
+struct group {
+    const key_share_t * share;
+    const key_metainfo_t * info;
+    size_t count;
+    tc_future_t * futures[SCHEDULER_MAX_BATCH]; /* In submission order */
+};
+
+struct scheduler_worker {
+    tc_scheduler_t * scheduler;
+    struct ring queue;
+    sem_t ready;
+    pthread_t thread;
+    int group_count;
+    struct group groups[SCHEDULER_GROUPS];
+};
+
+struct scheduler {
+    int threads;
+    size_t max_batch;
+    uint64_t max_wait; /* Nanoseconds */
+    atomic_int stopping;
+    struct scheduler_worker * workers;
+
+    _Alignas(64) atomic_uint_fast64_t requests;
+    atomic_uint_fast64_t batches;
+    atomic_uint_fast64_t batch_sizes[TC_SCHEDULER_BATCH_BUCKETS];
+    atomic_uint_fast64_t wait_total;
+    atomic_uint_fast64_t wait_max;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* The worker of a key share, the same for every request. */
+static struct scheduler_worker * route(tc_scheduler_t * scheduler, const key_share_t * share) {
+    uint64_t h = ((uintptr_t) share >> 4) * 0x9E3779B97F4A7C15ull;
+    return &scheduler->workers[(h >> 32) % scheduler->threads];
+}
+
+static uint64_t deadline(const tc_scheduler_t * scheduler, const struct group * group) {
+    return group->futures[0]->submitted + scheduler->max_wait;
+}
+
+/* Signs the requests of a group, completes their futures and removes the group. */
+static void dispatch(struct scheduler_worker * worker, int index) {
+    tc_scheduler_t * scheduler = worker->scheduler;
+    struct group * group = &worker->groups[index];
+    const bytes_t * docs[SCHEDULER_MAX_BATCH];
+    signature_share_t * out[SCHEDULER_MAX_BATCH];
+
+    uint64_t now = now_ns(), wait_total = 0, wait_max = 0;
+    for (size_t i = 0; i < group->count; i++) {
+        docs[i] = group->futures[i]->doc;
+        uint64_t wait = now - group->futures[i]->submitted;
+        wait_total += wait;
+        wait_max = wait > wait_max ? wait : wait_max;
+    }
+
+    tc_node_sign_batch(out, group->share, docs, group->count, group->info);
+
+    int bucket = 0;
+    while ((2u << bucket) <= group->count && bucket < TC_SCHEDULER_BATCH_BUCKETS - 1) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&scheduler->requests, group->count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&scheduler->batches, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&scheduler->batch_sizes[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&scheduler->wait_total, wait_total, memory_order_relaxed);
+    uint_fast64_t max = atomic_load_explicit(&scheduler->wait_max, memory_order_relaxed);
+    while (wait_max > max && !atomic_compare_exchange_weak_explicit(&scheduler->wait_max, &max, wait_max,
+                                                                   memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    /* The counters are updated first, so that they include a batch as soon as its futures are done */
+    for (size_t i = 0; i < group->count; i++) {
+        group->futures[i]->result.share = out[i];
+        future_complete(group->futures[i]);
+    }
+    *group = worker->groups[--worker->group_count];
+}
+
+/* Adds a request to the group of its key, dispatching the group if it is full. */
+static void hold(struct scheduler_worker * worker, tc_future_t * future) {
+    int index = 0;
+    while (index < worker->group_count &&
+           (worker->groups[index].share != future->share || worker->groups[index].info != future->info)) {
+        index++;
+    }
+
+    if (index == worker->group_count) {
+        if (worker->group_count == SCHEDULER_GROUPS) {
+            /* Every slot is taken, the oldest group goes early */
+            int oldest = 0;
+            for (int i = 1; i < worker->group_count; i++) {
+                if (worker->groups[i].futures[0]->submitted < worker->groups[oldest].futures[0]->submitted) {
+                    oldest = i;
+                }
+            }
+            dispatch(worker, oldest);
+        }
+        index = worker->group_count++;
+        worker->groups[index].share = future->share;
+        worker->groups[index].info = future->info;
+        worker->groups[index].count = 0;
+    }
+
+    struct group * group = &worker->groups[index];
+    group->futures[group->count++] = future;
+    if (group->count == worker->scheduler->max_batch) {
+        dispatch(worker, index);
+    }
+}
+
+/* Dispatches the groups whose oldest request is due, or every group. */
+static void dispatch_due(struct scheduler_worker * worker, int all) {
+    uint64_t now = now_ns();
+    for (int i = worker->group_count - 1; i >= 0; i--) {
+        if (all || now >= deadline(worker->scheduler, &worker->groups[i])) {
+            dispatch(worker, i);
+        }
+    }
+}
+
+/* Waits for a request until the deadline of the oldest group. Returns 1 if there is a request to take. */
+static int wait_request(struct scheduler_worker * worker) {
+    if (worker->group_count == 0) {
+        while (sem_wait(&worker->ready) != 0) {
+            assert(errno == EINTR);
+        }
+        return 1;
+    }
+
+    uint64_t next = UINT64_MAX;
+    for (int i = 0; i < worker->group_count; i++) {
+        uint64_t due = deadline(worker->scheduler, &worker->groups[i]);
+        next = due < next ? due : next;
+    }
+    struct timespec ts = {.tv_sec = next / 1000000000u, .tv_nsec = next % 1000000000u};
+    for (;;) {
+        if (sem_clockwait(&worker->ready, CLOCK_MONOTONIC, &ts) == 0) {
+            return 1;
+        }
+        if (errno != EINTR) {
+            return 0;
+        }
+    }
+}
+
+static void * schedule(void * arg) {
+    struct scheduler_worker * worker = arg;
+    tc_scheduler_t * scheduler = worker->scheduler;
+    int stop = 0;
+    while (!stop) {
+        /*
+         * Every post is a queued request or, once stopping, the worker to stop. As in the engine, a pop can miss a
+         * request whose submitter hasn't filled its cell yet, and is retried.
+         */
+        int taken = wait_request(worker);
+        while (taken) {
+            tc_future_t * future = ring_pop(&worker->queue);
+            if (future != NULL) {
+                hold(worker, future);
+            } else if (atomic_load(&scheduler->stopping) && ring_drained(&worker->queue)) {
+                stop = 1;
+            } else {
+                sched_yield();
+                continue;
+            }
+            taken = sem_trywait(&worker->ready) == 0;
+        }
+        dispatch_due(worker, stop);
+    }
+    tc_release_workspace();
+    return NULL;
+}
+
+tc_scheduler_t * tc_init_scheduler(int threads, size_t queue_size, size_t max_batch, uint64_t max_wait_us, int pin) {
+    assert(threads > 0);
+    assert(max_batch > 0);
+    tc_scheduler_t * scheduler = alloc(sizeof(tc_scheduler_t));
+    scheduler->threads = threads;
+    scheduler->max_batch = max_batch < SCHEDULER_MAX_BATCH ? max_batch : SCHEDULER_MAX_BATCH;
+    scheduler->max_wait = max_wait_us * 1000;
+    atomic_init(&scheduler->stopping, 0);
+    atomic_init(&scheduler->requests, 0);
+    atomic_init(&scheduler->batches, 0);
+    for (int i = 0; i < TC_SCHEDULER_BATCH_BUCKETS; i++) {
+        atomic_init(&scheduler->batch_sizes[i], 0);
+    }
+    atomic_init(&scheduler->wait_total, 0);
+    atomic_init(&scheduler->wait_max, 0);
+
+    scheduler->workers = alloc(threads * sizeof(struct scheduler_worker));
+    for (int i = 0; i < threads; i++) {
+        struct scheduler_worker * worker = &scheduler->workers[i];
+        worker->scheduler = scheduler;
+        ring_init(&worker->queue, queue_size);
+        sem_init(&worker->ready, 0, 0);
+        worker->group_count = 0;
+    }
+    for (int i = 0; i < threads; i++) {
+        start_worker(&scheduler->workers[i].thread, schedule, &scheduler->workers[i], i, pin);
+    }
+    return scheduler;
+}
+
+void tc_clear_scheduler(tc_scheduler_t * scheduler) {
+    atomic_store(&scheduler->stopping, 1);
+    for (int i = 0; i < scheduler->threads; i++) {
+        sem_post(&scheduler->workers[i].ready);
+    }
+    for (int i = 0; i < scheduler->threads; i++) {
+        struct scheduler_worker * worker = &scheduler->workers[i];
+        pthread_join(worker->thread, NULL);
+        sem_destroy(&worker->ready);
+        ring_clear(&worker->queue);
+    }
+    tc_free(scheduler->workers);
+    tc_free(scheduler);
+}
+
+tc_future_t * tc_scheduler_sign(tc_scheduler_t * scheduler, const key_share_t * share, const bytes_t * doc,
+                                const key_metainfo_t * info) {
+    tc_future_t * future = future_new(TASK_SIGN);
+    future->share = share;
+    future->doc = doc;
+    future->info = info;
+    future->submitted = now_ns();
+
+    struct scheduler_worker * worker = route(scheduler, share);
+    if (ring_push(&worker->queue, future) != 0) {
+        pool_free(future, sizeof(tc_future_t));
+        return NULL;
+    }
+    sem_post(&worker->ready);
+    return future;
+}
+
+void tc_get_scheduler_stats(const tc_scheduler_t * scheduler, tc_scheduler_stats_t * stats) {
+    tc_scheduler_t * s = (tc_scheduler_t *) scheduler;
+    stats->requests = atomic_load_explicit(&s->requests, memory_order_relaxed);
+    stats->batches = atomic_load_explicit(&s->batches, memory_order_relaxed);
+    for (int i = 0; i < TC_SCHEDULER_BATCH_BUCKETS; i++) {
+        stats->batch_sizes[i] = atomic_load_explicit(&s->batch_sizes[i], memory_order_relaxed);
+    }
+    stats->wait_total_ns = atomic_load_explicit(&s->wait_total, memory_order_relaxed);
+    stats->wait_max_ns = atomic_load_explicit(&s->wait_max, memory_order_relaxed);
+}
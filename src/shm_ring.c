@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Shared memory rings: a POSIX shared memory object holding a bounded queue of messages, for processes on the same
+ * machine. Any number of processes may send to a ring, one receives from it. The cells work as in the ring of the
+ * engine, each with a sequence number, but hold the messages themselves: a sender reserves a cell, writes the message
+ * in place, as tc_node_sign_into does, and commits it; the receiver reads it in place and releases the cell.
+ *
+ * An idle receiver sleeps on a futex in the shared object. Senders only make the system call to wake it when it says
+ * it is sleeping, so a busy ring costs no system call at all.
+ */
+
+#define SHM_RING_MAGIC 0x52435454u /* "TTCR" */
+#define SHM_RING_VERSION 1
+#define SHM_RING_ALIGN 64
+
+struct shm_ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slots;
+    uint64_t slot_size; /* Bytes a message may take */
+    uint64_t stride; /* Bytes from a cell to the next */
+    uint64_t size; /* Bytes of the whole object */
+    _Alignas(SHM_RING_ALIGN) atomic_size_t enqueue_pos;
+    _Alignas(SHM_RING_ALIGN) atomic_size_t dequeue_pos;
+    _Alignas(SHM_RING_ALIGN) atomic_uint signal; /* Futex, bumped by every commit */
+    atomic_uint sleeping; /* The receiver is, or is about to be, waiting on signal */
+};
+
+struct shm_ring_cell {
+    atomic_size_t sequence;
+    uint64_t len;
+    _Alignas(SHM_RING_ALIGN) unsigned char data[];
+};
+
+/* The geometry is copied out of the header once it has been validated, the header is shared with other processes */
+struct shm_ring {
+    struct shm_ring_header * header;
+    unsigned char * cells;
+    size_t size;
+    size_t slots;
+    size_t slot_size;
+    size_t stride;
+    size_t received; /* Position of the message the receiver holds, or SIZE_MAX */
+};
+
+#define CELL_OFFSET ((sizeof(struct shm_ring_header) + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN)
+
+static struct shm_ring_cell * cell_at(const tc_shm_ring_t * ring, size_t pos) {
+    return (struct shm_ring_cell *) (ring->cells + (pos & (ring->slots - 1)) * ring->stride);
+}
+
+static void futex_wait(atomic_uint * word, unsigned value, int timeout_ms) {
+#ifdef __linux__
+    struct timespec ts = {.tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000l};
+    syscall(SYS_futex, (unsigned *) word, FUTEX_WAIT, value, timeout_ms < 0 ? NULL : &ts, NULL, 0);
+#else
+    (void) word, (void) value, (void) timeout_ms;
+    usleep(1000);
+#endif
+}
+
+static void futex_wake(atomic_uint * word) {
+#ifdef __linux__
+    syscall(SYS_futex, (unsigned *) word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void) word;
+#endif
+}
+
+static tc_shm_ring_t * map(int fd, size_t size) {
+    void * mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+    tc_shm_ring_t * ring = alloc(sizeof(tc_shm_ring_t));
+    ring->header = mapped;
+    ring->cells = (unsigned char *) mapped + CELL_OFFSET;
+    ring->size = size;
+    ring->received = SIZE_MAX;
+    return ring;
+}
+
+tc_shm_ring_t * tc_shm_ring_create(const char * name, size_t slots, size_t slot_size) {
+    size_t capacity = 2;
+    while (capacity < slots) {
+        capacity *= 2;
+    }
+    size_t stride = sizeof(struct shm_ring_cell) + slot_size;
+    stride = (stride + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN;
+    size_t size = CELL_OFFSET + capacity * stride;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    tc_shm_ring_t * ring = map(fd, size);
+    if (ring == NULL) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    ring->slots = capacity;
+    ring->slot_size = slot_size;
+    ring->stride = stride;
+
+    struct shm_ring_header * header = ring->header;
+    header->slots = capacity;
+    header->slot_size = slot_size;
+    header->stride = stride;
+    header->size = size;
+    atomic_init(&header->enqueue_pos, 0);
+    atomic_init(&header->dequeue_pos, 0);
+    atomic_init(&header->signal, 0);
+    atomic_init(&header->sleeping, 0);
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&cell_at(ring, i)->sequence, i);
+    }
+
+    /* The header is complete before another process can take the ring as valid */
+    header->version = SHM_RING_VERSION;
+    atomic_thread_fence(memory_order_release);
+    header->magic = SHM_RING_MAGIC;
+    return ring;
+}
+
+tc_shm_ring_t * tc_shm_ring_open(const char * name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) CELL_OFFSET) {
+        close(fd);
+        return NULL;
+    }
+    tc_shm_ring_t * ring = map(fd, st.st_size);
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    const struct shm_ring_header * header = ring->header;
+    uint32_t magic = header->magic;
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t slots = header->slots;
+    uint64_t slot_size = header->slot_size;
+    uint64_t stride = header->stride;
+    if (magic != SHM_RING_MAGIC || header->version != SHM_RING_VERSION || header->size != ring->size ||
+        slots < 2 || (slots & (slots - 1)) != 0 || slot_size > ring->size ||
+        stride < sizeof(struct shm_ring_cell) + slot_size || stride % SHM_RING_ALIGN != 0 ||
+        slots > (ring->size - CELL_OFFSET) / stride) {
+        tc_shm_ring_close(ring);
+        return NULL;
+    }
+    ring->slots = slots;
+    ring->slot_size = slot_size;
+    ring->stride = stride;
+    return ring;
+}
+
+void tc_shm_ring_close(tc_shm_ring_t * ring) {
+    munmap(ring->header, ring->size);
+    tc_free(ring);
+}
+
+int tc_shm_ring_unlink(const char * name) {
+    return shm_unlink(name) == 0 ? 0 : -1;
+}
+
+size_t tc_shm_ring_slot_size(const tc_shm_ring_t * ring) {
+    return ring->slot_size;
+}
+
+void * tc_shm_ring_reserve(tc_shm_ring_t * ring, size_t len) {
+    struct shm_ring_header * header = ring->header;
+    if (len > ring->slot_size) {
+        return NULL;
+    }
+    size_t pos = atomic_load_explicit(&header->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        struct shm_ring_cell * cell = cell_at(ring, pos);
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&header->enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                cell->len = len;
+                return cell->data;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&header->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+void tc_shm_ring_commit(tc_shm_ring_t * ring, void * data) {
+    struct shm_ring_header * header = ring->header;
+    struct shm_ring_cell * cell =
+        (struct shm_ring_cell *) ((unsigned char *) data - offsetof(struct shm_ring_cell, data));
+    size_t index = ((unsigned char *) cell - ring->cells) / ring->stride;
+    assert(index < ring->slots);
+
+    /* The cell was reserved at the position its sequence number holds, the next one is the committed state */
+    size_t pos = atomic_load_explicit(&cell->sequence, memory_order_relaxed);
+    assert((pos & (ring->slots - 1)) == index);
+    (void) index;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+    atomic_fetch_add(&header->signal, 1);
+    if (atomic_load(&header->sleeping)) {
+        futex_wake(&header->signal);
+    }
+}
+
+int tc_shm_ring_send(tc_shm_ring_t * ring, const void * data, size_t len) {
+    void * slot = tc_shm_ring_reserve(ring, len);
+    if (slot == NULL) {
+        return -1;
+    }
+    memcpy(slot, data, len);
+    tc_shm_ring_commit(ring, slot);
+    return 0;
+}
+
+/* Milliseconds left of a timeout since start, or -1 if it has expired. */
+static int remaining_ms(const struct timespec * start, int timeout_ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long elapsed = (ts.tv_sec - start->tv_sec) * 1000 + (ts.tv_nsec - start->tv_nsec) / 1000000;
+    return elapsed >= timeout_ms ? -1 : timeout_ms - (int) elapsed;
+}
+
+void * tc_shm_ring_receive(tc_shm_ring_t * ring, size_t * len, int timeout_ms) {
+    assert(ring->received == SIZE_MAX);
+    struct shm_ring_header * header = ring->header;
+    size_t pos = atomic_load_explicit(&header->dequeue_pos, memory_order_relaxed);
+    struct shm_ring_cell * cell = cell_at(ring, pos);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (;;) {
+        if (atomic_load_explicit(&cell->sequence, memory_order_acquire) == pos + 1) {
+            uint64_t cell_len = cell->len;
+            ring->received = pos;
+            if (cell_len <= ring->slot_size) {
+                *len = cell_len;
+                return cell->data;
+            }
+
+            /* No sender reserves more than a slot, a longer message is dropped */
+            tc_shm_ring_release(ring);
+            pos++;
+            cell = cell_at(ring, pos);
+            continue;
+        }
+        int remaining = timeout_ms < 0 ? -1 : remaining_ms(&start, timeout_ms);
+        if (timeout_ms >= 0 && remaining < 0) {
+            return NULL;
+        }
+
+        /* Says it sleeps before checking once more, so that a commit either is seen or wakes it */
+        atomic_store(&header->sleeping, 1);
+        unsigned signal = atomic_load(&header->signal);
+        if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + 1) {
+            futex_wait(&header->signal, signal, remaining);
+        }
+        atomic_store(&header->sleeping, 0);
+    }
+}
+
+void tc_shm_ring_release(tc_shm_ring_t * ring) {
+    assert(ring->received != SIZE_MAX);
+    struct shm_ring_header * header = ring->header;
+    size_t pos = ring->received;
+    atomic_store_explicit(&cell_at(ring, pos)->sequence, pos + ring->slots, memory_order_release);
+    atomic_store_explicit(&header->dequeue_pos, pos + 1, memory_order_relaxed);
+    ring->received = SIZE_MAX;
+}
@@ -0,0 +1,371 @@
+#define _GNU_SOURCE
+
+#include "tc.h"
+#include "signd.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * tc-signd: a signing daemon for the key shares of one node. It accepts connections on a Unix socket or on a TCP port
+ * of localhost, and signs the documents of the requests with a key-affinity scheduler, so that the requests in flight
+ * for a share are signed in batches.
+ *
+ * Each connection has a reader thread, which submits the requests as they arrive, and a writer thread, which waits
+ * for them in order and sends the responses. Up to depth requests of a connection may be in flight, a reader with
+ * more waits for the writer.
+ */
+
+static const char * metainfo_path = NULL;
+static const char * share_paths[64];
+static int share_count = 0;
+static const char * socket_path = NULL;
+static int port = 0;
+static int threads = 2;
+static int max_batch = 16;
+static int max_wait = 200; /* Microseconds */
+static int depth = 256;
+
+static key_metainfo_t * info;
+static key_share_t ** shares; /* By id, NULL if the share isn't loaded */
+static size_t document_len;
+static size_t response_size; /* Of the payload of a signature share */
+static tc_scheduler_t * scheduler;
+static volatile sig_atomic_t stopping = 0;
+
+struct pending {
+    struct signd_header header; /* Of the response */
+    tc_future_t * future;
+    bytes_t * doc;
+};
+
+struct connection {
+    int fd;
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    struct pending * queue; /* Circular, of depth requests */
+    int head;
+    int count;
+    int closed; /* The reader is done */
+    struct connection * next;
+};
+
+static pthread_mutex_t connections_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t connections_changed = PTHREAD_COND_INITIALIZER;
+static struct connection * connections = NULL;
+
+void set_parameters(int argc, char ** argv)
+{
+    int opt;
+    while((opt = getopt(argc, argv, "m:s:u:p:t:b:w:d:")) != -1){
+	switch(opt) {
+	case 'm':
+	    metainfo_path = optarg;
+	    break;
+	case 's':
+	    if (share_count < 64) {
+		share_paths[share_count++] = optarg;
+	    }
+	    break;
+	case 'u':
+	    socket_path = optarg;
+	    break;
+	case 'p':
+	    port = strtol(optarg, NULL, 10);
+	    break;
+	case 't':
+	    threads = strtol(optarg, NULL, 10);
+	    break;
+	case 'b':
+	    max_batch = strtol(optarg, NULL, 10);
+	    break;
+	case 'w':
+	    max_wait = strtol(optarg, NULL, 10);
+	    break;
+	case 'd':
+	    depth = strtol(optarg, NULL, 10);
+	    break;
+	default:
+	    fprintf(stderr, "Usage: %s -m metainfo -s share [-s share...] (-u socket path | -p port) [-t threads] "
+		    "[-b max batch] [-w max wait us] [-d requests in flight per connection]\n", argv[0]);
+	    exit(EXIT_FAILURE);
+	}
+    }
+}
+
+/* Reads a whole file, as a string. */
+static char * read_file(const char * path)
+{
+    FILE * f = fopen(path, "r");
+    if (f == NULL) {
+	perror(path);
+	exit(EXIT_FAILURE);
+    }
+    size_t len = 0, capacity = 4096;
+    char * data = malloc(capacity);
+    size_t n;
+    while ((n = fread(data + len, 1, capacity - len - 1, f)) > 0) {
+	len += n;
+	if (capacity - len - 1 == 0) {
+	    capacity *= 2;
+	    data = realloc(data, capacity);
+	}
+    }
+    fclose(f);
+    while (len > 0 && (data[len - 1] == '\n' || data[len - 1] == '\r')) {
+	len--;
+    }
+    data[len] = '\0';
+    return data;
+}
+
+static void load_keys()
+{
+    char * serialized = read_file(metainfo_path);
+    info = tc_deserialize_key_metainfo(serialized);
+    free(serialized);
+    if (info == NULL) {
+	fprintf(stderr, "%s: not a key metainfo\n", metainfo_path);
+	exit(EXIT_FAILURE);
+    }
+
+    int l = tc_key_meta_info_l(info);
+    shares = calloc(l + 1, sizeof(key_share_t *));
+    for (int i = 0; i < share_count; i++) {
+	serialized = read_file(share_paths[i]);
+	key_share_t * share = tc_deserialize_key_share(serialized);
+	free(serialized);
+	if (share == NULL || tc_key_share_id(share) < 1 || tc_key_share_id(share) > l) {
+	    fprintf(stderr, "%s: not a key share of the key\n", share_paths[i]);
+	    exit(EXIT_FAILURE);
+	}
+	shares[tc_key_share_id(share)] = share;
+    }
+    document_len = tc_public_key_n(tc_key_meta_info_public_key(info))->data_len;
+    response_size = tc_signature_share_fixed_size(info);
+}
+
+static void * read_requests(void * arg)
+{
+    struct connection * c = arg;
+    for (;;) {
+	struct signd_header net, request;
+	if (signd_read(c->fd, &net, sizeof(net)) != 0) {
+	    break;
+	}
+	signd_decode(&request, &net);
+	if (request.length > SIGND_MAX_PAYLOAD) {
+	    break;
+	}
+	uint8_t * payload = malloc(request.length ? request.length : 1);
+	if (signd_read(c->fd, payload, request.length) != 0) {
+	    free(payload);
+	    break;
+	}
+
+	struct pending p = {.header = {.id = request.id, .share = request.share, .status = SIGND_OK}};
+	p.doc = tc_init_bytes(payload, request.length);
+	const key_share_t * share = request.share <= tc_key_meta_info_l(info) ? shares[request.share] : NULL;
+	if (share == NULL) {
+	    p.header.status = SIGND_UNKNOWN_SHARE;
+	} else if (request.length != document_len) {
+	    p.header.status = SIGND_BAD_REQUEST;
+	} else {
+	    while ((p.future = tc_scheduler_sign(scheduler, share, p.doc, info)) == NULL) {
+		sched_yield();
+	    }
+	}
+
+	pthread_mutex_lock(&c->lock);
+	while (c->count == depth) {
+	    pthread_cond_wait(&c->changed, &c->lock);
+	}
+	c->queue[(c->head + c->count++) % depth] = p;
+	pthread_cond_signal(&c->changed);
+	pthread_mutex_unlock(&c->lock);
+    }
+
+    pthread_mutex_lock(&c->lock);
+    c->closed = 1;
+    pthread_cond_signal(&c->changed);
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+/* The writer of a connection, which releases it once every request is answered. */
+static void * write_responses(void * arg)
+{
+    struct connection * c = arg;
+    uint8_t * frame = malloc(sizeof(struct signd_header) + response_size);
+    uint8_t * payload = frame + sizeof(struct signd_header);
+    int failed = 0;
+
+    for (;;) {
+	pthread_mutex_lock(&c->lock);
+	while (c->count == 0 && !c->closed) {
+	    pthread_cond_wait(&c->changed, &c->lock);
+	}
+	if (c->count == 0) {
+	    pthread_mutex_unlock(&c->lock);
+	    break;
+	}
+	struct pending p = c->queue[c->head];
+	c->head = (c->head + 1) % depth;
+	c->count--;
+	pthread_cond_signal(&c->changed);
+	pthread_mutex_unlock(&c->lock);
+
+	struct signd_header response = p.header;
+	response.length = 0;
+	if (p.future != NULL) {
+	    signature_share_t * signature = tc_future_signature_share(p.future);
+	    tc_clear_future(p.future);
+	    /* Doesn't fail, the share was signed with the key */
+	    tc_serialize_signature_share_fixed(payload, response_size, signature, info);
+	    tc_clear_signature_share(signature);
+	    response.length = response_size;
+	}
+	tc_clear_bytes(p.doc);
+
+	/* Once the client is gone, the requests in flight are only waited for */
+	signd_encode((struct signd_header *) frame, &response);
+	if (!failed && signd_write(c->fd, frame, sizeof(struct signd_header) + response.length) != 0) {
+	    failed = 1;
+	    shutdown(c->fd, SHUT_RDWR);
+	}
+    }
+
+    pthread_join(c->reader, NULL);
+    free(frame);
+    close(c->fd);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->changed);
+    free(c->queue);
+
+    pthread_mutex_lock(&connections_lock);
+    for (struct connection ** link = &connections; *link != NULL; link = &(*link)->next) {
+	if (*link == c) {
+	    *link = c->next;
+	    break;
+	}
+    }
+    pthread_cond_signal(&connections_changed);
+    pthread_mutex_unlock(&connections_lock);
+    free(c);
+    tc_release_workspace();
+    return NULL;
+}
+
+static void serve(int fd)
+{
+    struct connection * c = calloc(1, sizeof(struct connection));
+    c->fd = fd;
+    c->queue = malloc(depth * sizeof(struct pending));
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->changed, NULL);
+
+    pthread_mutex_lock(&connections_lock);
+    c->next = connections;
+    connections = c;
+    pthread_mutex_unlock(&connections_lock);
+
+    pthread_t writer;
+    pthread_create(&c->reader, NULL, read_requests, c);
+    pthread_create(&writer, NULL, write_responses, c);
+    pthread_detach(writer);
+}
+
+static void stop(int signal)
+{
+    (void) signal;
+    stopping = 1;
+}
+
+int main(int argc, char ** argv)
+{
+    set_parameters(argc, argv);
+    if (metainfo_path == NULL || share_count == 0 || (socket_path == NULL) == (port == 0) || threads < 1 ||
+	max_batch < 1 || max_wait < 0 || depth < 1) {
+	fprintf(stderr, "Expected a key metainfo, key shares, and either a socket path or a port\n");
+	return EXIT_FAILURE;
+    }
+    load_keys();
+
+    struct sockaddr_storage address;
+    socklen_t address_len = signd_address(&address, socket_path, port);
+    int listener = socket(address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (socket_path != NULL) {
+	unlink(socket_path);
+    }
+    if (address_len == 0 || listener < 0 || bind(listener, (struct sockaddr *) &address, address_len) != 0 ||
+	listen(listener, 64) != 0) {
+	perror("tc-signd");
+	return EXIT_FAILURE;
+    }
+
+    struct sigaction action = {.sa_handler = stop};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    scheduler = tc_init_scheduler(threads, 4096, max_batch, max_wait, 1);
+    fprintf(stderr, "tc-signd: %d shares, %d threads, batches of up to %d requests within %d us\n", share_count,
+	    threads, max_batch, max_wait);
+
+    while (!stopping) {
+	struct pollfd ready = {.fd = listener, .events = POLLIN};
+	if (poll(&ready, 1, 200) <= 0) {
+	    continue;
+	}
+	int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+	if (fd >= 0) {
+	    if (socket_path == NULL) {
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	    }
+	    serve(fd);
+	}
+    }
+
+    /* No more requests are read, the ones in flight are answered */
+    close(listener);
+    if (socket_path != NULL) {
+	unlink(socket_path);
+    }
+    pthread_mutex_lock(&connections_lock);
+    for (struct connection * c = connections; c != NULL; c = c->next) {
+	shutdown(c->fd, SHUT_RD);
+    }
+    while (connections != NULL) {
+	pthread_cond_wait(&connections_changed, &connections_lock);
+    }
+    pthread_mutex_unlock(&connections_lock);
+
+    tc_scheduler_stats_t stats;
+    tc_get_scheduler_stats(scheduler, &stats);
+    tc_clear_scheduler(scheduler);
+    fprintf(stderr, "tc-signd: %llu requests in %llu batches, %.1f per batch, %.1f us of added latency on average, "
+	    "%.1f us at most\n", (unsigned long long) stats.requests, (unsigned long long) stats.batches,
+	    stats.batches ? (double) stats.requests / stats.batches : 0.0,
+	    stats.requests ? stats.wait_total_ns / 1e3 / stats.requests : 0.0, stats.wait_max_ns / 1e3);
+
+    for (int id = 1; id <= tc_key_meta_info_l(info); id++) {
+	if (shares[id] != NULL) {
+	    tc_clear_key_share(shares[id]);
+	}
+    }
+    free(shares);
+    tc_clear_key_metainfo(info);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+#ifndef TC_SIGND_H
+#define TC_SIGND_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Framing of tc-signd. Every frame is a header followed by length bytes of payload, the fields of the header in
+ * network byte order. A request carries a prepared document for the key share with the given id, as many requests
+ * as the client wants may be in flight on a connection, and their responses come back in the same order.
+ *
+ * The payload of a successful response is the signature share in the fixed length format of
+ * tc_serialize_signature_share_fixed, which clients read back with tc_deserialize_signature_share_fixed_into.
+ */
+
+#define SIGND_MAX_PAYLOAD (1u << 16)
+
+enum signd_status {
+    SIGND_OK = 0,
+    SIGND_UNKNOWN_SHARE = 1, /* The daemon hasn't loaded the share */
+    SIGND_BAD_REQUEST = 2, /* The document isn't as long as the modulus */
+};
+
+struct signd_header {
+    uint32_t length; /* Of the payload */
+    uint32_t id; /* Chosen by the client, echoed by the response */
+    uint16_t share; /* Id of the key share */
+    uint16_t status; /* Of a response, see enum signd_status */
+};
+
+/* Reads exactly len bytes. Returns 0, or -1 at the end of the stream or on error. */
+static inline int signd_read(int fd, void * buffer, size_t len) {
+    uint8_t * p = buffer;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Writes exactly len bytes. Returns 0, or -1 on error. */
+static inline int signd_write(int fd, const void * buffer, size_t len) {
+    const uint8_t * p = buffer;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static inline void signd_encode(struct signd_header * net, const struct signd_header * host) {
+    net->length = htonl(host->length);
+    net->id = htonl(host->id);
+    net->share = htons(host->share);
+    net->status = htons(host->status);
+}
+
+static inline void signd_decode(struct signd_header * host, const struct signd_header * net) {
+    host->length = ntohl(net->length);
+    host->id = ntohl(net->id);
+    host->share = ntohs(net->share);
+    host->status = ntohs(net->status);
+}
+
+/*
+ * Fills in the address of a Unix socket if path isn't NULL, of localhost:port otherwise. Returns the length of the
+ * address, or 0 if the path is too long.
+ */
+static inline socklen_t signd_address(struct sockaddr_storage * address, const char * path, int port) {
+    memset(address, 0, sizeof(*address));
+    if (path != NULL) {
+        struct sockaddr_un * un = (struct sockaddr_un *) address;
+        if (strlen(path) >= sizeof(un->sun_path)) {
+            return 0;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, path);
+        return sizeof(struct sockaddr_un);
+    }
+    struct sockaddr_in * in = (struct sockaddr_in *) address;
+    in->sin_family = AF_INET;
+    in->sin_port = htons(port);
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return sizeof(struct sockaddr_in);
+}
+
+#endif
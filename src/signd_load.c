@@ -0,0 +1,289 @@
+#define _GNU_SOURCE
+
+#include "tc.h"
+#include "signd.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * tc-signd-load: a load generator for tc-signd. Each connection keeps depth requests in flight, sending a new one as
+ * soon as a response arrives, and the latency of a request is the time from its send to its response. With -g it
+ * generates a key instead, and writes its metainfo and shares in the files the daemon loads.
+ */
+
+static const char * generate_prefix = NULL;
+static int key_size = 1024;
+static int k = 3;
+static int l = 5;
+
+static const char * metainfo_path = NULL;
+static const char * socket_path = NULL;
+static int port = 0;
+static int connections = 1;
+static int requests = 1000; /* Per connection */
+static int depth = 32;
+static int share_id = 1;
+static int verify = 0;
+
+#define DOCUMENTS 64
+
+static key_metainfo_t * info;
+static bytes_t * docs[DOCUMENTS];
+static size_t response_size; /* Of the payload of a signature share */
+static size_t share_size;
+
+struct client {
+    pthread_t thread;
+    double * latencies; /* Of each request */
+    int failures;
+};
+
+void set_parameters(int argc, char ** argv)
+{
+    int opt;
+    while((opt = getopt(argc, argv, "g:s:k:l:m:u:p:c:n:d:i:v")) != -1){
+	switch(opt) {
+	case 'g':
+	    generate_prefix = optarg;
+	    break;
+	case 's':
+	    key_size = strtol(optarg, NULL, 10);
+	    break;
+	case 'k':
+	    k = strtol(optarg, NULL, 10);
+	    break;
+	case 'l':
+	    l = strtol(optarg, NULL, 10);
+	    break;
+	case 'm':
+	    metainfo_path = optarg;
+	    break;
+	case 'u':
+	    socket_path = optarg;
+	    break;
+	case 'p':
+	    port = strtol(optarg, NULL, 10);
+	    break;
+	case 'c':
+	    connections = strtol(optarg, NULL, 10);
+	    break;
+	case 'n':
+	    requests = strtol(optarg, NULL, 10);
+	    break;
+	case 'd':
+	    depth = strtol(optarg, NULL, 10);
+	    break;
+	case 'i':
+	    share_id = strtol(optarg, NULL, 10);
+	    break;
+	case 'v':
+	    verify = 1;
+	    break;
+	default:
+	    fprintf(stderr, "Usage: %s -g prefix [-s key size] [-k k] [-l l]\n"
+		    "       %s -m metainfo (-u socket path | -p port) [-c connections] [-n requests per connection] "
+		    "[-d requests in flight] [-i share id] [-v]\n", argv[0], argv[0]);
+	    exit(EXIT_FAILURE);
+	}
+    }
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void write_file(const char * path, char * data)
+{
+    FILE * f = fopen(path, "w");
+    if (f == NULL || fprintf(f, "%s\n", data) < 0 || fclose(f) != 0) {
+	perror(path);
+	exit(EXIT_FAILURE);
+    }
+    free(data);
+}
+
+static int generate()
+{
+    key_share_t ** shares = tc_generate_keys(&info, key_size, k, l, NULL);
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.meta", generate_prefix);
+    write_file(path, tc_serialize_key_metainfo(info));
+    for (int i = 0; i < l; i++) {
+	snprintf(path, sizeof(path), "%s.share.%d", generate_prefix, i + 1);
+	write_file(path, tc_serialize_key_share(shares[i]));
+    }
+    printf("Wrote %s.meta and %s.share.1 to %s.share.%d\n", generate_prefix, generate_prefix, generate_prefix, l);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    return EXIT_SUCCESS;
+}
+
+static char * read_file(const char * path)
+{
+    FILE * f = fopen(path, "r");
+    if (f == NULL) {
+	perror(path);
+	exit(EXIT_FAILURE);
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char * data = malloc(len + 1);
+    len = fread(data, 1, len, f);
+    fclose(f);
+    while (len > 0 && (data[len - 1] == '\n' || data[len - 1] == '\r')) {
+	len--;
+    }
+    data[len] = '\0';
+    return data;
+}
+
+static int send_request(int fd, uint32_t id, const bytes_t * doc)
+{
+    struct signd_header request = {.length = doc->data_len, .id = id, .share = share_id}, net;
+    signd_encode(&net, &request);
+    return signd_write(fd, &net, sizeof(net)) == 0 && signd_write(fd, doc->data, doc->data_len) == 0 ? 0 : -1;
+}
+
+static void * run_client(void * arg)
+{
+    struct client * client = arg;
+    struct sockaddr_storage address;
+    socklen_t address_len = signd_address(&address, socket_path, port);
+    int fd = socket(address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &address, address_len) != 0) {
+	perror("tc-signd-load");
+	exit(EXIT_FAILURE);
+    }
+    if (socket_path == NULL) {
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    double * sent = malloc(requests * sizeof(double));
+    uint8_t * payload = malloc(response_size);
+    void * share_buffer = malloc(share_size);
+    int next = 0;
+    for (int received = 0; received < requests; received++) {
+	while (next < requests && next - received < depth) {
+	    sent[next] = now();
+	    if (send_request(fd, next, docs[next % DOCUMENTS]) != 0) {
+		fprintf(stderr, "tc-signd-load: the daemon closed the connection\n");
+		exit(EXIT_FAILURE);
+	    }
+	    next++;
+	}
+
+	struct signd_header net, response;
+	if (signd_read(fd, &net, sizeof(net)) != 0) {
+	    fprintf(stderr, "tc-signd-load: the daemon closed the connection\n");
+	    exit(EXIT_FAILURE);
+	}
+	signd_decode(&response, &net);
+	if (response.id >= (uint32_t) requests || response.length > response_size ||
+	    signd_read(fd, payload, response.length) != 0) {
+	    fprintf(stderr, "tc-signd-load: malformed response\n");
+	    exit(EXIT_FAILURE);
+	}
+	client->latencies[response.id] = now() - sent[response.id];
+
+	if (response.status != SIGND_OK) {
+	    client->failures++;
+	} else if (verify) {
+	    signature_share_t * signature =
+		tc_deserialize_signature_share_fixed_into(share_buffer, share_size, payload, response.length, info);
+	    if (signature == NULL || !tc_verify_signature(signature, docs[response.id % DOCUMENTS], info)) {
+		client->failures++;
+	    }
+	}
+    }
+
+    close(fd);
+    free(share_buffer);
+    free(payload);
+    free(sent);
+    tc_release_workspace();
+    return NULL;
+}
+
+static int compare_doubles(const void * a, const void * b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char ** argv)
+{
+    set_parameters(argc, argv);
+    if (generate_prefix != NULL) {
+	return generate();
+    }
+    if (metainfo_path == NULL || (socket_path == NULL) == (port == 0) || connections < 1 || requests < 1 ||
+	depth < 1) {
+	fprintf(stderr, "Expected a key metainfo, and either a socket path or a port\n");
+	return EXIT_FAILURE;
+    }
+
+    char * serialized = read_file(metainfo_path);
+    info = tc_deserialize_key_metainfo(serialized);
+    free(serialized);
+    if (info == NULL) {
+	fprintf(stderr, "%s: not a key metainfo\n", metainfo_path);
+	return EXIT_FAILURE;
+    }
+    response_size = tc_signature_share_fixed_size(info);
+    share_size = tc_signature_share_size(info);
+    for (int i = 0; i < DOCUMENTS; i++) {
+	char message[32];
+	snprintf(message, sizeof(message), "Document %d", i);
+	bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+	docs[i] = tc_prepare_document(doc, TC_SHA256, info);
+	tc_clear_bytes(doc);
+    }
+
+    struct client * clients = calloc(connections, sizeof(struct client));
+    double start = now();
+    for (int i = 0; i < connections; i++) {
+	clients[i].latencies = malloc(requests * sizeof(double));
+	pthread_create(&clients[i].thread, NULL, run_client, &clients[i]);
+    }
+    int failures = 0;
+    for (int i = 0; i < connections; i++) {
+	pthread_join(clients[i].thread, NULL);
+	failures += clients[i].failures;
+    }
+    double end = now();
+
+    size_t total = (size_t) connections * requests;
+    double * latencies = malloc(total * sizeof(double));
+    for (int i = 0; i < connections; i++) {
+	memcpy(latencies + (size_t) i * requests, clients[i].latencies, requests * sizeof(double));
+	free(clients[i].latencies);
+    }
+    qsort(latencies, total, sizeof(double), compare_doubles);
+
+    printf("Connections: %d, requests: %zu, in flight per connection: %d, failures: %d\n", connections, total, depth,
+	   failures);
+    printf("Throughput: %.1f signature shares/s\n", total / (end - start));
+    printf("Latency: p50 %.3f ms, p99 %.3f ms, p999 %.3f ms, max %.3f ms\n",
+	   latencies[(total - 1) / 2] * 1e3, latencies[(size_t) ((total - 1) * 0.99)] * 1e3,
+	   latencies[(size_t) ((total - 1) * 0.999)] * 1e3, latencies[total - 1] * 1e3);
+
+    free(latencies);
+    free(clients);
+    for (int i = 0; i < DOCUMENTS; i++) {
+	tc_clear_bytes(docs[i]);
+    }
+    tc_clear_key_metainfo(info);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,451 @@
+#define _GNU_SOURCE
+
+#include "tc.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Simulates a cluster in one process: l nodes, each a thread with its own key share, and a combiner. A client sends
+ * every request to all the nodes at the given rate, the nodes sign and send back their serialized shares, and the
+ * combiner deserializes and verifies them and joins the first k valid ones. Messages go through in-memory mailboxes
+ * that hold each one until its delivery time, the send time plus the network delay and a uniform jitter.
+ *
+ * A slow node takes longer to answer, a faulty one signs another document. The combiner has to skip its shares, so
+ * with more than l - k faulty nodes no request completes. A request without k valid shares by its timeout fails, and
+ * the failed requests are reported apart from the latency of the completed ones.
+ */
+
+static int key_size = 1024;
+static int k = 3;
+static int l = 5;
+static int requests = 200;
+static double rate = 0; /* Requests per second, 0 sends them all at once */
+static double delay = 0; /* Seconds, one way */
+static double jitter = 0;
+static int slow_node = 0;
+static double slow_delay = 0.01;
+static int faulty_node = 0;
+static double timeout = 10; /* Seconds a request may take */
+
+struct message {
+    double deliver_at;
+    int request; /* -1 stops the receiver */
+    int from; /* Node id of a share */
+    char * payload; /* Serialized signature share */
+};
+
+struct mailbox {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    struct message * heap; /* Min-heap by deliver_at */
+    size_t count;
+    size_t capacity;
+};
+
+struct request {
+    bytes_t * prepared;
+    double sent;
+    double done;
+    int failed;
+    int valid;
+    signature_share_t ** shares;
+};
+
+struct node {
+    pthread_t thread;
+    int id;
+    key_share_t * share;
+    struct mailbox inbox;
+    unsigned seed;
+};
+
+static key_metainfo_t * info;
+static struct request * table;
+static struct node * nodes;
+static struct mailbox combiner_inbox;
+static bytes_t * faulty_doc;
+static atomic_int sent_requests; /* Requests whose sent time is set */
+
+void set_parameters(int argc, char ** argv)
+{
+    int opt;
+    while((opt = getopt(argc, argv, "k:l:s:n:r:d:j:w:W:f:t:")) != -1){
+	switch(opt) {
+	case 'k':
+	    k = strtol(optarg, NULL, 10);
+	    break;
+	case 'l':
+	    l = strtol(optarg, NULL, 10);
+	    break;
+	case 's':
+	    key_size = strtol(optarg, NULL, 10);
+	    break;
+	case 'n':
+	    requests = strtol(optarg, NULL, 10);
+	    break;
+	case 'r':
+	    rate = strtod(optarg, NULL);
+	    break;
+	case 'd':
+	    delay = strtod(optarg, NULL) / 1e6;
+	    break;
+	case 'j':
+	    jitter = strtod(optarg, NULL) / 1e6;
+	    break;
+	case 'w':
+	    slow_node = strtol(optarg, NULL, 10);
+	    break;
+	case 'W':
+	    slow_delay = strtod(optarg, NULL) / 1e6;
+	    break;
+	case 'f':
+	    faulty_node = strtol(optarg, NULL, 10);
+	    break;
+	case 't':
+	    timeout = strtod(optarg, NULL) / 1e3;
+	    break;
+	default:
+	    fprintf(stderr, "Usage: %s [-k k] [-l l] [-s key size] [-n requests] [-r requests/s] [-d delay us] "
+		    "[-j jitter us] [-w slow node] [-W slow node delay us] [-f faulty node] [-t timeout ms]\n", argv[0]);
+	    exit(EXIT_FAILURE);
+	}
+    }
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_until(double t)
+{
+    struct timespec ts = {.tv_sec = (time_t) t, .tv_nsec = (long) ((t - (time_t) t) * 1e9)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/* Delay of a message sent now, drawn with the seed of the sender. */
+static double network_delay(unsigned * seed)
+{
+    double d = delay + jitter * (2.0 * rand_r(seed) / RAND_MAX - 1.0);
+    return d > 0 ? d : 0;
+}
+
+static void mailbox_init(struct mailbox * box)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&box->ready, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&box->lock, NULL);
+    box->heap = NULL;
+    box->count = box->capacity = 0;
+}
+
+static void mailbox_clear(struct mailbox * box)
+{
+    pthread_cond_destroy(&box->ready);
+    pthread_mutex_destroy(&box->lock);
+    free(box->heap);
+}
+
+static void mailbox_send(struct mailbox * box, struct message message)
+{
+    pthread_mutex_lock(&box->lock);
+    if (box->count == box->capacity) {
+	box->capacity = box->capacity ? 2 * box->capacity : 64;
+	box->heap = realloc(box->heap, box->capacity * sizeof(struct message));
+    }
+    size_t i = box->count++;
+    while (i > 0 && box->heap[(i - 1) / 2].deliver_at > message.deliver_at) {
+	box->heap[i] = box->heap[(i - 1) / 2];
+	i = (i - 1) / 2;
+    }
+    box->heap[i] = message;
+    pthread_cond_signal(&box->ready);
+    pthread_mutex_unlock(&box->lock);
+}
+
+/* Waits for the message with the earliest delivery time, and for that time, or until the deadline if it isn't
+ * negative. Returns 0 if the deadline came first. */
+static int mailbox_receive(struct mailbox * box, double deadline, struct message * message)
+{
+    pthread_mutex_lock(&box->lock);
+    for (;;) {
+	double t = box->count > 0 ? box->heap[0].deliver_at : -1;
+	double current = now();
+	if (box->count > 0 && t <= current) {
+	    break;
+	}
+	if (deadline >= 0 && deadline <= current) {
+	    pthread_mutex_unlock(&box->lock);
+	    return 0;
+	}
+	if (t < 0 || (deadline >= 0 && deadline < t)) {
+	    t = deadline;
+	}
+	if (t < 0) {
+	    pthread_cond_wait(&box->ready, &box->lock);
+	    continue;
+	}
+	struct timespec ts = {.tv_sec = (time_t) t, .tv_nsec = (long) ((t - (time_t) t) * 1e9)};
+	pthread_cond_timedwait(&box->ready, &box->lock, &ts);
+    }
+
+    struct message top = box->heap[0], last = box->heap[--box->count];
+    size_t i = 0;
+    for (;;) {
+	size_t child = 2 * i + 1;
+	if (child >= box->count) {
+	    break;
+	}
+	if (child + 1 < box->count && box->heap[child + 1].deliver_at < box->heap[child].deliver_at) {
+	    child++;
+	}
+	if (last.deliver_at <= box->heap[child].deliver_at) {
+	    break;
+	}
+	box->heap[i] = box->heap[child];
+	i = child;
+    }
+    box->heap[i] = last;
+    pthread_mutex_unlock(&box->lock);
+    *message = top;
+    return 1;
+}
+
+static void * run_node(void * arg)
+{
+    struct node * node = arg;
+    for (;;) {
+	struct message message;
+	mailbox_receive(&node->inbox, -1, &message);
+	if (message.request < 0) {
+	    break;
+	}
+
+	const bytes_t * doc = node->id == faulty_node ? faulty_doc : table[message.request].prepared;
+	signature_share_t * signature = tc_node_sign(node->share, doc, info);
+	char * serialized = tc_serialize_signature_share(signature);
+	tc_clear_signature_share(signature);
+	if (node->id == slow_node) {
+	    sleep_until(now() + slow_delay);
+	}
+
+	struct message reply = {
+	    .deliver_at = now() + network_delay(&node->seed),
+	    .request = message.request,
+	    .from = node->id,
+	    .payload = serialized,
+	};
+	mailbox_send(&combiner_inbox, reply);
+    }
+    tc_release_workspace();
+    return NULL;
+}
+
+/* Gives up on a request, with the shares it had. */
+static void fail_request(struct request * request)
+{
+    request->failed = 1;
+    for (int j = 0; j < request->valid; j++) {
+	tc_clear_signature_share(request->shares[j]);
+    }
+}
+
+/* Combines the shares as they arrive, until every request is done or has failed. */
+static void * run_combiner(void * arg)
+{
+    (void) arg;
+    int remaining = requests;
+    int oldest = 0; /* The first request that is neither done nor failed */
+    while (remaining > 0) {
+	/* Requests are sent in order and have the same timeout, so they expire in order too */
+	double current = now();
+	while (oldest < requests && (table[oldest].done > 0 || table[oldest].failed ||
+				     (oldest < atomic_load(&sent_requests) && table[oldest].sent + timeout <= current))) {
+	    if (table[oldest].done == 0 && !table[oldest].failed) {
+		fail_request(&table[oldest]);
+		remaining--;
+	    }
+	    oldest++;
+	}
+	if (remaining == 0) {
+	    break;
+	}
+
+	/* Until the oldest request is sent, the combiner wakes up now and then to look again */
+	double deadline = oldest < atomic_load(&sent_requests) ? table[oldest].sent + timeout : current + timeout;
+	struct message message;
+	if (!mailbox_receive(&combiner_inbox, deadline, &message)) {
+	    continue;
+	}
+	struct request * request = &table[message.request];
+	signature_share_t * share = tc_deserialize_signature_share_for_key(message.payload, info);
+	free(message.payload);
+
+	if (request->done > 0 || request->failed || share == NULL ||
+	    !tc_verify_signature(share, request->prepared, info)) {
+	    if (share != NULL) {
+		tc_clear_signature_share(share);
+	    }
+	    continue;
+	}
+	request->shares[request->valid++] = share;
+	if (request->valid < k) {
+	    continue;
+	}
+
+	bytes_t * signature = tc_join_signatures((const signature_share_t **) request->shares, request->prepared, info);
+	request->done = now();
+	tc_clear_bytes(signature);
+	for (int j = 0; j < k; j++) {
+	    tc_clear_signature_share(request->shares[j]);
+	}
+	remaining--;
+    }
+    tc_release_workspace();
+    return NULL;
+}
+
+static int compare_doubles(const void * a, const void * b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char ** argv)
+{
+    set_parameters(argc, argv);
+    /* The preconditions of tc_generate_keys, which would only assert them */
+    if (k <= l / 2 || k > l || l > UINT16_MAX || requests < 1) {
+	fprintf(stderr, "Expected l/2 < k <= l and at least one request\n");
+	return EXIT_FAILURE;
+    }
+    if (key_size < 512 || key_size > 8192) {
+	fprintf(stderr, "Expected a key size between 512 and 8192 bits\n");
+	return EXIT_FAILURE;
+    }
+    if (slow_node < 0 || slow_node > l || faulty_node < 0 || faulty_node > l) {
+	fprintf(stderr, "Expected the slow and faulty nodes between 1 and l, or 0 for none\n");
+	return EXIT_FAILURE;
+    }
+    if (faulty_node >= 1 && l - k < 1) {
+	fprintf(stderr, "With a faulty node, no request would get k valid shares\n");
+	return EXIT_FAILURE;
+    }
+    if (!(timeout > 0)) {
+	fprintf(stderr, "Expected a positive timeout\n");
+	return EXIT_FAILURE;
+    }
+
+    key_share_t ** shares = tc_generate_keys(&info, key_size, k, l, NULL);
+    bytes_t * faulty = tc_init_bytes(strdup("Faulty"), 6);
+    faulty_doc = tc_prepare_document(faulty, TC_SHA256, info);
+
+    table = calloc(requests, sizeof(struct request));
+    for (int i = 0; i < requests; i++) {
+	char message[32];
+	snprintf(message, sizeof(message), "Request %d", i);
+	bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+	table[i].prepared = tc_prepare_document(doc, TC_SHA256, info);
+	table[i].shares = malloc(k * sizeof(signature_share_t *));
+	tc_clear_bytes(doc);
+    }
+
+    mailbox_init(&combiner_inbox);
+    pthread_t combiner;
+    pthread_create(&combiner, NULL, run_combiner, NULL);
+    nodes = calloc(l, sizeof(struct node));
+    for (int i = 0; i < l; i++) {
+	nodes[i].id = i + 1;
+	nodes[i].share = shares[i];
+	nodes[i].seed = i + 1;
+	mailbox_init(&nodes[i].inbox);
+	pthread_create(&nodes[i].thread, NULL, run_node, &nodes[i]);
+    }
+
+    /* The client, open loop: a request is sent at its time whether the earlier ones are done or not */
+    unsigned seed = 0;
+    double start = now();
+    for (int i = 0; i < requests; i++) {
+	if (rate > 0) {
+	    sleep_until(start + i / rate);
+	}
+	table[i].sent = now();
+	atomic_store(&sent_requests, i + 1);
+	for (int j = 0; j < l; j++) {
+	    struct message message = {.deliver_at = now() + network_delay(&seed), .request = i};
+	    mailbox_send(&nodes[j].inbox, message);
+	}
+    }
+
+    pthread_join(combiner, NULL);
+    double end = now();
+    for (int i = 0; i < l; i++) {
+	struct message stop = {.deliver_at = 0, .request = -1};
+	mailbox_send(&nodes[i].inbox, stop);
+    }
+    for (int i = 0; i < l; i++) {
+	pthread_join(nodes[i].thread, NULL);
+    }
+
+    /* Shares that arrived after their request was done */
+    while (combiner_inbox.count > 0) {
+	free(combiner_inbox.heap[--combiner_inbox.count].payload);
+    }
+
+    /* The latency of the completed requests, the failed ones are counted apart */
+    double * latencies = malloc(requests * sizeof(double));
+    int completed = 0;
+    for (int i = 0; i < requests; i++) {
+	if (!table[i].failed) {
+	    latencies[completed++] = table[i].done - table[i].sent;
+	}
+    }
+    qsort(latencies, completed, sizeof(double), compare_doubles);
+
+    printf("Nodes: %d of %d, key size: %d, requests: %d, rate: %g/s, delay: %g us, jitter: %g us\n",
+	   k, l, key_size, requests, rate, delay * 1e6, jitter * 1e6);
+    if (slow_node >= 1) {
+	printf("Slow node: %d (+%g us)\n", slow_node, slow_delay * 1e6);
+    }
+    if (faulty_node >= 1) {
+	printf("Faulty node: %d\n", faulty_node);
+    }
+    printf("Throughput: %.1f signatures/s\n", completed / (end - start));
+    if (completed > 0) {
+	printf("Latency: p50 %.3f ms, p99 %.3f ms, p999 %.3f ms, max %.3f ms, failed %d of %d (timeout %g ms)\n",
+	       latencies[(completed - 1) / 2] * 1e3, latencies[(int) ((completed - 1) * 0.99)] * 1e3,
+	       latencies[(int) ((completed - 1) * 0.999)] * 1e3, latencies[completed - 1] * 1e3, requests - completed,
+	       requests, timeout * 1e3);
+    } else {
+	printf("Latency: none completed, failed %d of %d (timeout %g ms)\n", requests, requests, timeout * 1e3);
+    }
+
+    free(latencies);
+    for (int i = 0; i < l; i++) {
+	mailbox_clear(&nodes[i].inbox);
+    }
+    free(nodes);
+    mailbox_clear(&combiner_inbox);
+    for (int i = 0; i < requests; i++) {
+	tc_clear_bytes(table[i].prepared);
+	free(table[i].shares);
+    }
+    free(table);
+    tc_clear_bytes_n(faulty, faulty_doc, NULL);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    return EXIT_SUCCESS;
+}
@@ -6,17 +6,8 @@
 
 #include "tc_internal.h"
 
-void * alloc(size_t size) {
-	void * b = malloc(size);
-	if (b == NULL) {
-		perror("alloc");
-		abort();
-	}
-	return b;
-}
-
 bytes_t * tc_init_bytes(void * bs, size_t len) {
-    bytes_t * out = alloc(sizeof(bytes_t));
+    bytes_t * out = pool_alloc(sizeof(bytes_t));
     out->data = bs;
     out->data_len = len;
 
@@ -24,21 +15,16 @@ bytes_t * tc_init_bytes(void * bs, size_t len) {
 }
 
 bytes_t *tc_init_bytes_copy(void *bs, size_t len) {
-    bytes_t * out = alloc(sizeof(bytes_t));
-    out->data = memcpy(malloc(len), bs, len);
+    bytes_t * out = pool_alloc(sizeof(bytes_t));
+    out->data = memcpy(alloc(len), bs, len);
     out->data_len = len;
 
     return out;
 }
 
-static bytes_t * tc_init_bytes_array(size_t len) {
-    bytes_t * bytes_array =  alloc(len*sizeof(bytes_t));
-    return bytes_array;
-}
-
 void tc_clear_bytes(bytes_t * bytes) {
-    free(bytes->data);
-    free(bytes);
+    tc_free(bytes->data);
+    pool_free(bytes, sizeof(bytes_t));
 }
 
 void* tc_release_bytes(bytes_t *bytes, uint32_t *len) {
@@ -46,18 +32,11 @@ void* tc_release_bytes(bytes_t *bytes, uint32_t *len) {
         *len = bytes->data_len;
     }
     void *data = bytes->data;
-    free(bytes);
+    pool_free(bytes, sizeof(bytes_t));
 
     return data;
 }
 
-static void tc_clear_bytes_array(bytes_t * b, int count) {
-    for(int i=0; i<count; i++) {
-        free(b[i].data);
-    }
-    free(b);
-}
-
 void tc_clear_bytes_n(bytes_t * bytes, ...) {
     va_list ap;
     va_start(ap, bytes);
@@ -72,39 +51,181 @@ void tc_clear_bytes_n(bytes_t * bytes, ...) {
     va_end(ap);
 }
 
-public_key_t * tc_init_public_key() {
-    public_key_t * pk = alloc(sizeof(public_key_t));
+#if GMP_NAIL_BITS != 0
+# error "Limbs with nails are not supported"
+#endif
 
-    pk->n = tc_init_bytes(NULL, 0);
-    pk->e = tc_init_bytes(NULL, 0);
+size_t tc_limbs_bytes_len(const mp_limb_t * limbs, mp_size_t count) {
+    while (count > 0 && limbs[count - 1] == 0) {
+        count--;
+    }
+    if (count == 0) {
+        return 0;
+    }
 
-    return pk;
+    size_t top_bytes = 0;
+    for (mp_limb_t top = limbs[count - 1]; top != 0; top >>= 8) {
+        top_bytes++;
+    }
+    return (count - 1) * sizeof(mp_limb_t) + top_bytes;
+}
+
+/* Writes z to out as exactly len big-endian bytes, padded with zeros. */
+void tc_mpz_to_fixed_bytes(uint8_t * out, size_t len, mpz_srcptr z) {
+    size_t size = mpz_sgn(z) == 0 ? 0 : TC_OCTETS_SIZE(z);
+    assert(mpz_sgn(z) >= 0 && size <= len);
+    memset(out, 0, len - size);
+    mpz_export(out + len - size, NULL, 1, 1, 0, 0, z);
+}
+
+size_t tc_limbs_to_bytes(uint8_t * out, const mp_limb_t * limbs, mp_size_t count) {
+    size_t len = tc_limbs_bytes_len(limbs, count);
+    for (size_t i = 0; i < len; i++) {
+        out[len - 1 - i] = (uint8_t) (limbs[i / sizeof(mp_limb_t)] >> (8 * (i % sizeof(mp_limb_t))));
+    }
+    return len;
 }
 
+void tc_bytes_to_limbs(mp_limb_t * limbs, mp_size_t count, const uint8_t * bytes, size_t len) {
+    memset(limbs, 0, count * sizeof(mp_limb_t));
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = bytes[len - 1 - i];
+        size_t limb = i / sizeof(mp_limb_t);
+        if (byte != 0 && limb < (size_t) count) {
+            limbs[limb] |= (mp_limb_t) byte << (8 * (i % sizeof(mp_limb_t)));
+        }
+        assert(byte == 0 || limb < (size_t) count);
+    }
+}
 
-void tc_clear_public_key(public_key_t * pk) {
-    tc_clear_bytes_n(pk->e, pk->n, NULL);
-    free(pk);
+/* Points the numbers of params to p, and returns the memory after them. */
+static mp_limb_t * layout_key_params(struct key_params * params, mp_limb_t * p, mp_size_t n_limbs,
+                                     mp_size_t e_limbs) {
+    params->n_limbs = n_limbs;
+    params->e_limbs = e_limbs;
+    params->n = p;
+    p += n_limbs;
+    params->e = p;
+    p += e_limbs;
+    params->vk_v = p;
+    p += n_limbs;
+    params->vk_u = p;
+    p += n_limbs;
+    params->mont.one = p;
+    p += n_limbs;
+    params->mont.r2 = p;
+    p += n_limbs;
+    return p;
 }
 
-key_metainfo_t *tc_init_key_metainfo(uint16_t k, uint16_t l) {
+/* Points the big-endian public key of params to p, and returns the memory after it. */
+static uint8_t * layout_public_key(struct key_params * params, uint8_t * p) {
+    params->public_key.n.data = p;
+    params->public_key.n.data_len = 0;
+    p += params->n_limbs * sizeof(mp_limb_t);
+    params->public_key.e.data = p;
+    params->public_key.e.data_len = 0;
+    p += params->e_limbs * sizeof(mp_limb_t);
+    return p;
+}
+
+static size_t key_params_size(mp_size_t n_limbs, mp_size_t e_limbs) {
+    return (5 * n_limbs + e_limbs) * sizeof(mp_limb_t) + (n_limbs + e_limbs) * sizeof(mp_limb_t);
+}
+
+/* Derives the big-endian public key and the Montgomery context once n and e are set. */
+void tc_set_public_key(struct key_params * params) {
+    public_key_t * pk = &params->public_key;
+    pk->n.data_len = tc_limbs_to_bytes(pk->n.data, params->n, params->n_limbs);
+    pk->e.data_len = tc_limbs_to_bytes(pk->e.data, params->e, params->e_limbs);
+    mont_init(&params->mont, params->n, params->n_limbs);
+}
+
+key_metainfo_t *tc_init_key_metainfo(uint16_t k, uint16_t l, mp_size_t n_limbs, mp_size_t e_limbs) {
     assert(0 < l);
     assert(l/2 < k && k <= l);
+    assert(n_limbs > 0 && e_limbs > 0);
 
-    key_metainfo_t * metainfo = alloc(sizeof(key_metainfo_t));
+    size_t size = sizeof(key_metainfo_t) + key_params_size(n_limbs, e_limbs) + l * n_limbs * sizeof(mp_limb_t) +
+                  l * sizeof(_Atomic(struct fixed_base *));
+    key_metainfo_t * metainfo = alloc(size);
+    memset(metainfo, 0, size);
 
     metainfo->k = k;
     metainfo->l = l;
 
-    metainfo->public_key = tc_init_public_key();
-    metainfo->vk_i = tc_init_bytes_array(l);
-    metainfo->vk_v = tc_init_bytes(NULL, 0);
-    metainfo->vk_u = tc_init_bytes(NULL, 0);
+    mp_limb_t * p = layout_key_params(&metainfo->params, (mp_limb_t *) (metainfo + 1), n_limbs, e_limbs);
+    metainfo->vk_i = p;
+    p += l * n_limbs;
+    metainfo->vk_inverse_tables = (_Atomic(struct fixed_base *) *) p;
+    p += l;
+    layout_public_key(&metainfo->params, (uint8_t *) p);
 
-    assert(metainfo != NULL);
     return metainfo;
 }
 
+signer_metainfo_t *tc_init_signer_metainfo(uint16_t k, uint16_t l, uint16_t id, mp_size_t n_limbs,
+                                           mp_size_t e_limbs) {
+    assert(0 < l);
+    assert(l/2 < k && k <= l);
+    assert(0 < id && id <= l);
+    assert(n_limbs > 0 && e_limbs > 0);
+
+    size_t size = sizeof(signer_metainfo_t) + key_params_size(n_limbs, e_limbs) + n_limbs * sizeof(mp_limb_t);
+    signer_metainfo_t * metainfo = alloc(size);
+    memset(metainfo, 0, size);
+
+    metainfo->k = k;
+    metainfo->l = l;
+    metainfo->id = id;
+
+    mp_limb_t * p = layout_key_params(&metainfo->params, (mp_limb_t *) (metainfo + 1), n_limbs, e_limbs);
+    metainfo->vk_i = p;
+    p += n_limbs;
+    layout_public_key(&metainfo->params, (uint8_t *) p);
+
+    return metainfo;
+}
+
+signer_metainfo_t *tc_extract_signer_metainfo(const key_metainfo_t *info, uint16_t id) {
+    assert(info != NULL);
+    assert(0 < id && id <= info->l);
+
+    const struct key_params * params = &info->params;
+    mp_size_t n_limbs = params->n_limbs;
+    signer_metainfo_t * smi = tc_init_signer_metainfo(info->k, info->l, id, n_limbs, params->e_limbs);
+
+    mpn_copyi(smi->params.n, params->n, n_limbs);
+    mpn_copyi(smi->params.e, params->e, params->e_limbs);
+    mpn_copyi(smi->params.vk_v, params->vk_v, n_limbs);
+    mpn_copyi(smi->params.vk_u, params->vk_u, n_limbs);
+    mpn_copyi(smi->vk_i, TC_VK_I(info, id), n_limbs);
+    tc_set_public_key(&smi->params);
+
+    return smi;
+}
+
+tc_public_key_ctx_t *tc_init_public_key_ctx(const public_key_t *pk) {
+    const uint8_t * n = pk->n.data, * e = pk->e.data;
+    size_t n_len = pk->n.data_len, e_len = pk->e.data_len;
+    if (n_len == 0 || e_len == 0 || (n[n_len - 1] & 1) == 0) {
+        return NULL;
+    }
+
+    mp_size_t n_limbs = TC_BYTES_TO_LIMBS(n_len), e_limbs = TC_BYTES_TO_LIMBS(e_len);
+    size_t size = sizeof(tc_public_key_ctx_t) + key_params_size(n_limbs, e_limbs);
+    tc_public_key_ctx_t * ctx = alloc(size);
+    memset(ctx, 0, size);
+
+    mp_limb_t * p = layout_key_params(&ctx->params, (mp_limb_t *) (ctx + 1), n_limbs, e_limbs);
+    layout_public_key(&ctx->params, (uint8_t *) p);
+    tc_bytes_to_limbs(ctx->params.n, n_limbs, n, n_len);
+    tc_bytes_to_limbs(ctx->params.e, e_limbs, e, e_len);
+    tc_set_public_key(&ctx->params);
+
+    return ctx;
+}
+
 int tc_key_meta_info_k(const key_metainfo_t *i) {
     return i->k;
 }
@@ -114,7 +235,15 @@ int tc_key_meta_info_l(const key_metainfo_t *i) {
 }
 
 const public_key_t *tc_key_meta_info_public_key(const key_metainfo_t *i) {
-    return i->public_key;
+    return &i->params.public_key;
+}
+
+int tc_signer_metainfo_id(const signer_metainfo_t *i) {
+    return i->id;
+}
+
+const public_key_t *tc_signer_metainfo_public_key(const signer_metainfo_t *i) {
+    return &i->params.public_key;
 }
 
 int tc_key_share_id(const key_share_t *k) {
@@ -122,11 +251,11 @@ int tc_key_share_id(const key_share_t *k) {
 }
 
 const bytes_t * tc_public_key_n(const public_key_t *pk) {
-    return pk->n;
+    return &pk->n;
 }
 
 const bytes_t * tc_public_key_e(const public_key_t *pk) {
-    return pk->e;
+    return &pk->e;
 }
 
 int tc_signature_share_id(const signature_share_t *s) {
@@ -134,30 +263,49 @@ int tc_signature_share_id(const signature_share_t *s) {
 }
 
 void tc_clear_key_metainfo(key_metainfo_t * info) {
-	assert(info != NULL);
-    tc_clear_public_key(info->public_key);
-    tc_clear_bytes(info->vk_v);
-    tc_clear_bytes(info->vk_u);
-    tc_clear_bytes_array(info->vk_i, info->l);
-    free(info);
+    assert(info != NULL);
+    backend_clear_key_params(&info->params);
+    fixed_base_clear_key_metainfo(info);
+    precomputation_clear(info);
+    tc_free(info);
 }
 
-key_share_t * tc_init_key_share() {
-    key_share_t * ks = alloc(sizeof(key_share_t));
+void tc_clear_signer_metainfo(signer_metainfo_t * info) {
+    assert(info != NULL);
+    backend_clear_key_params(&info->params);
+    fixed_base_clear_key_params(&info->params);
+    tc_free(info);
+}
+
+void tc_clear_public_key_ctx(tc_public_key_ctx_t * ctx) {
+    assert(ctx != NULL);
+    backend_clear_key_params(&ctx->params);
+    tc_free(ctx);
+}
+
+static size_t key_share_size(mp_size_t n_limbs) {
+    return sizeof(key_share_t) + n_limbs * sizeof(mp_limb_t);
+}
+
+key_share_t * tc_init_key_share(mp_size_t n_limbs) {
+    assert(n_limbs > 0);
+    key_share_t * ks = pool_alloc(key_share_size(n_limbs));
 
-    ks->n = tc_init_bytes(NULL, 0);
-    ks->s_i = tc_init_bytes(NULL, 0);
+    ks->id = 0;
+    ks->n_limbs = n_limbs;
+    ks->s_i = (mp_limb_t *) (ks + 1);
+    mpn_zero(ks->s_i, n_limbs);
 
     return ks;
 }
 
 key_share_t ** tc_init_key_shares(key_metainfo_t * info) {
-	assert(info != NULL);
-	assert(info->l > 0);
+    assert(info != NULL);
+    assert(info->l > 0);
 
     key_share_t ** ks = alloc(sizeof(key_share_t*)*info->l);
     for(int i=0; i<info->l; i++) {
-        ks[i] = tc_init_key_share();
+        ks[i] = tc_init_key_share(info->params.n_limbs);
     }
 
     assert(ks != NULL);
@@ -165,30 +313,58 @@ key_share_t ** tc_init_key_shares(key_metainfo_t * info) {
 }
 
 void tc_clear_key_share(key_share_t * share) { 
-    tc_clear_bytes_n(share->s_i, share->n, NULL);
-    free(share);
+    pool_free(share, key_share_size(share->n_limbs));
 }
 
 void tc_clear_key_shares(key_share_t ** shares, key_metainfo_t * info){
-	assert(info != NULL && info->l > 0);
+    assert(info != NULL && info->l > 0);
     for(int i=0; i<info->l; i++) {
         tc_clear_key_share(shares[i]);
     }
-    free(shares);
+    tc_free(shares);
+}
+
+static size_t signature_share_size(mp_size_t n_limbs) {
+    return sizeof(signature_share_t) + (2 * n_limbs + TC_Z_LIMBS(n_limbs)) * sizeof(mp_limb_t);
 }
 
-signature_share_t * tc_init_signature_share() {
-    signature_share_t * ss = alloc(sizeof(signature_share_t));
+size_t tc_signature_share_size(const key_metainfo_t * info) {
+    return signature_share_size(info->params.n_limbs);
+}
+
+signature_share_t * tc_init_signature_share(mp_size_t n_limbs) {
+    assert(n_limbs > 0);
+    return signature_share_in(pool_alloc(signature_share_size(n_limbs)), n_limbs);
+}
+
+/* Lays out a signature share in buffer, of signature_share_size(n_limbs) bytes. */
+signature_share_t * signature_share_in(void * buffer, mp_size_t n_limbs) {
+    assert((uintptr_t) buffer % _Alignof(signature_share_t) == 0);
+    signature_share_t * ss = buffer;
 
-    ss->z = tc_init_bytes(NULL, 0);
-    ss->c = tc_init_bytes(NULL, 0);
-    ss->x_i = tc_init_bytes(NULL, 0);
+    ss->id = 0;
+    ss->n_limbs = n_limbs;
+    ss->x_i = (mp_limb_t *) (ss + 1);
+    ss->c = ss->x_i + n_limbs;
+    ss->z = ss->c + n_limbs;
 
-    assert(ss != NULL);
+    return ss;
+}
+
+signature_share_t * tc_signature_share_attach(void * buffer, size_t size, const key_metainfo_t * info) {
+    /* The bytes come from another process, nothing in them is trusted before it is checked against the key */
+    signature_share_t * ss = buffer;
+    mp_size_t n_limbs = info->params.n_limbs;
+    if ((uintptr_t) buffer % _Alignof(signature_share_t) != 0 || size < signature_share_size(n_limbs) ||
+        ss->n_limbs != n_limbs || ss->id < 1 || ss->id > info->l) {
+        return NULL;
+    }
+    uint16_t id = ss->id;
+    signature_share_in(buffer, ss->n_limbs);
+    ss->id = id;
     return ss;
 }
 
 void tc_clear_signature_share(signature_share_t * ss) {
-    tc_clear_bytes_n(ss->x_i, ss->c, ss->z, NULL);
-    free(ss);
+    pool_free(ss, signature_share_size(ss->n_limbs));
 }
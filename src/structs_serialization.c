@@ -11,12 +11,23 @@ static const uint16_t version = 1;
     do { memcpy((dst), &x, sizeof x); (dst) += sizeof x; } while(0)
 #define SERIALIZE_BYTES(dst, bs) \
     do { \
-        bytes_t *__b = (bs); \
+        const bytes_t *__b = (bs); \
         uint32_t __net_len = htonl(__b->data_len); \
         SERIALIZE_VARIABLE((dst), __net_len); \
         memcpy((dst), __b->data, __b->data_len); \
         (dst) += __b->data_len; \
     } while(0)
+/* Numbers are serialized big-endian, without leading zeros */
+#define SERIALIZE_LIMBS(dst, limbs, count) \
+    do { \
+        uint8_t *__len_p = (dst); \
+        (dst) += sizeof(uint32_t); \
+        size_t __len = tc_limbs_to_bytes((dst), (limbs), (count)); \
+        uint32_t __net_len = htonl(__len); \
+        memcpy(__len_p, &__net_len, sizeof __net_len); \
+        (dst) += __len; \
+    } while(0)
+#define LIMBS_SIZE(limbs, count) (sizeof(uint32_t) + tc_limbs_bytes_len((limbs), (count)))
 
 char *tc_serialize_key_share(const key_share_t *ks) {
     /*
@@ -27,23 +38,26 @@ char *tc_serialize_key_share(const key_share_t *ks) {
     uint16_t net_version = htons(version);
     uint16_t net_id = htons(ks->id);
 
+    /* Shares don't store n anymore, the field is kept empty for compatibility */
+    uint32_t net_n_len = htonl(0);
+
     /* We prepare the buffer */
-    size_t buffer_size = sizeof(net_version) + sizeof(net_id) + sizeof(ks->n->data_len) +
-                         sizeof(ks->s_i->data_len) + ks->n->data_len + ks->s_i->data_len;
-    uint8_t *buffer = malloc(buffer_size);
+    size_t buffer_size = sizeof(net_version) + sizeof(net_id) + sizeof(net_n_len) +
+                         LIMBS_SIZE(ks->s_i, ks->n_limbs);
+    uint8_t *buffer = alloc(buffer_size);
 
     /* Copy each field to the buffer */
     uint8_t *p = buffer;
 
     SERIALIZE_VARIABLE(p, net_version);
     SERIALIZE_VARIABLE(p, net_id);
-    SERIALIZE_BYTES(p, ks->n);
-    SERIALIZE_BYTES(p, ks->s_i);
+    SERIALIZE_VARIABLE(p, net_n_len);
+    SERIALIZE_LIMBS(p, ks->s_i, ks->n_limbs);
 
     bytes_t bs = {buffer, (uint32_t) buffer_size};
     char *b64 = tc_bytes_b64(&bs);
 
-    free(buffer);
+    tc_free(buffer);
 
     return b64;
 }
@@ -51,32 +65,32 @@ char *tc_serialize_key_share(const key_share_t *ks) {
 char *tc_serialize_signature_share(const signature_share_t *ss) {
     uint16_t net_version = htons(version);
     uint16_t net_id = htons(ss->id);
+    mp_size_t n_limbs = ss->n_limbs;
 
-    size_t buffer_size = sizeof(net_version) + sizeof(net_id) + sizeof(ss->x_i->data_len) +
-                         sizeof(ss->c->data_len) + sizeof(ss->z->data_len) + ss->x_i->data_len + ss->c->data_len +
-                         ss->z->data_len;
-    uint8_t *buffer = malloc(buffer_size);
+    size_t buffer_size = sizeof(net_version) + sizeof(net_id) + LIMBS_SIZE(ss->x_i, n_limbs) +
+                         LIMBS_SIZE(ss->c, n_limbs) + LIMBS_SIZE(ss->z, TC_Z_LIMBS(n_limbs));
+    uint8_t *buffer = alloc(buffer_size);
 
     uint8_t *p = buffer;
     SERIALIZE_VARIABLE(p, net_version);
     SERIALIZE_VARIABLE(p, net_id);
-    SERIALIZE_BYTES(p, ss->x_i);
-    SERIALIZE_BYTES(p, ss->c);
-    SERIALIZE_BYTES(p, ss->z);
+    SERIALIZE_LIMBS(p, ss->x_i, n_limbs);
+    SERIALIZE_LIMBS(p, ss->c, n_limbs);
+    SERIALIZE_LIMBS(p, ss->z, TC_Z_LIMBS(n_limbs));
 
     bytes_t bs = {buffer, (uint32_t) buffer_size};
     char *b64 = tc_bytes_b64(&bs);
-    free(buffer);
+    tc_free(buffer);
     return b64;
 }
 
 static bytes_t *serialize_public_key(const public_key_t *pk) {
-    size_t buffer_size = sizeof(pk->n->data_len) + sizeof(pk->e->data_len) +
-                         pk->n->data_len + pk->e->data_len;
-    uint8_t *buffer = malloc(buffer_size);
+    size_t buffer_size = sizeof(pk->n.data_len) + sizeof(pk->e.data_len) +
+                         pk->n.data_len + pk->e.data_len;
+    uint8_t *buffer = alloc(buffer_size);
     uint8_t *p = buffer;
-    SERIALIZE_BYTES(p, pk->n);
-    SERIALIZE_BYTES(p, pk->e);
+    SERIALIZE_BYTES(p, &pk->n);
+    SERIALIZE_BYTES(p, &pk->e);
 
     bytes_t *bs = tc_init_bytes(buffer, buffer_size);
 
@@ -84,12 +98,14 @@ static bytes_t *serialize_public_key(const public_key_t *pk) {
 }
 
 char *tc_serialize_key_metainfo(const key_metainfo_t *kmi) {
+    const struct key_params *params = &kmi->params;
+    mp_size_t n_limbs = params->n_limbs;
     size_t buffer_size = 0;
 
     uint16_t net_version = htons(version);
     buffer_size += sizeof net_version;
 
-    bytes_t *pk = serialize_public_key(kmi->public_key);
+    bytes_t *pk = serialize_public_key(&params->public_key);
     buffer_size += sizeof pk->data_len;
     buffer_size += pk->data_len;
 
@@ -99,39 +115,67 @@ char *tc_serialize_key_metainfo(const key_metainfo_t *kmi) {
     uint16_t net_l = htons(kmi->l);
     buffer_size += sizeof net_l;
 
-    bytes_t *vk_v = kmi->vk_v;
-    bytes_t *vk_u = kmi->vk_u;
+    buffer_size += LIMBS_SIZE(params->vk_v, n_limbs);
+    buffer_size += LIMBS_SIZE(params->vk_u, n_limbs);
 
-    buffer_size += sizeof vk_v->data_len; 
-    buffer_size += vk_v->data_len;
- 
-    buffer_size += sizeof vk_u->data_len;
-    buffer_size += vk_u->data_len;
+    for (int i = 1; i <= kmi->l; i++) {
+        buffer_size += LIMBS_SIZE(TC_VK_I(kmi, i), n_limbs);
+    }
 
+    uint8_t *buffer = alloc(buffer_size);
+    uint8_t *p = buffer;
 
-    for (int i = 0; i < kmi->l; i++) {
-        buffer_size += sizeof(kmi->vk_i[i].data_len);
-        buffer_size += kmi->vk_i[i].data_len;
+    SERIALIZE_VARIABLE(p, net_version);
+    SERIALIZE_BYTES(p, pk);
+    SERIALIZE_VARIABLE(p, net_k);
+    SERIALIZE_VARIABLE(p, net_l);
+    SERIALIZE_LIMBS(p, params->vk_v, n_limbs);
+    SERIALIZE_LIMBS(p, params->vk_u, n_limbs);
+    for (int i = 1; i <= kmi->l; i++) {
+        SERIALIZE_LIMBS(p, TC_VK_I(kmi, i), n_limbs);
     }
 
-    uint8_t *buffer = malloc(buffer_size);
+    bytes_t bs = {buffer, buffer_size};
+    char *b64 = tc_bytes_b64(&bs);
+    tc_clear_bytes(pk);
+    tc_free(buffer);
+
+    return b64;
+}
+
+char *tc_serialize_signer_metainfo(const signer_metainfo_t *smi) {
+    const struct key_params *params = &smi->params;
+    mp_size_t n_limbs = params->n_limbs;
+
+    uint16_t net_version = htons(version);
+    uint16_t net_k = htons(smi->k);
+    uint16_t net_l = htons(smi->l);
+    uint16_t net_id = htons(smi->id);
+
+    bytes_t *pk = serialize_public_key(&params->public_key);
+
+    size_t buffer_size = sizeof net_version + sizeof pk->data_len + pk->data_len +
+                         sizeof net_k + sizeof net_l + sizeof net_id +
+                         LIMBS_SIZE(params->vk_v, n_limbs) +
+                         LIMBS_SIZE(params->vk_u, n_limbs) +
+                         LIMBS_SIZE(smi->vk_i, n_limbs);
+
+    uint8_t *buffer = alloc(buffer_size);
     uint8_t *p = buffer;
 
     SERIALIZE_VARIABLE(p, net_version);
     SERIALIZE_BYTES(p, pk);
     SERIALIZE_VARIABLE(p, net_k);
     SERIALIZE_VARIABLE(p, net_l);
-    SERIALIZE_BYTES(p, vk_v);
-    SERIALIZE_BYTES(p, vk_u);
-    for (int i = 0; i < kmi->l; i++) {
-        bytes_t *v = kmi->vk_i + i;
-        SERIALIZE_BYTES(p, v);
-    }
+    SERIALIZE_VARIABLE(p, net_id);
+    SERIALIZE_LIMBS(p, params->vk_v, n_limbs);
+    SERIALIZE_LIMBS(p, params->vk_u, n_limbs);
+    SERIALIZE_LIMBS(p, smi->vk_i, n_limbs);
 
     bytes_t bs = {buffer, buffer_size};
     char *b64 = tc_bytes_b64(&bs);
     tc_clear_bytes(pk);
-    free(buffer);
+    tc_free(buffer);
 
     return b64;
 }
@@ -143,19 +187,57 @@ char *tc_serialize_key_metainfo(const key_metainfo_t *kmi) {
         (buf) += sizeof dst; \
     } while (0)
 
-#define DESERIALIZE_BYTES(dst, buf) \
+/* Points dst to the big-endian data of the next field, without copying it */
+#define DESERIALIZE_FIELD(dst, buf) \
     do { \
         bytes_t * __b = (dst); \
         uint32_t len; \
         memcpy(&len, (buf), sizeof(len)); \
         len = ntohl(len); \
         (buf) += sizeof(len); \
-        __b->data = alloc(len); \
+        __b->data = (buf); \
         __b->data_len = len; \
-        memcpy(__b->data, (buf), len); \
         (buf) += len; \
     } while(0)
 
+/* Like DESERIALIZE_FIELD, but fails with -1 instead of reading past end */
+static int deserialize_field_checked(bytes_t *dst, uint8_t **buf, const uint8_t *end) {
+    uint32_t len;
+    if ((size_t) (end - *buf) < sizeof(len)) {
+        return -1;
+    }
+    memcpy(&len, *buf, sizeof(len));
+    len = ntohl(len);
+    *buf += sizeof(len);
+    if ((size_t) (end - *buf) < len) {
+        return -1;
+    }
+    dst->data = *buf;
+    dst->data_len = len;
+    *buf += len;
+    return 0;
+}
+
+#define FIELD_TO_LIMBS(limbs, count, field) \
+    tc_bytes_to_limbs((limbs), (count), (field)->data, (field)->data_len)
+
+/* The number of limbs needed by the big-endian number in field, ignoring its leading zeros */
+static mp_size_t field_limbs(const bytes_t *field) {
+    const uint8_t *p = field->data;
+    size_t len = field->data_len;
+    while (len > 0 && *p == 0) {
+        p++;
+        len--;
+    }
+    return TC_BYTES_TO_LIMBS(len);
+}
+
+static void max_limbs(mp_size_t *max, mp_size_t limbs) {
+    if (limbs > *max) {
+        *max = limbs;
+    }
+}
+
 key_share_t *tc_deserialize_key_share(const char *b64) {
     bytes_t *buffer = tc_b64_bytes(b64);
     uint8_t *p = buffer->data;
@@ -169,23 +251,39 @@ key_share_t *tc_deserialize_key_share(const char *b64) {
         return NULL;
     }
 
-    key_share_t *ks = tc_init_key_share();
+    uint16_t id;
+    bytes_t n, s_i;
+    DESERIALIZE_SHORT(id, p);
+    DESERIALIZE_FIELD(&n, p);
+    DESERIALIZE_FIELD(&s_i, p);
+
+    /* Old shares carry n, which gives the stride of the key */
+    mp_size_t n_limbs = 1;
+    max_limbs(&n_limbs, field_limbs(&n));
+    max_limbs(&n_limbs, field_limbs(&s_i));
 
-    DESERIALIZE_SHORT(ks->id, p);
-    DESERIALIZE_BYTES(ks->n, p);
-    DESERIALIZE_BYTES(ks->s_i, p);
+    key_share_t *ks = tc_init_key_share(n_limbs);
+    ks->id = id;
+    FIELD_TO_LIMBS(ks->s_i, n_limbs, &s_i);
 
     tc_clear_bytes(buffer);
 
     return ks;
 }
 
-signature_share_t *tc_deserialize_signature_share(const char *b64) {
+/* Reads a signature share in the stride of the key of info, or in the stride of its own fields if info is NULL */
+static signature_share_t *deserialize_signature_share(const char *b64, const key_metainfo_t *info) {
     bytes_t *buffer = tc_b64_bytes(b64);
     uint8_t *p = buffer->data;
 
-
+    /* Signature shares come from other nodes, so every length is checked against the buffer */
     uint16_t message_version;
+    if (p == NULL || buffer->data_len < 2 * sizeof(uint16_t)) {
+        fprintf(stderr, "SignatureShare, Truncated message\n");
+        tc_clear_bytes(buffer);
+        return NULL;
+    }
+    const uint8_t *end = p + buffer->data_len;
     DESERIALIZE_SHORT(message_version, p);
 
     if (message_version != version) {
@@ -194,17 +292,123 @@ signature_share_t *tc_deserialize_signature_share(const char *b64) {
         return NULL;
     }
 
-    signature_share_t *ss = tc_init_signature_share();
-    DESERIALIZE_SHORT(ss->id, p);
-    DESERIALIZE_BYTES(ss->x_i, p);
-    DESERIALIZE_BYTES(ss->c, p);
-    DESERIALIZE_BYTES(ss->z, p);
+    uint16_t id;
+    bytes_t x_i, c, z;
+    DESERIALIZE_SHORT(id, p);
+    if (deserialize_field_checked(&x_i, &p, end) != 0 || deserialize_field_checked(&c, &p, end) != 0 ||
+        deserialize_field_checked(&z, &p, end) != 0) {
+        fprintf(stderr, "SignatureShare, Truncated message\n");
+        tc_clear_bytes(buffer);
+        return NULL;
+    }
+
+    /* The stride fits x_i and c, and z in TC_Z_LIMBS of it */
+    mp_size_t n_limbs = 1;
+    if (info != NULL) {
+        n_limbs = info->params.n_limbs;
+        if (field_limbs(&x_i) > n_limbs || field_limbs(&c) > n_limbs || field_limbs(&z) > TC_Z_LIMBS(n_limbs) ||
+            id < 1 || id > info->l) {
+            fprintf(stderr, "SignatureShare, Not a share of the key\n");
+            tc_clear_bytes(buffer);
+            return NULL;
+        }
+    } else {
+        max_limbs(&n_limbs, field_limbs(&x_i));
+        max_limbs(&n_limbs, field_limbs(&c));
+        max_limbs(&n_limbs, (field_limbs(&z) + 1) / 2);
+    }
+
+    signature_share_t *ss = tc_init_signature_share(n_limbs);
+    ss->id = id;
+    FIELD_TO_LIMBS(ss->x_i, n_limbs, &x_i);
+    FIELD_TO_LIMBS(ss->c, n_limbs, &c);
+    FIELD_TO_LIMBS(ss->z, TC_Z_LIMBS(n_limbs), &z);
 
     tc_clear_bytes(buffer);
 
     return ss;
 }
 
+signature_share_t *tc_deserialize_signature_share(const char *b64) {
+    return deserialize_signature_share(b64, NULL);
+}
+
+signature_share_t *tc_deserialize_signature_share_for_key(const char *b64, const key_metainfo_t *info) {
+    return deserialize_signature_share(b64, info);
+}
+
+/* The bytes of z in the fixed length format, which hold TC_Z_LIMBS of any limb size */
+#define FIXED_Z_LEN(n_len) (2 * (n_len) + 2 * 32)
+
+size_t tc_signature_share_fixed_size(const key_metainfo_t *info) {
+    size_t n_len = info->params.public_key.n.data_len;
+    return sizeof(uint16_t) + sizeof(uint32_t) + 2 * n_len + FIXED_Z_LEN(n_len);
+}
+
+/* Writes the number as exactly len big-endian bytes, padded with zeros. Fails with -1 if it doesn't fit. */
+static int limbs_to_fixed_bytes(uint8_t *out, size_t len, const mp_limb_t *limbs, mp_size_t count) {
+    size_t used = tc_limbs_bytes_len(limbs, count);
+    if (used > len) {
+        return -1;
+    }
+    memset(out, 0, len - used);
+    tc_limbs_to_bytes(out + len - used, limbs, count);
+    return 0;
+}
+
+int tc_serialize_signature_share_fixed(void *out, size_t len, const signature_share_t *ss,
+                                       const key_metainfo_t *info) {
+    size_t n_len = info->params.public_key.n.data_len;
+    if (len < tc_signature_share_fixed_size(info)) {
+        return -1;
+    }
+
+    uint16_t net_id = htons(ss->id);
+    uint32_t net_n_len = htonl(n_len);
+    uint8_t *p = out;
+    SERIALIZE_VARIABLE(p, net_id);
+    SERIALIZE_VARIABLE(p, net_n_len);
+    if (limbs_to_fixed_bytes(p, n_len, ss->x_i, ss->n_limbs) != 0 ||
+        limbs_to_fixed_bytes(p + n_len, n_len, ss->c, ss->n_limbs) != 0 ||
+        limbs_to_fixed_bytes(p + 2 * n_len, FIXED_Z_LEN(n_len), ss->z, TC_Z_LIMBS(ss->n_limbs)) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+signature_share_t *tc_deserialize_signature_share_fixed_into(void *buffer, size_t size, const void *in, size_t len,
+                                                             const key_metainfo_t *info) {
+    size_t n_len = info->params.public_key.n.data_len;
+    mp_size_t n_limbs = info->params.n_limbs;
+    if (size < tc_signature_share_size(info) || len != tc_signature_share_fixed_size(info)) {
+        return NULL;
+    }
+
+    const uint8_t *p = in;
+    uint16_t id;
+    uint32_t message_n_len;
+    DESERIALIZE_SHORT(id, p);
+    memcpy(&message_n_len, p, sizeof(message_n_len));
+    p += sizeof(message_n_len);
+    if (id < 1 || id > info->l || ntohl(message_n_len) != n_len) {
+        return NULL;
+    }
+
+    signature_share_t *ss = signature_share_in(buffer, n_limbs);
+    ss->id = id;
+    tc_bytes_to_limbs(ss->x_i, n_limbs, p, n_len);
+    tc_bytes_to_limbs(ss->c, n_limbs, p + n_len, n_len);
+    tc_bytes_to_limbs(ss->z, TC_Z_LIMBS(n_limbs), p + 2 * n_len, FIXED_Z_LEN(n_len));
+    return ss;
+}
+
+/* Reads the public key serialized by serialize_public_key */
+static void deserialize_public_key(bytes_t *n, bytes_t *e, const bytes_t *pk) {
+    uint8_t *p = pk->data;
+    DESERIALIZE_FIELD(n, p);
+    DESERIALIZE_FIELD(e, p);
+}
+
 key_metainfo_t *tc_deserialize_key_metainfo(const char *b64) {
     bytes_t *buffer = tc_b64_bytes(b64);
     uint8_t *p = buffer->data;
@@ -218,8 +422,9 @@ key_metainfo_t *tc_deserialize_key_metainfo(const char *b64) {
         return NULL;
     }
 
-    bytes_t *pk = tc_init_bytes(NULL, 0);
-    DESERIALIZE_BYTES(pk, p);
+    bytes_t pk, n, e;
+    DESERIALIZE_FIELD(&pk, p);
+    deserialize_public_key(&n, &e, &pk);
 
     uint16_t k;
     DESERIALIZE_SHORT(k, p);
@@ -227,21 +432,68 @@ key_metainfo_t *tc_deserialize_key_metainfo(const char *b64) {
     uint16_t l;
     DESERIALIZE_SHORT(l, p);
 
-    key_metainfo_t *kmi = tc_init_key_metainfo(k, l);
-    DESERIALIZE_BYTES(kmi->vk_v, p);
-    DESERIALIZE_BYTES(kmi->vk_u, p);
-    // We have to do this here, because init_key_meta_info initializes the vk_i array.
-    for (int i = 0; i < l; i++) {
-        bytes_t *v = kmi->vk_i + i;
-        DESERIALIZE_BYTES(v, p);
+    mp_size_t n_limbs = field_limbs(&n);
+    mp_size_t e_limbs = field_limbs(&e);
+    key_metainfo_t *kmi = tc_init_key_metainfo(k, l, n_limbs, e_limbs);
+    struct key_params *params = &kmi->params;
+
+    FIELD_TO_LIMBS(params->n, n_limbs, &n);
+    FIELD_TO_LIMBS(params->e, e_limbs, &e);
+    tc_set_public_key(params);
+
+    bytes_t field;
+    DESERIALIZE_FIELD(&field, p);
+    FIELD_TO_LIMBS(params->vk_v, n_limbs, &field);
+    DESERIALIZE_FIELD(&field, p);
+    FIELD_TO_LIMBS(params->vk_u, n_limbs, &field);
+    for (int i = 1; i <= l; i++) {
+        DESERIALIZE_FIELD(&field, p);
+        FIELD_TO_LIMBS(TC_VK_I(kmi, i), n_limbs, &field);
     }
-    p = pk->data;
-    DESERIALIZE_BYTES(kmi->public_key->n, p);
-    DESERIALIZE_BYTES(kmi->public_key->e, p);
 
     tc_clear_bytes(buffer);
-    tc_clear_bytes(pk);
     return kmi;
 }
 
+signer_metainfo_t *tc_deserialize_signer_metainfo(const char *b64) {
+    bytes_t *buffer = tc_b64_bytes(b64);
+    uint8_t *p = buffer->data;
+
+    uint16_t message_version;
+    DESERIALIZE_SHORT(message_version, p);
 
+    if (message_version != version) {
+        fprintf(stderr, "SignerMetaInfo, Version mismatch: (Message=%d) != (Library=%d)\n", message_version, version);
+        tc_clear_bytes(buffer);
+        return NULL;
+    }
+
+    bytes_t pk, n, e;
+    DESERIALIZE_FIELD(&pk, p);
+    deserialize_public_key(&n, &e, &pk);
+
+    uint16_t k, l, id;
+    DESERIALIZE_SHORT(k, p);
+    DESERIALIZE_SHORT(l, p);
+    DESERIALIZE_SHORT(id, p);
+
+    mp_size_t n_limbs = field_limbs(&n);
+    mp_size_t e_limbs = field_limbs(&e);
+    signer_metainfo_t *smi = tc_init_signer_metainfo(k, l, id, n_limbs, e_limbs);
+    struct key_params *params = &smi->params;
+
+    FIELD_TO_LIMBS(params->n, n_limbs, &n);
+    FIELD_TO_LIMBS(params->e, e_limbs, &e);
+    tc_set_public_key(params);
+
+    bytes_t field;
+    DESERIALIZE_FIELD(&field, p);
+    FIELD_TO_LIMBS(params->vk_v, n_limbs, &field);
+    DESERIALIZE_FIELD(&field, p);
+    FIELD_TO_LIMBS(params->vk_u, n_limbs, &field);
+    DESERIALIZE_FIELD(&field, p);
+    FIELD_TO_LIMBS(smi->vk_i, n_limbs, &field);
+
+    tc_clear_bytes(buffer);
+    return smi;
+}
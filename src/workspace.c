@@ -0,0 +1,121 @@
+#include <assert.h>
+#include <gmp.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "tc.h"
+#include "tc_internal.h"
+
+/*
+ * Per thread workspace of mpz temporaries for the algorithms. Every variable is kept allocated for the largest key
+ * seen by the thread, so once a thread has warmed up, borrowing and returning variables never allocates, and GMP
+ * doesn't need to grow them while computing.
+ *
+ * Variables are borrowed as a stack: workspace_begin returns a mark, workspace_take hands out the next variable and
+ * workspace_end returns every variable taken after the mark. Borrowed variables keep whatever value they had, so they
+ * must be set before being read.
+ */
+
+#define WORKSPACE_VARS 128
+
+struct workspace {
+    mpz_t vars[WORKSPACE_VARS];
+    int used; /* Variables currently borrowed */
+    int initialized; /* Variables initialized so far, in order */
+    mp_bitcnt_t bits; /* Capacity of each variable */
+    uint8_t *octets; /* Buffer for workspace_octets */
+    size_t octets_len;
+    mp_limb_t *limbs; /* Buffer for workspace_limbs */
+    mp_size_t limbs_count;
+    int registered;
+};
+
+static _Thread_local struct workspace ws;
+
+static pthread_key_t workspace_key;
+static pthread_once_t workspace_key_once = PTHREAD_ONCE_INIT;
+
+static void release_workspace(struct workspace *w) {
+    assert(w->used == 0);
+    for (int i = 0; i < w->initialized; i++) {
+        mpz_clear(w->vars[i]);
+    }
+    tc_free(w->octets);
+    tc_free(w->limbs);
+
+    w->initialized = 0;
+    w->bits = 0;
+    w->octets = NULL;
+    w->octets_len = 0;
+    w->limbs = NULL;
+    w->limbs_count = 0;
+}
+
+static void release_thread_workspace(void *w) {
+    release_workspace(w);
+}
+
+static void create_workspace_key(void) {
+    pthread_key_create(&workspace_key, release_thread_workspace);
+}
+
+/* The workspace of a thread is released when it exits. */
+static void register_workspace(void) {
+    pthread_once(&workspace_key_once, create_workspace_key);
+    pthread_setspecific(workspace_key, &ws);
+    ws.registered = 1;
+}
+
+int workspace_begin(mp_size_t n_limbs) {
+    if (!ws.registered) {
+        register_workspace();
+    }
+
+    /* Products of two numbers modulo n, and z = c*s_i + r, are the largest values the algorithms compute */
+    mp_bitcnt_t bits = (TC_Z_LIMBS(n_limbs) + 1) * GMP_NUMB_BITS;
+    if (bits > ws.bits) {
+        for (int i = 0; i < ws.initialized; i++) {
+            mpz_realloc2(ws.vars[i], bits);
+        }
+        ws.bits = bits;
+    }
+
+    return ws.used;
+}
+
+mpz_ptr workspace_take(void) {
+    assert(ws.used < WORKSPACE_VARS);
+    if (ws.used == ws.initialized) {
+        mpz_init2(ws.vars[ws.initialized++], ws.bits);
+    }
+    return ws.vars[ws.used++];
+}
+
+void workspace_end(int mark) {
+    assert(0 <= mark && mark <= ws.used);
+    ws.used = mark;
+}
+
+const uint8_t *workspace_octets(size_t *len, const mpz_t z) {
+    size_t size = TC_OCTETS_SIZE(z);
+    if (size > ws.octets_len) {
+        ws.octets = ralloc(ws.octets, size);
+        ws.octets_len = size;
+    }
+
+    mpz_export(ws.octets, len, 1, 1, 0, 0, z);
+    return ws.octets;
+}
+
+/* A scratch area of count limbs, valid until the next call. */
+mp_limb_t *workspace_limbs(mp_size_t count) {
+    if (count > ws.limbs_count) {
+        ws.limbs = ralloc(ws.limbs, count * sizeof(mp_limb_t));
+        ws.limbs_count = count;
+    }
+    return ws.limbs;
+}
+
+void tc_release_workspace() {
+    release_workspace(&ws);
+}
@@ -20,6 +20,21 @@ Suite * algorithms_suite(void)
     suite_add_tcase(s, tc_test_case_poly_c());
     suite_add_tcase(s, tc_test_case_serialization());
     suite_add_tcase(s, tc_test_case_base64());
+    suite_add_tcase(s, tc_test_case_memory());
+    suite_add_tcase(s, tc_test_case_pool());
+    suite_add_tcase(s, tc_test_case_workspace());
+    suite_add_tcase(s, tc_test_case_montgomery());
+    suite_add_tcase(s, tc_test_case_backend());
+    suite_add_tcase(s, tc_test_case_multibuffer());
+    suite_add_tcase(s, tc_test_case_fixed_base());
+    suite_add_tcase(s, tc_test_case_precomputation());
+    suite_add_tcase(s, tc_test_case_document_ctx());
+    suite_add_tcase(s, tc_test_case_algorithms_rsa_verify_c());
+    suite_add_tcase(s, tc_test_case_algorithms_pkcs1_encoding_c());
+    suite_add_tcase(s, tc_test_case_engine());
+    suite_add_tcase(s, tc_test_case_scheduler());
+    suite_add_tcase(s, tc_test_case_completion_queue());
+    suite_add_tcase(s, tc_test_case_shm_ring());
 
     return s;
 }
@@ -1,4 +1,8 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <gmp.h>
+#include <stdio.h>
+#include <string.h>
 #include <check.h>
 
 #include "tc.h"
@@ -37,8 +41,56 @@ START_TEST(test_lagrange_interpolation)
     mpz_clear(delta);
 }END_TEST
 
+/* Documents joined in batch, more than are inverted at once, match the ones joined one by one. */
+START_TEST(test_join_signatures_batch)
+{
+    const int count = 40, k = 3, l = 5;
+    const int signers[] = {4, 1, 3};
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, k, l, NULL);
+
+    bytes_t * docs[count], * prepared[count];
+    for (int i = 0; i < count; i++) {
+        char message[32];
+        snprintf(message, sizeof(message), "Document %d", i);
+        docs[i] = tc_init_bytes(strdup(message), strlen(message));
+        prepared[i] = tc_prepare_document(docs[i], TC_SHA256, info);
+    }
+
+    signature_share_t * signed_by[k][count];
+    const signature_share_t * rows[count * k];
+    for (int j = 0; j < k; j++) {
+        tc_node_sign_batch(signed_by[j], shares[signers[j]], (const bytes_t **) prepared, count, info);
+        for (int i = 0; i < count; i++) {
+            rows[i * k + j] = signed_by[j][i];
+        }
+    }
+
+    bytes_t * joined[count];
+    tc_join_signatures_batch(joined, rows, (const bytes_t **) prepared, count, info);
+    for (int i = 0; i < count; i++) {
+        ck_assert(tc_rsa_verify(joined[i], docs[i], info, TC_SHA256));
+        bytes_t * single = tc_join_signatures(rows + i * k, prepared[i], info);
+        ck_assert_int_eq(single->data_len, joined[i]->data_len);
+        ck_assert(memcmp(single->data, joined[i]->data, single->data_len) == 0);
+        tc_clear_bytes(single);
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < k; j++) {
+            tc_clear_signature_share(signed_by[j][i]);
+        }
+        tc_clear_bytes_n(joined[i], docs[i], prepared[i], NULL);
+    }
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}END_TEST
+
 TCase * tc_test_case_algorithms_join_signatures_c() {
     TCase * tc = tcase_create("algorithms_join_signatures.c");
+    tcase_set_timeout(tc, 60);
     tcase_add_test(tc, test_lagrange_interpolation);
+    tcase_add_test(tc, test_join_signatures_batch);
     return tc;
 }
@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <check.h>
+
+/* A document of len bytes that doesn't repeat at the size of the read buffer. */
+static bytes_t * large_document(size_t len) {
+    uint8_t * data = malloc(len);
+    uint32_t x = 1;
+    for (size_t i = 0; i < len; i++) {
+        x = x * 1103515245 + 12345;
+        data[i] = x >> 24;
+    }
+    return tc_init_bytes(data, len);
+}
+
+START_TEST(test_prepare_streaming){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+    bytes_t * doc = large_document(100003);
+    bytes_t * expected = tc_prepare_document(doc, TC_SHA256, info);
+
+    /* The same document in pieces of any size */
+    const size_t chunks[] = {1, 63, 4096, 100003};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        tc_prepare_ctx_t * ctx = tc_init_prepare(TC_SHA256, info);
+        ck_assert(ctx != NULL);
+        const uint8_t * data = doc->data;
+        for (size_t offset = 0; offset < doc->data_len; offset += chunks[i]) {
+            size_t len = doc->data_len - offset < chunks[i] ? doc->data_len - offset : chunks[i];
+            tc_prepare_update(ctx, data + offset, len);
+        }
+        bytes_t * prepared = tc_prepare_final(ctx);
+        ck_assert_int_eq(prepared->data_len, expected->data_len);
+        ck_assert(memcmp(prepared->data, expected->data, expected->data_len) == 0);
+        tc_clear_bytes(prepared);
+    }
+
+    /* And an empty one */
+    bytes_t * empty = tc_init_bytes(malloc(1), 0);
+    bytes_t * empty_expected = tc_prepare_document(empty, TC_SHA256, info);
+    bytes_t * prepared = tc_prepare_final(tc_init_prepare(TC_SHA256, info));
+    ck_assert(memcmp(prepared->data, empty_expected->data, empty_expected->data_len) == 0);
+    tc_clear_bytes(prepared);
+    tc_clear_bytes(empty_expected);
+    tc_clear_bytes(empty);
+
+    /* Without a hash the whole document is needed */
+    ck_assert(tc_init_prepare(TC_NONE, info) == NULL);
+
+    tc_clear_bytes(expected);
+    tc_clear_bytes(doc);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+START_TEST(test_prepare_file){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+
+    /* Longer than several reads */
+    bytes_t * doc = large_document((5 << 20) + 17);
+    char path[] = "/tmp/tc_prepare_XXXXXX";
+    int fd = mkstemp(path);
+    ck_assert(fd >= 0);
+    ck_assert(write(fd, doc->data, doc->data_len) == (ssize_t) doc->data_len);
+    close(fd);
+
+    bytes_t * expected = tc_prepare_document(doc, TC_SHA256, info);
+    bytes_t * prepared = tc_prepare_file(path, TC_SHA256, info);
+    ck_assert(prepared != NULL);
+    ck_assert_int_eq(prepared->data_len, expected->data_len);
+    ck_assert(memcmp(prepared->data, expected->data, expected->data_len) == 0);
+
+    /* It can be signed like the prepared document */
+    signature_share_t * signatures[2];
+    for (int i = 0; i < 2; i++) {
+        signatures[i] = tc_node_sign(shares[i], prepared, info);
+    }
+    bytes_t * rsa_signature = tc_join_signatures((const signature_share_t **) signatures, prepared, info);
+    ck_assert(tc_rsa_verify(rsa_signature, doc, info, TC_SHA256));
+
+    ck_assert(tc_prepare_file("/nonexistent/document", TC_SHA256, info) == NULL);
+    ck_assert(tc_prepare_file(path, TC_NONE, info) == NULL);
+
+    tc_clear_bytes(rsa_signature);
+    for (int i = 0; i < 2; i++) {
+        tc_clear_signature_share(signatures[i]);
+    }
+    unlink(path);
+    tc_clear_bytes(prepared);
+    tc_clear_bytes(expected);
+    tc_clear_bytes(doc);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+static void ignore_signal(int signal) {
+    (void) signal;
+}
+
+/* A file that arrives slowly through a pipe, while a timer keeps interrupting the reads */
+START_TEST(test_prepare_file_interrupted){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+    bytes_t * doc = large_document((2 << 20) + 5);
+    bytes_t * expected = tc_prepare_document(doc, TC_SHA256, info);
+
+    char dir[] = "/tmp/tc_prepare_XXXXXX";
+    ck_assert(mkdtemp(dir) != NULL);
+    char path[sizeof(dir) + 8];
+    snprintf(path, sizeof(path), "%s/fifo", dir);
+    ck_assert_int_eq(mkfifo(path, 0600), 0);
+
+    pid_t writer = fork();
+    ck_assert(writer >= 0);
+    if (writer == 0) {
+        int fd = open(path, O_WRONLY);
+        struct timespec pause = {.tv_sec = 0, .tv_nsec = 2000000};
+        for (size_t done = 0; fd >= 0 && done < doc->data_len; done += 64 << 10) {
+            size_t len = doc->data_len - done < (64 << 10) ? doc->data_len - done : (64 << 10);
+            if (write(fd, (uint8_t *) doc->data + done, len) != (ssize_t) len) {
+                _exit(1);
+            }
+            nanosleep(&pause, NULL);
+        }
+        _exit(fd >= 0 ? 0 : 1);
+    }
+
+    /* Without SA_RESTART, a read the timer interrupts fails with EINTR */
+    struct sigaction action = {.sa_handler = ignore_signal}, previous;
+    sigemptyset(&action.sa_mask);
+    ck_assert_int_eq(sigaction(SIGUSR1, &action, &previous), 0);
+    struct sigevent event = {.sigev_notify = SIGEV_SIGNAL, .sigev_signo = SIGUSR1};
+    timer_t timer;
+    ck_assert_int_eq(timer_create(CLOCK_MONOTONIC, &event, &timer), 0);
+    struct itimerspec every_ms = {.it_interval = {0, 1000000}, .it_value = {0, 1000000}};
+    timer_settime(timer, 0, &every_ms, NULL);
+    bytes_t * prepared = tc_prepare_file(path, TC_SHA256, info);
+    timer_delete(timer);
+    sigaction(SIGUSR1, &previous, NULL);
+
+    int status;
+    ck_assert(waitpid(writer, &status, 0) == writer);
+    ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ck_assert(prepared != NULL);
+    ck_assert(memcmp(prepared->data, expected->data, expected->data_len) == 0);
+
+    unlink(path);
+    rmdir(dir);
+    tc_clear_bytes(prepared);
+    tc_clear_bytes(expected);
+    tc_clear_bytes(doc);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+}
+END_TEST
+
+START_TEST(test_prepare_documents_batch){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+    size_t len = tc_public_key_n(tc_key_meta_info_public_key(info))->data_len;
+
+    const size_t count = 100;
+    bytes_t * doc = large_document(5000);
+    bytes_t docs[count];
+    const bytes_t * doc_ptrs[count];
+    for (size_t i = 0; i < count; i++) {
+        docs[i].data = (uint8_t *) doc->data + i;
+        docs[i].data_len = (i * 53) % 1000;
+        doc_ptrs[i] = &docs[i];
+    }
+
+    const tc_hash_type_t hash_types[] = {TC_SHA256, TC_NONE};
+    uint8_t * out = malloc(count * len);
+    for (size_t h = 0; h < 2; h++) {
+        /* Without a hash the documents have to fit in the padding */
+        size_t batch = hash_types[h] == TC_NONE ? 1 : count;
+        tc_prepare_documents_batch(out, doc_ptrs, batch, hash_types[h], info);
+        for (size_t i = 0; i < batch; i++) {
+            bytes_t * expected = tc_prepare_document(&docs[i], hash_types[h], info);
+            ck_assert(memcmp(out + i * len, expected->data, len) == 0);
+            tc_clear_bytes(expected);
+        }
+    }
+
+    /* The prepared documents can be signed in place */
+    bytes_t prepared = { .data = out + 7 * len, .data_len = len };
+    signature_share_t * signatures[2];
+    for (int i = 0; i < 2; i++) {
+        signatures[i] = tc_node_sign(shares[i], &prepared, info);
+    }
+    bytes_t * rsa_signature = tc_join_signatures((const signature_share_t **) signatures, &prepared, info);
+    ck_assert(tc_rsa_verify(rsa_signature, &docs[7], info, TC_SHA256));
+
+    tc_clear_bytes(rsa_signature);
+    for (int i = 0; i < 2; i++) {
+        tc_clear_signature_share(signatures[i]);
+    }
+    free(out);
+    tc_clear_bytes(doc);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+TCase *tc_test_case_algorithms_pkcs1_encoding_c() {
+    TCase *tc = tcase_create("algorithms_pkcs1_encoding.c");
+    tcase_add_test(tc, test_prepare_streaming);
+    tcase_add_test(tc, test_prepare_file);
+    tcase_add_test(tc, test_prepare_file_interrupted);
+    tcase_add_test(tc, test_prepare_documents_batch);
+    return tc;
+}
@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+/* Signs count documents with the key, the signatures and documents are returned in the arrays. */
+static void sign_documents(bytes_t ** signatures, bytes_t ** docs, int count, key_share_t ** shares,
+                           key_metainfo_t * info) {
+    for (int i = 0; i < count; i++) {
+        char message[32];
+        snprintf(message, sizeof(message), "Document %d", i);
+        docs[i] = tc_init_bytes(strdup(message), strlen(message));
+        bytes_t * prepared = tc_prepare_document(docs[i], TC_SHA256, info);
+        signature_share_t * shares_signatures[2];
+        for (int j = 0; j < 2; j++) {
+            shares_signatures[j] = tc_node_sign(shares[j], prepared, info);
+        }
+        signatures[i] = tc_join_signatures((const signature_share_t **) shares_signatures, prepared, info);
+        for (int j = 0; j < 2; j++) {
+            tc_clear_signature_share(shares_signatures[j]);
+        }
+        tc_clear_bytes(prepared);
+    }
+}
+
+/* The context verifies like tc_rsa_verify, for valid and forged signatures. */
+static void check_key(bytes_t * e) {
+    const int count = 6;
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, e);
+    tc_public_key_ctx_t * ctx = tc_init_public_key_ctx(tc_key_meta_info_public_key(info));
+    ck_assert(ctx != NULL);
+
+    bytes_t * signatures[count], * docs[count];
+    sign_documents(signatures, docs, count, shares, info);
+
+    /* A flipped bit, the signature of another document, n itself and a signature longer than n */
+    ((uint8_t *) signatures[1]->data)[signatures[1]->data_len / 2] ^= 0x10;
+    bytes_t * swapped = signatures[2];
+    signatures[2] = signatures[3];
+    signatures[3] = swapped;
+    const bytes_t * n = tc_public_key_n(tc_key_meta_info_public_key(info));
+    tc_clear_bytes(signatures[4]);
+    signatures[4] = tc_init_bytes_copy(n->data, n->data_len);
+    uint8_t * longer = malloc(signatures[5]->data_len + 1);
+    longer[0] = 1;
+    memcpy(longer + 1, signatures[5]->data, signatures[5]->data_len);
+    bytes_t * valid = signatures[5];
+    signatures[5] = tc_init_bytes(longer, valid->data_len + 1);
+
+    int results[count];
+    tc_rsa_verify_batch(results, ctx, (const bytes_t **) signatures, (const bytes_t **) docs, count, TC_SHA256);
+    const int expected[] = {1, 0, 0, 0, 0, 0};
+    for (int i = 0; i < count; i++) {
+        ck_assert_int_eq(results[i], expected[i]);
+        ck_assert_int_eq(tc_rsa_verify(signatures[i], docs[i], info, TC_SHA256), expected[i]);
+
+        bytes_t * prepared = tc_prepare_document(docs[i], TC_SHA256, info);
+        ck_assert_int_eq(tc_rsa_verify_prepared(ctx, signatures[i], prepared), expected[i]);
+        tc_clear_bytes(prepared);
+    }
+
+    /* Leading zeros don't change the signature */
+    uint8_t * padded = calloc(valid->data_len + 3, 1);
+    memcpy(padded + 3, valid->data, valid->data_len);
+    bytes_t * zeros = tc_init_bytes(padded, valid->data_len + 3);
+    bytes_t * prepared = tc_prepare_document(docs[5], TC_SHA256, info);
+    ck_assert(tc_rsa_verify_prepared(ctx, zeros, prepared));
+    ck_assert(tc_rsa_verify_prepared(ctx, valid, prepared));
+
+    tc_clear_bytes_n(zeros, prepared, valid, NULL);
+    for (int i = 0; i < count; i++) {
+        tc_clear_bytes_n(signatures[i], docs[i], NULL);
+    }
+    tc_clear_public_key_ctx(ctx);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+}
+
+START_TEST(test_rsa_verify_ctx){
+    /* 65537, and an exponent longer than a word */
+    check_key(NULL);
+    uint8_t e[] = {0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    bytes_t * long_e = tc_init_bytes_copy(e, sizeof(e));
+    check_key(long_e);
+    tc_clear_bytes(long_e);
+    tc_release_workspace();
+}
+END_TEST
+
+START_TEST(test_rsa_verify_even_modulus){
+    uint8_t n[] = {0xc3, 0x51, 0x02, 0x10}, e[] = {0x03};
+    public_key_t pk = {.n = {.data = n, .data_len = sizeof(n)}, .e = {.data = e, .data_len = sizeof(e)}};
+    ck_assert(tc_init_public_key_ctx(&pk) == NULL);
+}
+END_TEST
+
+TCase *tc_test_case_algorithms_rsa_verify_c() {
+    TCase *tc = tcase_create("algorithms_rsa_verify.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_rsa_verify_ctx);
+    tcase_add_test(tc, test_rsa_verify_even_modulus);
+    return tc;
+}
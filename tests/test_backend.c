@@ -0,0 +1,134 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <string.h>
+#include <check.h>
+
+/* The library can be built without the OpenSSL backend, in which case only its absence is checked. */
+static int openssl_available() {
+    int available = tc_set_backend(TC_BACKEND_OPENSSL) == 0;
+    tc_set_backend(TC_BACKEND_GMP);
+    return available;
+}
+
+START_TEST(test_backend_selection){
+    ck_assert(tc_set_backend(TC_BACKEND_GMP) == 0);
+    ck_assert(tc_get_backend() == TC_BACKEND_GMP);
+
+    if (openssl_available()) {
+        ck_assert(tc_set_backend(TC_BACKEND_OPENSSL) == 0);
+        ck_assert(tc_get_backend() == TC_BACKEND_OPENSSL);
+    } else {
+        ck_assert(tc_set_backend(TC_BACKEND_OPENSSL) == -1);
+        ck_assert(tc_get_backend() == TC_BACKEND_GMP);
+    }
+    tc_set_backend(TC_BACKEND_GMP);
+}
+END_TEST
+
+START_TEST(test_backend_powm_equality){
+    if (!openssl_available()) {
+        return;
+    }
+
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, 7);
+
+    mpz_t n, b, e, r_gmp, r_openssl;
+    mpz_inits(n, b, e, r_gmp, r_openssl, NULL);
+
+    const int sizes[] = {512, 2048};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        mpz_urandomb(n, state, sizes[i]);
+        mpz_setbit(n, sizes[i] - 1);
+        mpz_setbit(n, 0);
+
+        key_metainfo_t * info = tc_init_key_metainfo(1, 1, mpz_size(n), 1);
+        TC_MPZ_TO_LIMBS(info->params.n, info->params.n_limbs, n);
+        info->params.e[0] = 65537;
+        tc_set_public_key(&info->params);
+
+        for (int j = 0; j < 10; j++) {
+            mpz_urandomb(b, state, sizes[i] + 20);
+            mpz_urandomb(e, state, sizes[i]);
+            if (j % 2) {
+                mpz_neg(b, b);
+            }
+
+            tc_set_backend(TC_BACKEND_GMP);
+            backend_powm(r_gmp, b, e, &info->params);
+            tc_set_backend(TC_BACKEND_OPENSSL);
+            backend_powm(r_openssl, b, e, &info->params);
+            ck_assert(mpz_cmp(r_gmp, r_openssl) == 0);
+        }
+
+        tc_set_backend(TC_BACKEND_GMP);
+        tc_clear_key_metainfo(info);
+    }
+
+    mpz_clears(n, b, e, r_gmp, r_openssl, NULL);
+    gmp_randclear(state);
+}
+END_TEST
+
+/* Keys generated with one backend, shares signed with the other, and both joins give the same RSA signature. */
+START_TEST(test_backend_cross_signatures){
+    if (!openssl_available()) {
+        return;
+    }
+
+    const int k = 3, l = 5;
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes_copy((void *) message, strlen(message));
+
+    for (int keygen = 0; keygen < 2; keygen++) {
+        tc_backend_t keygen_backend = keygen ? TC_BACKEND_OPENSSL : TC_BACKEND_GMP;
+        tc_backend_t other_backend = keygen ? TC_BACKEND_GMP : TC_BACKEND_OPENSSL;
+
+        tc_set_backend(keygen_backend);
+        key_metainfo_t * info;
+        key_share_t ** shares = tc_generate_keys(&info, 512, k, l, NULL);
+        bytes_t * doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+        signature_share_t * signatures[k];
+        for (int i = 0; i < k; i++) {
+            tc_set_backend(i % 2 ? keygen_backend : other_backend);
+            signatures[i] = tc_node_sign(shares[i], doc_pkcs1, info);
+            tc_set_backend(i % 2 ? other_backend : keygen_backend);
+            ck_assert(tc_verify_signature(signatures[i], doc_pkcs1, info));
+        }
+
+        tc_set_backend(TC_BACKEND_GMP);
+        bytes_t * gmp_signature = tc_join_signatures((void *) signatures, doc_pkcs1, info);
+        tc_set_backend(TC_BACKEND_OPENSSL);
+        bytes_t * openssl_signature = tc_join_signatures((void *) signatures, doc_pkcs1, info);
+        ck_assert(tc_rsa_verify(gmp_signature, doc, info, TC_SHA256));
+
+        ck_assert_int_eq(gmp_signature->data_len, openssl_signature->data_len);
+        ck_assert(memcmp(gmp_signature->data, openssl_signature->data, gmp_signature->data_len) == 0);
+
+        tc_set_backend(TC_BACKEND_GMP);
+        tc_clear_bytes_n(gmp_signature, openssl_signature, doc_pkcs1, NULL);
+        for (int i = 0; i < k; i++) {
+            tc_clear_signature_share(signatures[i]);
+        }
+        tc_clear_key_shares(shares, info);
+        tc_clear_key_metainfo(info);
+    }
+
+    tc_clear_bytes(doc);
+}
+END_TEST
+
+TCase *tc_test_case_backend() {
+    TCase *tc = tcase_create("backend.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_backend_selection);
+    tcase_add_test(tc, test_backend_powm_equality);
+    tcase_add_test(tc, test_backend_cross_signatures);
+    return tc;
+}
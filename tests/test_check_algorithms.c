@@ -81,6 +81,76 @@ static void complete_sign(int threshold, int nodes, size_t key_size, int expecte
     tc_clear_bytes(doc_pkcs1);
 }
 
+START_TEST(test_complete_sign_slim){
+    const int threshold = 3, nodes = 5;
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, threshold, nodes, NULL);
+
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+    bytes_t * doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+    signature_share_t * signatures[nodes];
+    for (int i=0; i<nodes; i++) {
+        /* Each node only gets its own verification key */
+        signer_metainfo_t * extracted = tc_extract_signer_metainfo(info, tc_key_share_id(shares[i]));
+        char * serialized = tc_serialize_signer_metainfo(extracted);
+        tc_clear_signer_metainfo(extracted);
+
+        signer_metainfo_t * smi = tc_deserialize_signer_metainfo(serialized);
+        ck_assert_int_eq(tc_signer_metainfo_id(smi), tc_key_share_id(shares[i]));
+
+        signatures[i] = tc_node_sign_slim(shares[i], doc_pkcs1, smi);
+        ck_assert_msg(tc_verify_signature(signatures[i], doc_pkcs1, info), "Slim signature share verification.");
+
+        tc_clear_signer_metainfo(smi);
+        free(serialized);
+    }
+
+    bytes_t * rsa_signature = tc_join_signatures((void*) signatures, doc_pkcs1, info);
+    ck_assert_msg(tc_rsa_verify(rsa_signature, doc, info, TC_SHA256), "RSA Signature verification.");
+
+    tc_clear_bytes(rsa_signature);
+    for(int i=0; i<nodes; i++) {
+        tc_clear_signature_share(signatures[i]);
+    }
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+}
+END_TEST
+
+START_TEST(test_complete_sign_multi){
+    const int threshold = 10, nodes = 18;
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, threshold, nodes, NULL);
+
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+    bytes_t * doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+    /* One node holds every share but the first one, more than it signs at once */
+    signature_share_t * signatures[nodes];
+    signatures[0] = tc_node_sign(shares[0], doc_pkcs1, info);
+    tc_node_sign_multi(signatures + 1, (const key_share_t **) shares + 1, nodes - 1, doc_pkcs1, info);
+    for (int i=0; i<nodes; i++) {
+        ck_assert_int_eq(signatures[i]->id, tc_key_share_id(shares[i]));
+        ck_assert_msg(tc_verify_signature(signatures[i], doc_pkcs1, info), "Multi signature share verification.");
+    }
+
+    bytes_t * rsa_signature = tc_join_signatures((void*) (signatures + nodes - threshold), doc_pkcs1, info);
+    ck_assert_msg(tc_rsa_verify(rsa_signature, doc, info, TC_SHA256), "RSA Signature verification.");
+
+    tc_clear_bytes(rsa_signature);
+    for(int i=0; i<nodes; i++) {
+        tc_clear_signature_share(signatures[i]);
+    }
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+}
+END_TEST
+
 START_TEST(test_complete_sign_1_1){
     complete_sign(1, 1, 512, 0);
 }
@@ -94,6 +164,47 @@ START_TEST(test_complete_sign){
 }
 END_TEST
 
+/* A share wider than the key, or with numbers that aren't of a share, is refused, not read past its end */
+START_TEST(test_verify_foreign_share){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 3, 5, NULL);
+    key_metainfo_t * other;
+    key_share_t ** other_shares = tc_generate_keys(&other, 1024, 3, 5, NULL);
+
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+    bytes_t * doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+    /* Version 1, id 1 and three empty numbers, then x_i = 0 and c = 1 */
+    signature_share_t * empty = tc_deserialize_signature_share("AAEAAQAAAAAAAAAAAAAAAA==");
+    ck_assert(empty != NULL);
+    ck_assert(!tc_verify_signature(empty, doc_pkcs1, info));
+    signature_share_t * zero = tc_deserialize_signature_share("AAEAAQAAAAAAAAABAQAAAAA=");
+    ck_assert(zero != NULL);
+    ck_assert(!tc_verify_signature(zero, doc_pkcs1, info));
+    tc_clear_signature_share(zero);
+
+    /* A share of a longer key */
+    signature_share_t * longer = tc_node_sign(other_shares[0], doc_pkcs1, other);
+    ck_assert(!tc_verify_signature(longer, doc_pkcs1, info));
+
+    const signature_share_t * signatures[] = {empty, longer, tc_node_sign(shares[0], doc_pkcs1, info)};
+    const bytes_t * docs[] = {doc_pkcs1, doc_pkcs1, doc_pkcs1};
+    int results[3];
+    tc_verify_signature_batch(results, signatures, docs, 3, info);
+    ck_assert(!results[0] && !results[1] && results[2]);
+
+    tc_clear_signature_share((signature_share_t *) signatures[2]);
+    tc_clear_signature_share(longer);
+    tc_clear_signature_share(empty);
+    tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+    tc_clear_key_shares(other_shares, other);
+    tc_clear_key_metainfo(other);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+}
+END_TEST
+
 START_TEST(test_endianess){
     /* Test that output is Big Endian */
     uint8_t data[] = { 1, 0, 0 };
@@ -121,6 +232,9 @@ TCase *tc_test_case_system_test() {
     tcase_set_timeout(tc, 500);
     tcase_add_test(tc, test_complete_sign_1_1);
     tcase_add_test(tc, test_complete_sign);
+    tcase_add_test(tc, test_complete_sign_slim);
+    tcase_add_test(tc, test_complete_sign_multi);
+    tcase_add_test(tc, test_verify_foreign_share);
     tcase_add_test(tc, test_endianess);
     return tc;
 }
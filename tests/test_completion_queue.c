@@ -0,0 +1,154 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "unit_test.h"
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#define DOCUMENTS 6
+
+/* Takes the completions of the queue as an event loop would, waiting for its eventfd. */
+static size_t wait_completions(tc_completion_queue_t * cq, tc_completion_t * out, size_t max) {
+    struct pollfd fd = {.fd = tc_completion_queue_fd(cq), .events = POLLIN};
+    for (;;) {
+        ck_assert(poll(&fd, 1, 30000) == 1);
+        size_t polled = tc_poll_completions(cq, out, max);
+        if (polled > 0) {
+            return polled;
+        }
+    }
+}
+
+/* Each document is signed by three nodes, the shares verified and joined, all through one completion queue. */
+START_TEST(test_completion_queue_pipeline){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 3, 5, NULL);
+    tc_engine_t * engine = tc_init_engine(3, 64, 0);
+    tc_completion_queue_t * cq = tc_init_completion_queue(64);
+    ck_assert(cq != NULL);
+
+    bytes_t * docs[DOCUMENTS];
+    signature_share_t * signatures[DOCUMENTS][3];
+    int signed_count[DOCUMENTS] = {0}, verified_count[DOCUMENTS] = {0}, joined = 0;
+    for (int i = 0; i < DOCUMENTS; i++) {
+        char message[32];
+        snprintf(message, sizeof(message), "Document %d", i);
+        bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+        docs[i] = tc_prepare_document(doc, TC_SHA256, info);
+        tc_clear_bytes(doc);
+        for (int j = 0; j < 3; j++) {
+            void * tag = (void *) (intptr_t) (i * 3 + j);
+            ck_assert_int_eq(tc_submit_sign(engine, cq, shares[j], docs[i], info, tag), 0);
+        }
+    }
+
+    /* Verifications are tagged past the signatures, joins past the verifications */
+    int pending = DOCUMENTS * 3;
+    while (pending > 0) {
+        tc_completion_t completions[4];
+        size_t polled = wait_completions(cq, completions, 4);
+        for (size_t c = 0; c < polled; c++) {
+            intptr_t tag = (intptr_t) completions[c].user_data;
+            tc_future_t * future = completions[c].future;
+            pending--;
+            if (tag < DOCUMENTS * 3) {
+                int i = tag / 3, j = tag % 3;
+                signatures[i][j] = tc_future_signature_share(future);
+                signed_count[i]++;
+                ck_assert_int_eq(tc_submit_verify(engine, cq, signatures[i][j], docs[i], info,
+                                                  (void *) (intptr_t) (DOCUMENTS * 3 + i)), 0);
+                pending++;
+            } else if (tag < DOCUMENTS * 4) {
+                int i = tag - DOCUMENTS * 3;
+                ck_assert(tc_future_verified(future));
+                if (++verified_count[i] == 3) {
+                    ck_assert_int_eq(tc_submit_join(engine, cq, (const signature_share_t **) signatures[i], docs[i],
+                                                    info, (void *) (intptr_t) (DOCUMENTS * 4 + i)), 0);
+                    pending++;
+                }
+            } else {
+                bytes_t * rsa_signature = tc_future_signature(future);
+                ck_assert(rsa_signature != NULL);
+                tc_clear_bytes(rsa_signature);
+                joined++;
+            }
+            tc_clear_future(future);
+        }
+    }
+    ck_assert_int_eq(joined, DOCUMENTS);
+
+    /* Nothing is left, and once polled empty the eventfd is quiet */
+    tc_completion_t none[1];
+    ck_assert(tc_poll_completions(cq, none, 1) == 0);
+    struct pollfd fd = {.fd = tc_completion_queue_fd(cq), .events = POLLIN};
+    ck_assert_int_eq(poll(&fd, 1, 0), 0);
+
+    tc_clear_engine(engine);
+    tc_clear_completion_queue(cq);
+    for (int i = 0; i < DOCUMENTS; i++) {
+        ck_assert_int_eq(signed_count[i], 3);
+        for (int j = 0; j < 3; j++) {
+            tc_clear_signature_share(signatures[i][j]);
+        }
+        tc_clear_bytes(docs[i]);
+    }
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+/* Operations that couldn't be delivered are refused when submitted. */
+START_TEST(test_completion_queue_full){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+    bytes_t * prepared = tc_prepare_document(doc, TC_SHA256, info);
+    tc_engine_t * engine = tc_init_engine(1, 16, 0);
+    tc_completion_queue_t * cq = tc_init_completion_queue(2);
+
+    ck_assert_int_eq(tc_submit_sign(engine, cq, shares[0], prepared, info, NULL), 0);
+    ck_assert_int_eq(tc_submit_sign(engine, cq, shares[1], prepared, info, NULL), 0);
+    ck_assert_int_eq(tc_submit_sign(engine, cq, shares[2], prepared, info, NULL), -1);
+
+    /* A poll limited to one leaves the eventfd readable for the other */
+    tc_completion_t completions[2];
+    size_t polled = 0;
+    while (polled < 2) {
+        polled += wait_completions(cq, completions + polled, 1);
+    }
+    for (int c = 0; c < 2; c++) {
+        signature_share_t * signature = tc_future_signature_share(completions[c].future);
+        ck_assert(tc_verify_signature(signature, prepared, info));
+        tc_clear_signature_share(signature);
+        tc_clear_future(completions[c].future);
+    }
+    ck_assert_int_eq(tc_submit_sign(engine, cq, shares[2], prepared, info, NULL), 0);
+    polled = wait_completions(cq, completions, 2);
+    ck_assert(polled == 1);
+    tc_clear_signature_share(tc_future_signature_share(completions[0].future));
+    tc_clear_future(completions[0].future);
+
+    tc_clear_engine(engine);
+    tc_clear_completion_queue(cq);
+    tc_clear_bytes(prepared);
+    tc_clear_bytes(doc);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+TCase *tc_test_case_completion_queue() {
+    TCase *tc = tcase_create("completion_queue.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_completion_queue_pipeline);
+    tcase_add_test(tc, test_completion_queue_full);
+    return tc;
+}
@@ -0,0 +1,97 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+
+/* Signs, verifies and joins a document through its context, and checks it against the bytes versions. */
+static int check_document(const char * message, key_share_t ** shares, key_metainfo_t * info) {
+    bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+    bytes_t * prepared = tc_prepare_document(doc, TC_SHA256, info);
+    tc_document_ctx_t * ctx = tc_init_document_ctx(prepared, info);
+
+    signature_share_t * signatures[3];
+    for (int i = 0; i < 3; i++) {
+        signatures[i] = tc_node_sign_ctx(shares[i], ctx, info);
+        ck_assert(tc_verify_signature_ctx(signatures[i], ctx, info));
+        ck_assert(tc_verify_signature(signatures[i], prepared, info));
+    }
+
+    /* Shares signed from the bytes verify against the context */
+    signature_share_t * from_bytes = tc_node_sign(shares[1], prepared, info);
+    ck_assert(tc_verify_signature_ctx(from_bytes, ctx, info));
+
+    bytes_t * rsa_signature = tc_join_signatures_ctx((const signature_share_t **) signatures, ctx, info);
+    ck_assert(tc_rsa_verify(rsa_signature, doc, info, TC_SHA256));
+    bytes_t * joined = tc_join_signatures((const signature_share_t **) signatures, prepared, info);
+    ck_assert_int_eq(joined->data_len, rsa_signature->data_len);
+    ck_assert(memcmp(joined->data, rsa_signature->data, joined->data_len) == 0);
+
+    int corrected = ctx->corrected;
+    tc_clear_bytes(joined);
+    tc_clear_bytes(rsa_signature);
+    tc_clear_signature_share(from_bytes);
+    for (int i = 0; i < 3; i++) {
+        tc_clear_signature_share(signatures[i]);
+    }
+    tc_clear_document_ctx(ctx);
+    tc_clear_bytes(prepared);
+    tc_clear_bytes(doc);
+    return corrected;
+}
+
+START_TEST(test_document_ctx_sign_verify_join){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+
+    /* Documents until both Jacobi symbols were seen */
+    int seen[2] = {0, 0};
+    char message[32];
+    for (int i = 0; i < 64 && !(seen[0] && seen[1]); i++) {
+        snprintf(message, sizeof message, "Document %d", i);
+        seen[check_document(message, shares, info)] = 1;
+    }
+    ck_assert(seen[0] && seen[1]);
+
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+/* A context of another document doesn't verify the signature. */
+START_TEST(test_document_ctx_other_document){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+    bytes_t * doc = tc_init_bytes(strdup("Hello"), 5);
+    bytes_t * other = tc_init_bytes(strdup("World"), 5);
+    tc_document_ctx_t * ctx = tc_init_document_ctx(doc, info);
+    tc_document_ctx_t * other_ctx = tc_init_document_ctx(other, info);
+
+    signature_share_t * signature = tc_node_sign_ctx(shares[0], ctx, info);
+    ck_assert(tc_verify_signature_ctx(signature, ctx, info));
+    ck_assert(!tc_verify_signature_ctx(signature, other_ctx, info));
+    ck_assert(!tc_verify_signature(signature, other, info));
+
+    tc_clear_signature_share(signature);
+    tc_clear_document_ctx(other_ctx);
+    tc_clear_document_ctx(ctx);
+    tc_clear_bytes(other);
+    tc_clear_bytes(doc);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+TCase *tc_test_case_document_ctx() {
+    TCase *tc = tcase_create("algorithms_document_ctx.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_document_ctx_sign_verify_join);
+    tcase_add_test(tc, test_document_ctx_other_document);
+    return tc;
+}
@@ -0,0 +1,204 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "unit_test.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#define DOCUMENTS 12
+#define PRODUCERS 4
+
+struct producer {
+    tc_engine_t * engine;
+    key_share_t ** shares;
+    key_metainfo_t * info;
+    bytes_t * docs[DOCUMENTS];
+    signature_share_t * signatures[DOCUMENTS][3];
+};
+
+/* Signs the documents with the first three shares, submitting while the other producers do. */
+static void * produce(void * arg) {
+    struct producer * p = arg;
+    tc_future_t * futures[DOCUMENTS][3];
+    for (int i = 0; i < DOCUMENTS; i++) {
+        for (int j = 0; j < 3; j++) {
+            while ((futures[i][j] = tc_engine_sign(p->engine, p->shares[j], p->docs[i], p->info)) == NULL) {
+                sched_yield();
+            }
+        }
+    }
+    for (int i = 0; i < DOCUMENTS; i++) {
+        for (int j = 0; j < 3; j++) {
+            p->signatures[i][j] = tc_future_signature_share(futures[i][j]);
+            tc_clear_future(futures[i][j]);
+        }
+    }
+    tc_release_workspace();
+    return NULL;
+}
+
+/* Producers share a new key, so its tables are built while the workers race for them. */
+START_TEST(test_engine_concurrent){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 3, 5, NULL);
+    tc_engine_t * engine = tc_init_engine(4, 16, 1);
+
+    struct producer producers[PRODUCERS];
+    pthread_t threads[PRODUCERS];
+    for (int t = 0; t < PRODUCERS; t++) {
+        producers[t].engine = engine;
+        producers[t].shares = shares;
+        producers[t].info = info;
+        for (int i = 0; i < DOCUMENTS; i++) {
+            char message[32];
+            snprintf(message, sizeof(message), "Document %d of %d", i, t);
+            bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+            producers[t].docs[i] = tc_prepare_document(doc, TC_SHA256, info);
+            tc_clear_bytes(doc);
+        }
+        ck_assert_int_eq(pthread_create(&threads[t], NULL, produce, &producers[t]), 0);
+    }
+
+    for (int t = 0; t < PRODUCERS; t++) {
+        pthread_join(threads[t], NULL);
+        struct producer * p = &producers[t];
+        for (int i = 0; i < DOCUMENTS; i++) {
+            tc_future_t * verified[3];
+            /* The other producers may still be filling the queue */
+            for (int j = 0; j < 3; j++) {
+                while ((verified[j] = tc_engine_verify(engine, p->signatures[i][j], p->docs[i], info)) == NULL) {
+                    sched_yield();
+                }
+            }
+            for (int j = 0; j < 3; j++) {
+                ck_assert(tc_future_verified(verified[j]));
+                tc_clear_future(verified[j]);
+            }
+
+            tc_future_t * joined;
+            while ((joined = tc_engine_join(engine, (const signature_share_t **) p->signatures[i], p->docs[i],
+                                            info)) == NULL) {
+                sched_yield();
+            }
+            bytes_t * signature = tc_future_signature(joined);
+            ck_assert(tc_future_poll(joined));
+            tc_clear_future(joined);
+
+            tc_public_key_ctx_t * pk = tc_init_public_key_ctx(tc_key_meta_info_public_key(info));
+            ck_assert(tc_rsa_verify_prepared(pk, signature, p->docs[i]));
+            tc_clear_public_key_ctx(pk);
+
+            tc_clear_bytes(signature);
+            for (int j = 0; j < 3; j++) {
+                tc_clear_signature_share(p->signatures[i][j]);
+            }
+            tc_clear_bytes(p->docs[i]);
+        }
+    }
+
+    tc_clear_engine(engine);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+/* A full queue rejects submissions, and stopping the engine finishes the queued ones. */
+START_TEST(test_engine_full){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 1024, 2, 3, NULL);
+    bytes_t * doc = tc_init_bytes(strdup("Hello"), 5);
+    bytes_t * prepared = tc_prepare_document(doc, TC_SHA256, info);
+    tc_engine_t * engine = tc_init_engine(1, 2, 0);
+
+    tc_future_t * futures[64];
+    int accepted = 0, rejected = 0;
+    for (int i = 0; i < 64; i++) {
+        tc_future_t * future = tc_engine_sign(engine, shares[0], prepared, info);
+        if (future == NULL) {
+            rejected++;
+        } else {
+            futures[accepted++] = future;
+        }
+    }
+    ck_assert(rejected > 0);
+
+    tc_clear_engine(engine);
+    for (int i = 0; i < accepted; i++) {
+        ck_assert(tc_future_poll(futures[i]));
+        signature_share_t * signature = tc_future_signature_share(futures[i]);
+        ck_assert(tc_verify_signature(signature, prepared, info));
+        tc_clear_signature_share(signature);
+        tc_clear_future(futures[i]);
+    }
+
+    tc_clear_bytes_n(doc, prepared, NULL);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+/* A combine with a share of another document is refused, whether the workers or the caller verify it. */
+START_TEST(test_engine_combine){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 5, 7, NULL);
+    bytes_t * doc = tc_init_bytes(strdup("Hello"), 5);
+    bytes_t * other = tc_init_bytes(strdup("Bye"), 3);
+    bytes_t * prepared = tc_prepare_document(doc, TC_SHA256, info);
+    bytes_t * other_prepared = tc_prepare_document(other, TC_SHA256, info);
+
+    signature_share_t * signatures[5];
+    for (int j = 0; j < 5; j++) {
+        signatures[j] = tc_node_sign(shares[j + 2], prepared, info);
+    }
+    signature_share_t * wrong = tc_node_sign(shares[4], other_prepared, info);
+
+    /* The second engine can only queue two of the five verifications */
+    size_t queue_sizes[] = {16, 2};
+    for (int e = 0; e < 2; e++) {
+        tc_engine_t * engine = tc_init_engine(4, queue_sizes[e], 0);
+        int valid[5];
+        bytes_t * rsa_signature = tc_engine_combine(engine, (const signature_share_t **) signatures, prepared, info,
+                                                    valid);
+        ck_assert(rsa_signature != NULL);
+        ck_assert(tc_rsa_verify(rsa_signature, doc, info, TC_SHA256));
+        for (int j = 0; j < 5; j++) {
+            ck_assert(valid[j]);
+        }
+        tc_clear_bytes(rsa_signature);
+
+        signature_share_t * right = signatures[2];
+        signatures[2] = wrong;
+        ck_assert(tc_engine_combine(engine, (const signature_share_t **) signatures, prepared, info, valid) == NULL);
+        for (int j = 0; j < 5; j++) {
+            ck_assert_int_eq(valid[j], j != 2);
+        }
+        signatures[2] = right;
+        tc_clear_engine(engine);
+    }
+
+    tc_clear_signature_share(wrong);
+    for (int j = 0; j < 5; j++) {
+        tc_clear_signature_share(signatures[j]);
+    }
+    tc_clear_bytes_n(doc, other, prepared, other_prepared, NULL);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+TCase *tc_test_case_engine() {
+    TCase *tc = tcase_create("engine.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_engine_concurrent);
+    tcase_add_test(tc, test_engine_full);
+    tcase_add_test(tc, test_engine_combine);
+    return tc;
+}
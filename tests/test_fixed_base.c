@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <string.h>
+#include <check.h>
+
+/* A key with random n, v and vk_i, enough for the fixed-base tables. */
+static key_metainfo_t * random_key(gmp_randstate_t state, int bits, uint16_t l) {
+    mpz_t n, x;
+    mpz_inits(n, x, NULL);
+    mpz_urandomb(n, state, bits);
+    mpz_setbit(n, bits - 1);
+    mpz_setbit(n, 0);
+
+    key_metainfo_t * info = tc_init_key_metainfo(l, l, mpz_size(n), 1);
+    mp_size_t n_limbs = info->params.n_limbs;
+    TC_MPZ_TO_LIMBS(info->params.n, n_limbs, n);
+    info->params.e[0] = 65537;
+    tc_set_public_key(&info->params);
+
+    mpz_urandomm(x, state, n);
+    TC_MPZ_TO_LIMBS(info->params.vk_v, n_limbs, x);
+    for (int i = 1; i <= l; i++) {
+        mpz_t gcd;
+        mpz_init(gcd);
+        do {
+            mpz_urandomm(x, state, n);
+            mpz_gcd(gcd, x, n);
+        } while (mpz_cmp_ui(gcd, 1) != 0);
+        mpz_clear(gcd);
+        TC_MPZ_TO_LIMBS(TC_VK_I(info, i), n_limbs, x);
+    }
+
+    mpz_clears(n, x, NULL);
+    return info;
+}
+
+/* Checks the powers of v and of every vk_i^-1 against mpz_powm, with the tables that fit budget. */
+static void check_tables(gmp_randstate_t state, int bits, size_t budget) {
+    const uint16_t l = 3;
+    tc_set_fixed_base_budget(budget);
+    key_metainfo_t * info = random_key(state, bits, l);
+    const struct key_params * params = &info->params;
+
+    mpz_t n, v, vk_i, e, expected, result;
+    mpz_inits(e, expected, result, NULL);
+    TC_LIMBS_VIEW(n, params->n, params->n_limbs);
+    TC_LIMBS_VIEW(v, params->vk_v, params->n_limbs);
+
+    const struct fixed_base * v_table = fixed_base_v(params);
+    ck_assert(v_table != NULL);
+    ck_assert(fixed_base_v(params) == v_table);
+
+    const int exponent_bits[] = {1, 2, 63, 64, 300, bits, bits + 2 * 32 * 8 + 1};
+    for (size_t i = 0; i < sizeof(exponent_bits) / sizeof(exponent_bits[0]); i++) {
+        mpz_urandomb(e, state, exponent_bits[i]);
+        mpz_setbit(e, exponent_bits[i] - 1);
+        mpz_powm(expected, v, e, n);
+        ck_assert(fixed_base_powm(result, e, v_table, params));
+        ck_assert(mpz_cmp(result, expected) == 0);
+
+        /* The result may be the exponent */
+        ck_assert(fixed_base_powm(e, e, v_table, params));
+        ck_assert(mpz_cmp(e, expected) == 0);
+    }
+
+    /* Exponents the table doesn't cover are left to the caller */
+    mpz_set_ui(e, 0);
+    ck_assert(fixed_base_powm(result, e, v_table, params));
+    ck_assert(mpz_cmp_ui(result, 1) == 0);
+    mpz_set_si(e, -5);
+    ck_assert(!fixed_base_powm(result, e, v_table, params));
+    mpz_set_ui(e, 0);
+    mpz_setbit(e, bits + 2 * 32 * 8 + 1);
+    ck_assert(!fixed_base_powm(result, e, v_table, params));
+
+    for (uint16_t id = 1; id <= l; id++) {
+        const struct fixed_base * table = fixed_base_vk_inverse(info, id);
+        ck_assert(table != NULL);
+        TC_LIMBS_VIEW(vk_i, TC_VK_I(info, id), params->n_limbs);
+        mpz_urandomb(e, state, 32 * 8);
+        ck_assert(fixed_base_powm(result, e, table, params));
+        mpz_neg(e, e);
+        mpz_powm(expected, vk_i, e, n);
+        ck_assert(mpz_cmp(result, expected) == 0);
+    }
+
+    tc_clear_key_metainfo(info);
+    mpz_clears(e, expected, result, NULL);
+}
+
+START_TEST(test_fixed_base_powm){
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, 5);
+
+    /* Budgets from the smallest comb to the largest shapes */
+    const int sizes[] = {128, 521, 1024, 2048};
+    const size_t budgets[] = {16 << 10, 1 << 20, 8 << 20};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (size_t j = 0; j < sizeof(budgets) / sizeof(budgets[0]); j++) {
+            check_tables(state, sizes[i], budgets[j]);
+        }
+    }
+    tc_set_fixed_base_budget(1 << 20);
+
+    gmp_randclear(state);
+    tc_release_workspace();
+}
+END_TEST
+
+/* Without budget there are no tables, and the algorithms don't need them. */
+START_TEST(test_fixed_base_disabled){
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, 6);
+
+    tc_set_fixed_base_budget(0);
+    key_metainfo_t * info = random_key(state, 512, 3);
+    ck_assert(fixed_base_v(&info->params) == NULL);
+    ck_assert(fixed_base_vk_inverse(info, 2) == NULL);
+    tc_clear_key_metainfo(info);
+
+    key_metainfo_t * key;
+    key_share_t ** shares = tc_generate_keys(&key, 512, 2, 3, NULL);
+    bytes_t * doc = tc_init_bytes(strdup("Hello"), 5);
+    signature_share_t * signature = tc_node_sign(shares[0], doc, key);
+    ck_assert(tc_verify_signature(signature, doc, key));
+
+    /* The budget only applies to keys that haven't tried to build their tables yet */
+    tc_set_fixed_base_budget(1 << 20);
+    ck_assert(fixed_base_v(&key->params) == NULL);
+    ck_assert(fixed_base_vk_inverse(key, 1) == NULL);
+    ck_assert(fixed_base_vk_inverse(key, 3) != NULL);
+    ck_assert(tc_verify_signature(signature, doc, key));
+
+    tc_clear_signature_share(signature);
+    tc_clear_bytes(doc);
+    tc_clear_key_shares(shares, key);
+    tc_clear_key_metainfo(key);
+    gmp_randclear(state);
+    tc_release_workspace();
+}
+END_TEST
+
+TCase *tc_test_case_fixed_base() {
+    TCase *tc = tcase_create("fixed_base.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_fixed_base_powm);
+    tcase_add_test(tc, test_fixed_base_disabled);
+    return tc;
+}
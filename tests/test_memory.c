@@ -0,0 +1,87 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "unit_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+struct alloc_counter {
+    long allocs;
+    long frees;
+};
+
+static void *counting_malloc(void *ctx, size_t size) {
+    ((struct alloc_counter *) ctx)->allocs++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t size) {
+    if (ptr == NULL) {
+        ((struct alloc_counter *) ctx)->allocs++;
+    }
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    ((struct alloc_counter *) ctx)->frees++;
+    free(ptr);
+}
+
+START_TEST(test_allocator_hooks){
+    struct alloc_counter counter = {0, 0};
+    tc_set_allocator(counting_malloc, counting_realloc, counting_free, &counter, 1);
+
+    const int k = 3, l = 5;
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, k, l, NULL);
+
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes_copy((void *) message, strlen(message));
+    bytes_t * doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+    signature_share_t * signatures[l];
+    for (int i=0; i<l; i++) {
+        char * b64 = tc_serialize_key_share(shares[i]);
+        key_share_t * share = tc_deserialize_key_share(b64);
+        tc_free(b64);
+
+        signature_share_t * signature = tc_node_sign(share, doc_pkcs1, info);
+        ck_assert(tc_verify_signature(signature, doc_pkcs1, info));
+
+        b64 = tc_serialize_signature_share(signature);
+        signatures[i] = tc_deserialize_signature_share(b64);
+        tc_free(b64);
+        tc_clear_signature_share(signature);
+        tc_clear_key_share(share);
+    }
+
+    bytes_t * rsa_signature = tc_join_signatures((void *) signatures, doc_pkcs1, info);
+    ck_assert(tc_rsa_verify(rsa_signature, doc, info, TC_SHA256));
+
+    ck_assert(counter.allocs > 0);
+
+    tc_clear_bytes(rsa_signature);
+    for (int i=0; i<l; i++) {
+        tc_clear_signature_share(signatures[i]);
+    }
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+
+    tc_release_workspace();
+
+    /* Every allocation, the ones made by GMP included, went through the hooks */
+    ck_assert_int_eq(counter.allocs, counter.frees);
+
+    tc_set_allocator(NULL, NULL, NULL, NULL, 0);
+}
+END_TEST
+
+TCase *tc_test_case_memory() {
+    TCase *tc = tcase_create("memory.c");
+    tcase_set_timeout(tc, 30);
+    tcase_add_test(tc, test_allocator_hooks);
+    return tc;
+}
@@ -0,0 +1,130 @@
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <stdlib.h>
+#include <check.h>
+
+/* Checks mont_powm against mpz_powm for a random odd modulus of the given size. */
+static void check_powm(gmp_randstate_t state, int bits) {
+    mpz_t n, b, e, expected, result, gcd;
+    mpz_inits(n, b, e, expected, result, gcd, NULL);
+
+    mpz_urandomb(n, state, bits);
+    mpz_setbit(n, bits - 1);
+    mpz_setbit(n, 0);
+
+    mp_size_t size = mpz_size(n);
+    mp_limb_t * limbs = malloc(3 * size * sizeof(mp_limb_t));
+    TC_MPZ_TO_LIMBS(limbs, size, n);
+    struct mont_ctx ctx;
+    ctx.one = limbs + size;
+    ctx.r2 = limbs + 2 * size;
+    mont_init(&ctx, limbs, size);
+
+    const int exponent_bits[] = {1, 2, 17, 64, 65, 300, bits, 2 * bits + 17};
+    for (size_t i = 0; i < sizeof(exponent_bits) / sizeof(exponent_bits[0]); i++) {
+        do {
+            mpz_urandomm(b, state, n);
+            mpz_gcd(gcd, b, n);
+        } while (mpz_cmp_ui(gcd, 1) != 0);
+        mpz_urandomb(e, state, exponent_bits[i]);
+        mpz_setbit(e, exponent_bits[i] - 1);
+
+        mpz_powm(expected, b, e, n);
+        mont_powm(result, b, e, &ctx);
+        ck_assert(mpz_cmp(result, expected) == 0);
+
+        /* Negative exponents invert the base, and the result may be one of the operands */
+        mpz_neg(e, e);
+        mpz_powm(expected, b, e, n);
+        mpz_set(result, e);
+        mont_powm(result, b, result, &ctx);
+        ck_assert(mpz_cmp(result, expected) == 0);
+
+        /* Bases out of [0, n) are reduced first */
+        mpz_neg(e, e);
+        mpz_mul_2exp(b, b, 70);
+        mpz_neg(b, b);
+        mpz_powm(expected, b, e, n);
+        mont_powm(b, b, e, &ctx);
+        ck_assert(mpz_cmp(b, expected) == 0);
+    }
+
+    mpz_set_ui(e, 0);
+    mont_powm(result, b, e, &ctx);
+    ck_assert(mpz_cmp_ui(result, 1) == 0);
+
+    free(limbs);
+    mpz_clears(n, b, e, expected, result, gcd, NULL);
+}
+
+/* Checks mont_multi_powm against mpz_powm, for count exponents of one base. */
+static void check_multi_powm(gmp_randstate_t state, int bits, size_t count) {
+    mpz_t n, b, expected, e[count], r[count];
+    mpz_ptr rp[count];
+    mpz_srcptr ep[count];
+    mpz_inits(n, b, expected, NULL);
+
+    mpz_urandomb(n, state, bits);
+    mpz_setbit(n, bits - 1);
+    mpz_setbit(n, 0);
+
+    mp_size_t size = mpz_size(n);
+    mp_limb_t * limbs = malloc(3 * size * sizeof(mp_limb_t));
+    TC_MPZ_TO_LIMBS(limbs, size, n);
+    struct mont_ctx ctx;
+    ctx.one = limbs + size;
+    ctx.r2 = limbs + 2 * size;
+    mont_init(&ctx, limbs, size);
+
+    /* Exponents of different lengths, a zero one, and a base out of [0, n) */
+    mpz_urandomb(b, state, bits + 70);
+    for (size_t i = 0; i < count; i++) {
+        mpz_inits(e[i], r[i], NULL);
+        mpz_urandomb(e[i], state, i == 1 ? 0 : (i % 3 + 1) * bits / 2 + i);
+        rp[i] = r[i], ep[i] = e[i];
+    }
+
+    mont_multi_powm(rp, b, ep, count, &ctx);
+    for (size_t i = 0; i < count; i++) {
+        mpz_powm(expected, b, e[i], n);
+        ck_assert(mpz_cmp(r[i], expected) == 0);
+    }
+
+    /* The results may be the exponents */
+    mont_multi_powm((mpz_ptr *) ep, b, ep, count, &ctx);
+    for (size_t i = 0; i < count; i++) {
+        ck_assert(mpz_cmp(e[i], r[i]) == 0);
+        mpz_clears(e[i], r[i], NULL);
+    }
+
+    free(limbs);
+    mpz_clears(n, b, expected, NULL);
+}
+
+START_TEST(test_mont_powm){
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, 1);
+
+    /* Generic sizes, and the sizes with a fixed size reduction */
+    const int sizes[] = {64, 130, 512, 1024, 2048, 3072, 4096};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        check_powm(state, sizes[i]);
+        check_multi_powm(state, sizes[i], 1);
+        check_multi_powm(state, sizes[i], 2);
+        check_multi_powm(state, sizes[i], 7);
+    }
+
+    gmp_randclear(state);
+    tc_release_workspace();
+}
+END_TEST
+
+TCase *tc_test_case_montgomery() {
+    TCase *tc = tcase_create("montgomery.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_mont_powm);
+    return tc;
+}
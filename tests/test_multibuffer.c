@@ -0,0 +1,222 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mhash.h>
+#include <check.h>
+
+#define MAX_COUNT 19
+
+/* Checks mb_powm against mpz_powm for batches of every size up to MAX_COUNT, with the selected kernel. */
+static void check_mb_powm(gmp_randstate_t state, int bits) {
+    mpz_t n, gcd, b[MAX_COUNT], e[MAX_COUNT], r[MAX_COUNT], expected[MAX_COUNT];
+    mpz_ptr rp[MAX_COUNT];
+    mpz_srcptr bp[MAX_COUNT], ep[MAX_COUNT];
+    mpz_inits(n, gcd, NULL);
+    for (int i = 0; i < MAX_COUNT; i++) {
+        mpz_inits(b[i], e[i], r[i], expected[i], NULL);
+        rp[i] = r[i], bp[i] = b[i], ep[i] = e[i];
+    }
+
+    mpz_urandomb(n, state, bits);
+    mpz_setbit(n, bits - 1);
+    mpz_setbit(n, 0);
+
+    key_metainfo_t * info = tc_init_key_metainfo(1, 1, mpz_size(n), 1);
+    TC_MPZ_TO_LIMBS(info->params.n, info->params.n_limbs, n);
+    info->params.e[0] = 65537;
+    tc_set_public_key(&info->params);
+
+    for (int count = 1; count <= MAX_COUNT; count++) {
+        for (int i = 0; i < count; i++) {
+            /* Exponents of different lengths in the same batch, zero and negative ones, and unreduced bases */
+            do {
+                mpz_urandomb(b[i], state, bits + 10 * (i % 2));
+                mpz_gcd(gcd, b[i], n);
+            } while (mpz_cmp_ui(gcd, 1) != 0);
+            mpz_urandomb(e[i], state, (i % 4 == 3) ? 17 : 2 * bits + 600);
+            if (i % 5 == 1) {
+                mpz_neg(e[i], e[i]);
+            }
+            if (i % 7 == 6) {
+                mpz_set_ui(e[i], 0);
+            }
+            mpz_powm(expected[i], b[i], e[i], n);
+        }
+
+        mb_powm(rp, bp, ep, count, &info->params);
+        for (int i = 0; i < count; i++) {
+            ck_assert(mpz_cmp(r[i], expected[i]) == 0);
+        }
+
+        /* The results may be the bases */
+        mb_powm((mpz_ptr *) bp, bp, ep, count, &info->params);
+        for (int i = 0; i < count; i++) {
+            ck_assert(mpz_cmp(b[i], expected[i]) == 0);
+        }
+    }
+
+    /* Every exponent zero */
+    for (int i = 0; i < MAX_COUNT; i++) {
+        mpz_set_ui(e[i], 0);
+    }
+    mb_powm(rp, bp, ep, MAX_COUNT, &info->params);
+    for (int i = 0; i < MAX_COUNT; i++) {
+        ck_assert(mpz_cmp_ui(r[i], 1) == 0);
+    }
+
+    tc_clear_key_metainfo(info);
+    for (int i = 0; i < MAX_COUNT; i++) {
+        mpz_clears(b[i], e[i], r[i], expected[i], NULL);
+    }
+    mpz_clears(n, gcd, NULL);
+}
+
+START_TEST(test_mb_powm){
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, 3);
+
+    const int kernels[] = {MB_KERNEL_SCALAR, MB_KERNEL_AVX2, MB_KERNEL_IFMA};
+    const int sizes[] = {64, 521, 1024, 2048};
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (mb_set_kernel(kernels[k]) != 0) {
+            continue;
+        }
+        ck_assert(mb_get_kernel() == kernels[k]);
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            check_mb_powm(state, sizes[i]);
+        }
+    }
+    mb_set_kernel(MB_KERNEL_AUTO);
+
+    gmp_randclear(state);
+    tc_release_workspace();
+}
+END_TEST
+
+/* Batch signatures verify, one by one and in batch, and any k of them join into a valid RSA signature. */
+START_TEST(test_batch_sign_verify){
+    const int count = 11, k = 3, l = 4;
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, k, l, NULL);
+
+    bytes_t * docs[count], * prepared[count];
+    for (int i = 0; i < count; i++) {
+        char message[32];
+        snprintf(message, sizeof(message), "Document %d", i);
+        docs[i] = tc_init_bytes(strdup(message), strlen(message));
+        prepared[i] = tc_prepare_document(docs[i], TC_SHA256, info);
+    }
+
+    signature_share_t * signatures[l][count];
+    for (int j = 0; j < l; j++) {
+        tc_node_sign_batch(signatures[j], shares[j], (const bytes_t **) prepared, count, info);
+    }
+
+    for (int j = 0; j < l; j++) {
+        int results[count];
+        tc_verify_signature_batch(results, (const signature_share_t **) signatures[j], (const bytes_t **) prepared,
+                                  count, info);
+        for (int i = 0; i < count; i++) {
+            ck_assert_int_eq(results[i], 1);
+            ck_assert_int_eq(tc_verify_signature(signatures[j][i], prepared[i], info), 1);
+        }
+    }
+
+    /* A share checked against another document, and a share with an unknown id, don't verify */
+    const signature_share_t * mixed[3] = {signatures[0][0], signatures[0][1], signatures[1][2]};
+    const bytes_t * mixed_docs[3] = {prepared[1], prepared[1], prepared[2]};
+    int results[3];
+    uint16_t id = signatures[1][2]->id;
+    signatures[1][2]->id = l + 1;
+    tc_verify_signature_batch(results, mixed, mixed_docs, 3, info);
+    signatures[1][2]->id = id;
+    ck_assert_int_eq(results[0], 0);
+    ck_assert_int_eq(results[1], 1);
+    ck_assert_int_eq(results[2], 0);
+
+    for (int i = 0; i < count; i++) {
+        const signature_share_t * to_join[l];
+        for (int j = 0; j < l; j++) {
+            to_join[j] = signatures[(i + j) % l][i];
+        }
+        bytes_t * rsa_signature = tc_join_signatures(to_join, prepared[i], info);
+        ck_assert(tc_rsa_verify(rsa_signature, docs[i], info, TC_SHA256));
+        tc_clear_bytes(rsa_signature);
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < l; j++) {
+            tc_clear_signature_share(signatures[j][i]);
+        }
+        tc_clear_bytes(docs[i]);
+        tc_clear_bytes(prepared[i]);
+    }
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+/* Messages of every length around the padding boundaries, in batches that refill the lanes. */
+START_TEST(test_mb_sha256){
+    const uint8_t abc_digest[32] = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+    };
+    const size_t count = 300;
+    uint8_t * data = malloc(count);
+    for (size_t i = 0; i < count; i++) {
+        data[i] = i * 7 + 3;
+    }
+    bytes_t docs[count];
+    const bytes_t * doc_ptrs[count];
+    uint8_t (* expected)[32] = malloc(count * 32), (* digests)[32] = malloc(count * 32);
+    for (size_t i = 0; i < count; i++) {
+        /* The first one is "abc", the others from short to long and back */
+        docs[i].data = i == 0 ? "abc" : (void *) (data + i % 5);
+        docs[i].data_len = i == 0 ? 3 : (i * 37) % (count - 5);
+        doc_ptrs[i] = &docs[i];
+        MHASH sha = mhash_init(MHASH_SHA256);
+        mhash(sha, docs[i].data, docs[i].data_len);
+        mhash_deinit(sha, expected[i]);
+    }
+    ck_assert(memcmp(expected[0], abc_digest, 32) == 0);
+
+    const int kernels[] = {MB_SHA256_SCALAR, MB_SHA256_AVX2, MB_SHA256_AVX512};
+    const size_t sizes[] = {1, 2, 7, 17, count};
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (mb_sha256_set_kernel(kernels[k]) != 0) {
+            continue;
+        }
+        ck_assert(mb_sha256_get_kernel() == kernels[k]);
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            memset(digests, 0, count * 32);
+            mb_sha256(digests, doc_ptrs + count - sizes[i], sizes[i]);
+            ck_assert(memcmp(digests, expected + count - sizes[i], sizes[i] * 32) == 0);
+        }
+        mb_sha256(digests, doc_ptrs, 2);
+        ck_assert(memcmp(digests[0], abc_digest, 32) == 0);
+    }
+    mb_sha256_set_kernel(MB_KERNEL_AUTO);
+
+    free(digests);
+    free(expected);
+    free(data);
+}
+END_TEST
+
+TCase *tc_test_case_multibuffer() {
+    TCase *tc = tcase_create("multibuffer.c");
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_mb_powm);
+    tcase_add_test(tc, test_batch_sign_verify);
+    tcase_add_test(tc, test_mb_sha256);
+    return tc;
+}
@@ -0,0 +1,74 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "unit_test.h"
+
+#include <string.h>
+#include <check.h>
+
+START_TEST(test_pools_recycle_shares){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 3, 5, NULL);
+
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes_copy((void *) message, strlen(message));
+    bytes_t * doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+    tc_enable_pools(16);
+
+    tc_pool_stats_t before, after;
+    tc_get_pool_stats(&before);
+
+    for (int i = 0; i < 20; i++) {
+        signature_share_t * signature = tc_node_sign(shares[i % 5], doc_pkcs1, info);
+        ck_assert(tc_verify_signature(signature, doc_pkcs1, info));
+        tc_clear_signature_share(signature);
+    }
+
+    tc_get_pool_stats(&after);
+
+    /* A signature share is a single block, every share after the first one reuses it */
+    ck_assert(after.recycled - before.recycled == 20);
+    ck_assert(after.hits - before.hits == 19);
+    ck_assert(after.cached > 0);
+
+    tc_disable_pools();
+    tc_get_pool_stats(&after);
+    ck_assert(after.cached == 0);
+
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+}
+END_TEST
+
+START_TEST(test_pools_bounded){
+    tc_enable_pools(2);
+
+    tc_pool_stats_t before, after;
+    tc_get_pool_stats(&before);
+
+    bytes_t * bs[4];
+    for (int i = 0; i < 4; i++) {
+        bs[i] = tc_init_bytes(NULL, 0);
+    }
+    for (int i = 0; i < 4; i++) {
+        tc_clear_bytes(bs[i]);
+    }
+
+    tc_get_pool_stats(&after);
+    ck_assert(after.recycled - before.recycled == 2);
+    ck_assert(after.dropped - before.dropped == 2);
+    ck_assert(after.cached == 2);
+
+    tc_disable_pools();
+}
+END_TEST
+
+TCase *tc_test_case_pool() {
+    TCase *tc = tcase_create("pool.c");
+    tcase_set_timeout(tc, 30);
+    tcase_add_test(tc, test_pools_recycle_shares);
+    tcase_add_test(tc, test_pools_bounded);
+    return tc;
+}
@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <check.h>
+
+/* Writes len bytes of data to a new temporary file, whose name is stored in path. */
+static void write_blob(char *path, const uint8_t *data, size_t len) {
+    strcpy(path, "/tmp/tc_precomputation_XXXXXX");
+    int fd = mkstemp(path);
+    ck_assert(fd >= 0);
+    ck_assert(write(fd, data, len) == (ssize_t) len);
+    close(fd);
+}
+
+static key_metainfo_t * copy_metainfo(const key_metainfo_t * info) {
+    char * serialized = tc_serialize_key_metainfo(info);
+    key_metainfo_t * copy = tc_deserialize_key_metainfo(serialized);
+    free(serialized);
+    return copy;
+}
+
+START_TEST(test_precomputation_roundtrip){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+    bytes_t * blob = tc_serialize_precomputation(info);
+    char path[64];
+    write_blob(path, blob->data, blob->data_len);
+
+    /* The restarted process maps the tables instead of building them */
+    key_metainfo_t * restarted = copy_metainfo(info);
+    ck_assert_int_eq(tc_load_precomputation(restarted, path), 0);
+    const uint8_t * begin = restarted->precomputation, * end = begin + restarted->precomputation_len;
+    const struct fixed_base * v_table = fixed_base_v(&restarted->params);
+    ck_assert(v_table != NULL);
+    ck_assert((const uint8_t *) v_table->table > begin && (const uint8_t *) v_table->table < end);
+    for (uint16_t id = 1; id <= 3; id++) {
+        const struct fixed_base * table = fixed_base_vk_inverse(restarted, id);
+        ck_assert(table != NULL);
+        ck_assert((const uint8_t *) table->table > begin && (const uint8_t *) table->table < end);
+    }
+
+    /* A blob per key */
+    ck_assert_int_eq(tc_load_precomputation(restarted, path), -1);
+
+    /* The mapped tables sign and verify like the built ones */
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+    bytes_t * prepared = tc_prepare_document(doc, TC_SHA256, info);
+    signature_share_t * signatures[3];
+    for (int i = 0; i < 3; i++) {
+        signatures[i] = tc_node_sign(shares[i], prepared, restarted);
+        ck_assert(tc_verify_signature(signatures[i], prepared, restarted));
+        ck_assert(tc_verify_signature(signatures[i], prepared, info));
+    }
+    bytes_t * rsa_signature = tc_join_signatures((const signature_share_t **) signatures, prepared, restarted);
+    ck_assert(tc_rsa_verify(rsa_signature, doc, restarted, TC_SHA256));
+
+    tc_clear_bytes(rsa_signature);
+    for (int i = 0; i < 3; i++) {
+        tc_clear_signature_share(signatures[i]);
+    }
+    tc_clear_bytes(prepared);
+    tc_clear_bytes(doc);
+    tc_clear_key_metainfo(restarted);
+    unlink(path);
+    tc_clear_bytes(blob);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+START_TEST(test_precomputation_rejected){
+    key_metainfo_t * info, * other;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+    key_share_t ** other_shares = tc_generate_keys(&other, 512, 2, 3, NULL);
+    bytes_t * blob = tc_serialize_precomputation(info);
+    uint8_t * data = malloc(blob->data_len);
+    char path[64];
+
+    /* Another key */
+    write_blob(path, blob->data, blob->data_len);
+    ck_assert_int_eq(tc_load_precomputation(other, path), -1);
+    ck_assert(other->precomputation == NULL);
+    unlink(path);
+
+    /* Truncated */
+    write_blob(path, blob->data, blob->data_len - 64);
+    ck_assert_int_eq(tc_load_precomputation(info, path), -1);
+    unlink(path);
+
+    /* Another version of the format */
+    memcpy(data, blob->data, blob->data_len);
+    data[4] ^= 0x80;
+    write_blob(path, data, blob->data_len);
+    ck_assert_int_eq(tc_load_precomputation(info, path), -1);
+    unlink(path);
+
+    /* A table out of the blob, the offset of the first one is at byte 136 */
+    memcpy(data, blob->data, blob->data_len);
+    data[136 + 5] ^= 0x01;
+    write_blob(path, data, blob->data_len);
+    ck_assert_int_eq(tc_load_precomputation(info, path), -1);
+    unlink(path);
+
+    /* A damaged table */
+    memcpy(data, blob->data, blob->data_len);
+    uint64_t offset;
+    memcpy(&offset, data + 136, sizeof offset);
+    data[offset + 8] ^= 0x01;
+    write_blob(path, data, blob->data_len);
+    ck_assert_int_eq(tc_load_precomputation(info, path), -1);
+    ck_assert(info->precomputation == NULL);
+    unlink(path);
+
+    ck_assert_int_eq(tc_load_precomputation(info, "/nonexistent/blob"), -1);
+    ck_assert(info->precomputation == NULL);
+
+    free(data);
+    tc_clear_bytes(blob);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_shares(other_shares, other);
+    tc_clear_key_metainfo(info);
+    tc_clear_key_metainfo(other);
+    tc_release_workspace();
+}
+END_TEST
+
+TCase *tc_test_case_precomputation() {
+    TCase *tc = tcase_create("precomputation.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_precomputation_roundtrip);
+    tcase_add_test(tc, test_precomputation_rejected);
+    return tc;
+}
@@ -0,0 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "unit_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#define KEYS 3
+#define REQUESTS 8 /* Per key share */
+
+/* Requests for several tenants, interleaved, come back as the shares tc_node_sign would give, in batches per key. */
+START_TEST(test_scheduler_tenants){
+    key_metainfo_t * infos[KEYS];
+    key_share_t ** shares[KEYS];
+    for (int k = 0; k < KEYS; k++) {
+        shares[k] = tc_generate_keys(&infos[k], 512, 2, 3, NULL);
+    }
+    /* Requests are never held long enough to expire, a batch only goes when it is full */
+    tc_scheduler_t * scheduler = tc_init_scheduler(2, 64, 4, 60000000, 0);
+
+    bytes_t * docs[REQUESTS][KEYS][2];
+    tc_future_t * futures[REQUESTS][KEYS][2];
+    for (int i = 0; i < REQUESTS; i++) {
+        for (int k = 0; k < KEYS; k++) {
+            for (int j = 0; j < 2; j++) {
+                char message[32];
+                snprintf(message, sizeof(message), "Request %d of %d", i, k);
+                bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+                docs[i][k][j] = tc_prepare_document(doc, TC_SHA256, infos[k]);
+                tc_clear_bytes(doc);
+                futures[i][k][j] = tc_scheduler_sign(scheduler, shares[k][j], docs[i][k][j], infos[k]);
+                ck_assert(futures[i][k][j] != NULL);
+            }
+        }
+    }
+
+    for (int i = 0; i < REQUESTS; i++) {
+        for (int k = 0; k < KEYS; k++) {
+            const signature_share_t * signatures[2];
+            for (int j = 0; j < 2; j++) {
+                signatures[j] = tc_future_signature_share(futures[i][k][j]);
+                tc_clear_future(futures[i][k][j]);
+                ck_assert(tc_verify_signature(signatures[j], docs[i][k][j], infos[k]));
+            }
+            bytes_t * rsa = tc_join_signatures(signatures, docs[i][k][0], infos[k]);
+            ck_assert(rsa != NULL);
+            tc_clear_bytes(rsa);
+            for (int j = 0; j < 2; j++) {
+                tc_clear_signature_share((signature_share_t *) signatures[j]);
+                tc_clear_bytes(docs[i][k][j]);
+            }
+        }
+    }
+
+    /* Each share got REQUESTS requests, two full batches */
+    tc_scheduler_stats_t stats;
+    tc_get_scheduler_stats(scheduler, &stats);
+    ck_assert(stats.requests == REQUESTS * KEYS * 2);
+    ck_assert(stats.batches == KEYS * 2 * REQUESTS / 4);
+    uint64_t batches = 0;
+    for (int b = 0; b < TC_SCHEDULER_BATCH_BUCKETS; b++) {
+        batches += stats.batch_sizes[b];
+    }
+    ck_assert(batches == stats.batches);
+    ck_assert(stats.batch_sizes[2] == stats.batches);
+    ck_assert(stats.wait_total_ns <= stats.requests * stats.wait_max_ns);
+
+    tc_clear_scheduler(scheduler);
+    for (int k = 0; k < KEYS; k++) {
+        tc_clear_key_shares(shares[k], infos[k]);
+        tc_clear_key_metainfo(infos[k]);
+    }
+    tc_release_workspace();
+}
+END_TEST
+
+/* A lone request is held for max_wait and no longer, and stopping signs what is still held. */
+START_TEST(test_scheduler_max_wait){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, 2, 3, NULL);
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+    bytes_t * prepared = tc_prepare_document(doc, TC_SHA256, info);
+
+    tc_scheduler_t * scheduler = tc_init_scheduler(1, 8, 16, 20000, 0);
+    tc_future_t * future = tc_scheduler_sign(scheduler, shares[0], prepared, info);
+    signature_share_t * signature = tc_future_signature_share(future);
+    tc_clear_future(future);
+    ck_assert(tc_verify_signature(signature, prepared, info));
+    tc_clear_signature_share(signature);
+
+    tc_scheduler_stats_t stats;
+    tc_get_scheduler_stats(scheduler, &stats);
+    ck_assert(stats.batches == 1);
+    ck_assert(stats.batch_sizes[0] == 1);
+    ck_assert(stats.wait_max_ns >= 20000000);
+    tc_clear_scheduler(scheduler);
+
+    /* Held for a minute, but the scheduler stops first */
+    scheduler = tc_init_scheduler(1, 8, 16, 60000000, 0);
+    future = tc_scheduler_sign(scheduler, shares[1], prepared, info);
+    tc_clear_scheduler(scheduler);
+    ck_assert(tc_future_poll(future));
+    signature = tc_future_signature_share(future);
+    tc_clear_future(future);
+    ck_assert(tc_verify_signature(signature, prepared, info));
+    tc_clear_signature_share(signature);
+
+    tc_clear_bytes(prepared);
+    tc_clear_bytes(doc);
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+TCase *tc_test_case_scheduler() {
+    TCase *tc = tcase_create("scheduler.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_scheduler_tenants);
+    tcase_add_test(tc, test_scheduler_max_wait);
+    return tc;
+}
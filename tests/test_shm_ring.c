@@ -0,0 +1,259 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "tc_internal.h"
+#include "unit_test.h"
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <check.h>
+
+#define SIGNERS 3
+#define DOCUMENTS 8
+
+static void ring_name(char * name, size_t size, const char * what) {
+    snprintf(name, size, "/tc_test_%s_%ld", what, (long) getpid());
+}
+
+/* Signer processes lay out their shares in the ring of the combiner, which verifies and joins them in place. */
+START_TEST(test_shm_ring_signers){
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, SIGNERS, SIGNERS, NULL);
+    bytes_t * docs[DOCUMENTS];
+    for (int i = 0; i < DOCUMENTS; i++) {
+        char message[32];
+        snprintf(message, sizeof(message), "Document %d", i);
+        bytes_t * doc = tc_init_bytes(strdup(message), strlen(message));
+        docs[i] = tc_prepare_document(doc, TC_SHA256, info);
+        tc_clear_bytes(doc);
+    }
+
+    /* Fewer slots than shares, so the signers wait for the combiner to release them */
+    char name[64];
+    ring_name(name, sizeof(name), "signers");
+    size_t share_size = tc_signature_share_size(info);
+    tc_shm_ring_t * ring = tc_shm_ring_create(name, 4, share_size);
+    ck_assert(ring != NULL);
+    ck_assert(tc_shm_ring_create(name, 4, share_size) == NULL);
+    ck_assert(tc_shm_ring_slot_size(ring) == share_size);
+
+    pid_t children[SIGNERS];
+    for (int j = 0; j < SIGNERS; j++) {
+        children[j] = fork();
+        ck_assert(children[j] >= 0);
+        if (children[j] == 0) {
+            tc_shm_ring_t * mine = tc_shm_ring_open(name);
+            if (mine == NULL) {
+                _exit(1);
+            }
+            for (int i = 0; i < DOCUMENTS; i++) {
+                void * slot;
+                while ((slot = tc_shm_ring_reserve(mine, share_size)) == NULL) {
+                    sched_yield();
+                }
+                signature_share_t * signature = tc_node_sign_into(slot, share_size, shares[j], docs[i], info);
+                if (signature == NULL) {
+                    _exit(2);
+                }
+                tc_shm_ring_commit(mine, slot);
+            }
+            tc_shm_ring_close(mine);
+            _exit(0);
+        }
+    }
+
+    /* Shares of a document arrive in any order, each signer sends them in the order of the documents */
+    int next[SIGNERS] = {0};
+    uint8_t * collected = malloc((size_t) DOCUMENTS * SIGNERS * share_size + 64);
+    uint8_t * base = (uint8_t *) (((uintptr_t) collected + 63) & ~(uintptr_t) 63);
+    for (int received = 0; received < DOCUMENTS * SIGNERS; received++) {
+        size_t len;
+        void * message = tc_shm_ring_receive(ring, &len, 30000);
+        ck_assert(message != NULL);
+        ck_assert(len == share_size);
+        signature_share_t * signature = tc_signature_share_attach(message, len, info);
+        ck_assert(signature != NULL);
+        int j = tc_signature_share_id(signature) - 1;
+        int i = next[j]++;
+        ck_assert(tc_verify_signature(signature, docs[i], info));
+        memcpy(base + (i * SIGNERS + j) * share_size, message, len);
+        tc_shm_ring_release(ring);
+    }
+    for (int j = 0; j < SIGNERS; j++) {
+        int status;
+        ck_assert(waitpid(children[j], &status, 0) == children[j]);
+        ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    /* The copies are attached again at their new address */
+    for (int i = 0; i < DOCUMENTS; i++) {
+        const signature_share_t * signatures[SIGNERS];
+        for (int j = 0; j < SIGNERS; j++) {
+            signatures[j] = tc_signature_share_attach(base + (i * SIGNERS + j) * share_size, share_size, info);
+        }
+        bytes_t * rsa_signature = tc_join_signatures(signatures, docs[i], info);
+        ck_assert(rsa_signature != NULL);
+        tc_clear_bytes(rsa_signature);
+    }
+
+    /* A share that isn't of the key, or doesn't fit the bytes it comes in, is refused */
+    signature_share_t * forged = (signature_share_t *) base;
+    ck_assert(tc_signature_share_attach(base, share_size - 1, info) == NULL);
+    forged->n_limbs = 1;
+    ck_assert(tc_signature_share_attach(base, share_size, info) == NULL);
+    forged->n_limbs = info->params.n_limbs + 1;
+    ck_assert(tc_signature_share_attach(base, share_size, info) == NULL);
+    forged->n_limbs = info->params.n_limbs;
+    forged->id = SIGNERS + 1;
+    ck_assert(tc_signature_share_attach(base, share_size, info) == NULL);
+    forged->id = 1;
+    ck_assert(tc_signature_share_attach(base, share_size, info) == forged);
+
+    size_t len;
+    ck_assert(tc_shm_ring_receive(ring, &len, 0) == NULL);
+    tc_shm_ring_close(ring);
+    ck_assert_int_eq(tc_shm_ring_unlink(name), 0);
+
+    free(collected);
+    for (int i = 0; i < DOCUMENTS; i++) {
+        tc_clear_bytes(docs[i]);
+    }
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_release_workspace();
+}
+END_TEST
+
+START_TEST(test_shm_ring_limits){
+    char name[64];
+    ring_name(name, sizeof(name), "limits");
+    ck_assert(tc_shm_ring_open(name) == NULL);
+    tc_shm_ring_t * ring = tc_shm_ring_create(name, 2, 16);
+    tc_shm_ring_t * sender = tc_shm_ring_open(name);
+    ck_assert(ring != NULL && sender != NULL);
+
+    uint8_t data[32] = {1, 2, 3};
+    ck_assert_int_eq(tc_shm_ring_send(sender, data, sizeof(data)), -1);
+    ck_assert_int_eq(tc_shm_ring_send(sender, data, 3), 0);
+    ck_assert_int_eq(tc_shm_ring_send(sender, data + 1, 2), 0);
+    ck_assert_int_eq(tc_shm_ring_send(sender, data, 1), -1);
+
+    size_t len;
+    uint8_t * message = tc_shm_ring_receive(ring, &len, 0);
+    ck_assert(message != NULL && len == 3 && (uintptr_t) message % 64 == 0);
+    ck_assert(memcmp(message, data, 3) == 0);
+    tc_shm_ring_release(ring);
+    ck_assert_int_eq(tc_shm_ring_send(sender, data + 2, 1), 0);
+
+    message = tc_shm_ring_receive(ring, &len, 0);
+    ck_assert(message != NULL && len == 2 && message[0] == 2);
+    tc_shm_ring_release(ring);
+    message = tc_shm_ring_receive(ring, &len, 0);
+    ck_assert(message != NULL && len == 1 && message[0] == 3);
+    tc_shm_ring_release(ring);
+    ck_assert(tc_shm_ring_receive(ring, &len, 10) == NULL);
+
+    tc_shm_ring_close(sender);
+    tc_shm_ring_close(ring);
+    ck_assert_int_eq(tc_shm_ring_unlink(name), 0);
+    ck_assert(tc_shm_ring_open(name) == NULL);
+}
+END_TEST
+
+/* Maps the shared object of a ring as another process would, with the header at its start. */
+static uint64_t * map_header(const char * name, size_t size) {
+    int fd = shm_open(name, O_RDWR, 0);
+    ck_assert(fd >= 0);
+    void * mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    ck_assert(mapped != MAP_FAILED);
+    return mapped;
+}
+
+/* Rings keep the geometry they validated, whatever another process writes in the header later. */
+START_TEST(test_shm_ring_header_rewritten){
+    char name[64];
+    ring_name(name, sizeof(name), "rewritten");
+    tc_shm_ring_t * ring = tc_shm_ring_create(name, 2, 16);
+    tc_shm_ring_t * sender = tc_shm_ring_open(name);
+    ck_assert(ring != NULL && sender != NULL);
+
+    /* slots, slot_size and stride follow the magic and the version */
+    uint64_t * header = map_header(name, 64);
+    header[1] = UINT64_C(1) << 40;
+    header[2] = UINT64_C(1) << 40;
+    header[3] = 1;
+    ck_assert(tc_shm_ring_slot_size(sender) == 16);
+
+    uint8_t data[32] = {1, 2, 3};
+    ck_assert_int_eq(tc_shm_ring_send(sender, data, sizeof(data)), -1);
+    for (int i = 0; i < 4; i++) {
+        ck_assert_int_eq(tc_shm_ring_send(sender, data + i, 3), 0);
+        size_t len;
+        uint8_t * message = tc_shm_ring_receive(ring, &len, 0);
+        ck_assert(message != NULL && len == 3 && message[0] == data[i]);
+        tc_shm_ring_release(ring);
+    }
+
+    munmap(header, 64);
+    tc_shm_ring_close(sender);
+    tc_shm_ring_close(ring);
+    ck_assert_int_eq(tc_shm_ring_unlink(name), 0);
+}
+END_TEST
+
+/* The receiver drops a message whose length doesn't fit in a slot. */
+START_TEST(test_shm_ring_forged_length){
+    char name[64];
+    ring_name(name, sizeof(name), "forged");
+    tc_shm_ring_t * ring = tc_shm_ring_create(name, 2, 16);
+    tc_shm_ring_t * sender = tc_shm_ring_open(name);
+    ck_assert(ring != NULL && sender != NULL);
+
+    /* The cells start at byte 256 and are 128 bytes apart, the length follows the sequence number */
+    uint64_t * object = map_header(name, 512);
+    uint8_t data[3] = {1, 2, 3};
+    ck_assert_int_eq(tc_shm_ring_send(sender, data, 1), 0);
+    object[(256 + 8) / 8] = UINT64_C(1) << 40;
+    ck_assert_int_eq(tc_shm_ring_send(sender, data + 1, 1), 0);
+
+    size_t len;
+    uint8_t * message = tc_shm_ring_receive(ring, &len, 0);
+    ck_assert(message != NULL && len == 1 && message[0] == 2);
+    tc_shm_ring_release(ring);
+    ck_assert(tc_shm_ring_receive(ring, &len, 0) == NULL);
+
+    /* Both cells are free again */
+    ck_assert_int_eq(tc_shm_ring_send(sender, data + 2, 1), 0);
+    ck_assert_int_eq(tc_shm_ring_send(sender, data, 1), 0);
+    message = tc_shm_ring_receive(ring, &len, 0);
+    ck_assert(message != NULL && len == 1 && message[0] == 3);
+    tc_shm_ring_release(ring);
+    message = tc_shm_ring_receive(ring, &len, 0);
+    ck_assert(message != NULL && len == 1 && message[0] == 1);
+    tc_shm_ring_release(ring);
+
+    munmap(object, 512);
+    tc_shm_ring_close(sender);
+    tc_shm_ring_close(ring);
+    ck_assert_int_eq(tc_shm_ring_unlink(name), 0);
+}
+END_TEST
+
+TCase *tc_test_case_shm_ring() {
+    TCase *tc = tcase_create("shm_ring.c");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_shm_ring_signers);
+    tcase_add_test(tc, test_shm_ring_limits);
+    tcase_add_test(tc, test_shm_ring_header_rewritten);
+    tcase_add_test(tc, test_shm_ring_forged_length);
+    return tc;
+}
@@ -1,15 +1,24 @@
 #define _POSIX_C_SOURCE 200809L
 #include "tc_internal.h"
 
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <check.h>
 
-static int bytes_eq(bytes_t *a, bytes_t *b) {
+static int bytes_eq(const bytes_t *a, const bytes_t *b) {
     return (a->data_len == b->data_len) &&
         (memcmp(a->data, b->data, a->data_len) == 0);
 }
 
+/* Compares two numbers stored as limbs, whatever their strides are */
+static int limbs_eq(const mp_limb_t *a, mp_size_t a_count, const mp_limb_t *b, mp_size_t b_count) {
+    mpz_t x, y;
+    return mpz_cmp(mpz_roinit_n(x, a, a_count), mpz_roinit_n(y, b, b_count)) == 0;
+}
+
 START_TEST(test_serialization_key_share)
     {
         key_metainfo_t *info;
@@ -19,8 +28,7 @@ START_TEST(test_serialization_key_share)
         key_share_t *share0 = tc_deserialize_key_share(share0_b64);
 
         ck_assert(shares[0]->id == share0->id);
-        ck_assert(bytes_eq(shares[0]->n, share0->n));
-        ck_assert(bytes_eq(shares[0]->s_i, share0->s_i));
+        ck_assert(limbs_eq(shares[0]->s_i, shares[0]->n_limbs, share0->s_i, share0->n_limbs));
 
         tc_clear_key_shares(shares, info);
         tc_clear_key_metainfo(info);
@@ -60,9 +68,9 @@ START_TEST(test_serialization_signature_share)
         signature_share_t *new_s = tc_deserialize_signature_share(signature_b64);
 
         ck_assert(s->id == new_s->id);
-        ck_assert(bytes_eq(s->c, new_s->c));
-        ck_assert(bytes_eq(s->x_i, new_s->x_i));
-        ck_assert(bytes_eq(s->z, new_s->z));
+        ck_assert(limbs_eq(s->c, s->n_limbs, new_s->c, new_s->n_limbs));
+        ck_assert(limbs_eq(s->x_i, s->n_limbs, new_s->x_i, new_s->n_limbs));
+        ck_assert(limbs_eq(s->z, TC_Z_LIMBS(s->n_limbs), new_s->z, TC_Z_LIMBS(new_s->n_limbs)));
 
         tc_clear_key_shares(shares, info);
         tc_clear_key_metainfo(info);
@@ -72,6 +80,221 @@ START_TEST(test_serialization_signature_share)
         free(signature_b64);
     }
 END_TEST
+/* Encodes a signature share message with the given id and fields, of which only the first len bytes are kept */
+static char *signature_share_message(uint16_t id, const bytes_t *fields, size_t len) {
+    uint8_t buffer[256];
+    uint8_t *p = buffer;
+    uint16_t net_short = htons(1);
+    memcpy(p, &net_short, sizeof(net_short)), p += sizeof(net_short);
+    net_short = htons(id);
+    memcpy(p, &net_short, sizeof(net_short)), p += sizeof(net_short);
+    for (int i = 0; i < 3; i++) {
+        uint32_t net_len = htonl(fields[i].data_len);
+        memcpy(p, &net_len, sizeof(net_len)), p += sizeof(net_len);
+        memcpy(p, fields[i].data, fields[i].data_len), p += fields[i].data_len;
+    }
+    bytes_t bs = {buffer, (uint32_t) (len < (size_t) (p - buffer) ? len : (size_t) (p - buffer))};
+    return tc_bytes_b64(&bs);
+}
+
+START_TEST(test_serialization_signature_share_error)
+    {
+        uint8_t number[16 * 8] = {1};
+        bytes_t fields[3] = {{number, 8}, {number, 8}, {number, 8}};
+
+        /* The fields fit each other and the message */
+        char *b64 = signature_share_message(1, fields, SIZE_MAX);
+        signature_share_t *ss = tc_deserialize_signature_share(b64);
+        ck_assert(ss != NULL);
+        tc_clear_signature_share(ss);
+        free(b64);
+
+        /* Truncated anywhere, in a length or in a field */
+        for (size_t len = 0; len < 2 + 2 + 3 * (4 + 8); len++) {
+            b64 = signature_share_message(1, fields, len);
+            ck_assert(tc_deserialize_signature_share(b64) == NULL);
+            free(b64);
+        }
+
+        /* A long z widens the stride of x_i and c with it */
+        fields[2].data_len = (TC_Z_LIMBS(1) + 1) * sizeof(mp_limb_t);
+        b64 = signature_share_message(1, fields, SIZE_MAX);
+        ss = tc_deserialize_signature_share(b64);
+        ck_assert(ss != NULL);
+        ck_assert(TC_Z_LIMBS(ss->n_limbs) >= TC_Z_LIMBS(1) + 1);
+        tc_clear_signature_share(ss);
+        free(b64);
+
+        /* A length past the end of the message */
+        uint8_t truncated[] = {0, 1, 0, 1, 0xff, 0xff, 0xff, 0xff, 1};
+        bytes_t bs = {truncated, sizeof(truncated)};
+        b64 = tc_bytes_b64(&bs);
+        ck_assert(tc_deserialize_signature_share(b64) == NULL);
+        free(b64);
+    }
+END_TEST
+
+/*
+ * Generates keys until n takes one or two bits of its top limb. x_i is then often below the top limb, and z below
+ * twice the limbs of n, so a share serialized without leading zeros only tells a shorter stride than the key's.
+ */
+static key_share_t **generate_keys_short_top_limb(key_metainfo_t **info, int k, int l) {
+    for (;;) {
+        key_share_t **shares = tc_generate_keys(info, 523, k, l, NULL);
+        mpz_t n;
+        size_t bits = mpz_sizeinbase(mpz_roinit_n(n, (*info)->params.n, (*info)->params.n_limbs), 2);
+        if (bits % GMP_NUMB_BITS == 1 || bits % GMP_NUMB_BITS == 2) {
+            return shares;
+        }
+        tc_clear_key_shares(shares, *info);
+        tc_clear_key_metainfo(*info);
+    }
+}
+
+START_TEST(test_serialization_signature_share_for_key)
+    {
+        key_metainfo_t *info;
+        key_share_t **shares = generate_keys_short_top_limb(&info, 2, 3);
+        mp_size_t n_limbs = info->params.n_limbs;
+
+        int shorter = 0;
+        for (int i = 0; i < 100; i++) {
+            char message[32];
+            snprintf(message, sizeof(message), "Document %d", i);
+            bytes_t *doc = tc_init_bytes(strdup(message), strlen(message));
+            bytes_t *doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+            signature_share_t *s = tc_node_sign(shares[i % 3], doc_pkcs1, info);
+            char *signature_b64 = tc_serialize_signature_share(s);
+            signature_share_t *own = tc_deserialize_signature_share(signature_b64);
+            shorter += own->n_limbs < n_limbs;
+
+            signature_share_t *new_s = tc_deserialize_signature_share_for_key(signature_b64, info);
+            ck_assert(new_s != NULL);
+            ck_assert(new_s->n_limbs == n_limbs);
+            ck_assert(new_s->id == s->id);
+            ck_assert(limbs_eq(s->x_i, s->n_limbs, new_s->x_i, new_s->n_limbs));
+            ck_assert(limbs_eq(s->c, s->n_limbs, new_s->c, new_s->n_limbs));
+            ck_assert(limbs_eq(s->z, TC_Z_LIMBS(s->n_limbs), new_s->z, TC_Z_LIMBS(new_s->n_limbs)));
+            ck_assert(tc_verify_signature(new_s, doc_pkcs1, info));
+
+            tc_clear_signature_share(own);
+            tc_clear_signature_share(new_s);
+            tc_clear_signature_share(s);
+            free(signature_b64);
+            tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+        }
+        ck_assert(shorter > 0);
+
+        /* A number longer than the key's, or an id out of it */
+        uint8_t number[16 * 8] = {1};
+        bytes_t fields[3] = {{number, (n_limbs + 1) * sizeof(mp_limb_t)}, {number, 8}, {number, 8}};
+        char *b64 = signature_share_message(1, fields, SIZE_MAX);
+        ck_assert(tc_deserialize_signature_share_for_key(b64, info) == NULL);
+        free(b64);
+        fields[0].data_len = 8;
+        b64 = signature_share_message(4, fields, SIZE_MAX);
+        ck_assert(tc_deserialize_signature_share_for_key(b64, info) == NULL);
+        free(b64);
+        b64 = signature_share_message(3, fields, SIZE_MAX);
+        signature_share_t *ss = tc_deserialize_signature_share_for_key(b64, info);
+        ck_assert(ss != NULL && ss->n_limbs == n_limbs);
+        tc_clear_signature_share(ss);
+        free(b64);
+
+        tc_clear_key_shares(shares, info);
+        tc_clear_key_metainfo(info);
+    }
+END_TEST
+
+/* Shares deserialized in the stride of their own fields verify and join, however narrow they come back */
+START_TEST(test_serialization_signature_share_narrow)
+    {
+        key_metainfo_t *info;
+        key_share_t **shares = generate_keys_short_top_limb(&info, 2, 3);
+
+        int narrow = 0;
+        for (int i = 0; i < 50; i++) {
+            char message[32];
+            snprintf(message, sizeof(message), "Document %d", i);
+            bytes_t *doc = tc_init_bytes(strdup(message), strlen(message));
+            bytes_t *doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+            signature_share_t *signatures[2];
+            for (int j = 0; j < 2; j++) {
+                signature_share_t *s = tc_node_sign(shares[j], doc_pkcs1, info);
+                char *signature_b64 = tc_serialize_signature_share(s);
+                signatures[j] = tc_deserialize_signature_share(signature_b64);
+                narrow += signatures[j]->n_limbs < info->params.n_limbs;
+                ck_assert(tc_verify_signature(signatures[j], doc_pkcs1, info));
+                tc_clear_signature_share(s);
+                free(signature_b64);
+            }
+            bytes_t *rsa_signature = tc_join_signatures((const signature_share_t **) signatures, doc_pkcs1, info);
+            ck_assert(tc_rsa_verify(rsa_signature, doc, info, TC_SHA256));
+
+            tc_clear_bytes(rsa_signature);
+            tc_clear_signature_share(signatures[0]);
+            tc_clear_signature_share(signatures[1]);
+            tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+        }
+        ck_assert(narrow > 0);
+
+        tc_clear_key_shares(shares, info);
+        tc_clear_key_metainfo(info);
+    }
+END_TEST
+
+START_TEST(test_serialization_signature_share_fixed)
+    {
+        key_metainfo_t *info;
+        key_share_t **shares = tc_generate_keys(&info, 512, 3, 5, NULL);
+
+        const char *message = "Hola mundo";
+        bytes_t *doc = tc_init_bytes(strdup(message), strlen(message));
+        bytes_t *doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+        signature_share_t *s = tc_node_sign(shares[4], doc_pkcs1, info);
+
+        /* 2 bytes of id, 4 of n_len, then x_i, c and z */
+        size_t n_len = tc_public_key_n(tc_key_meta_info_public_key(info))->data_len;
+        size_t len = tc_signature_share_fixed_size(info);
+        ck_assert(len == 2 + 4 + 4 * n_len + 64);
+        uint8_t *fixed = malloc(len + 1);
+        ck_assert_int_eq(tc_serialize_signature_share_fixed(fixed, len - 1, s, info), -1);
+        ck_assert_int_eq(tc_serialize_signature_share_fixed(fixed, len, s, info), 0);
+        ck_assert(fixed[0] == 0 && fixed[1] == 5);
+
+        size_t size = tc_signature_share_size(info);
+        void *buffer = malloc(size);
+        signature_share_t *new_s = tc_deserialize_signature_share_fixed_into(buffer, size, fixed, len, info);
+        ck_assert(new_s == buffer);
+        ck_assert(new_s->id == 5);
+        ck_assert(limbs_eq(s->x_i, s->n_limbs, new_s->x_i, new_s->n_limbs));
+        ck_assert(limbs_eq(s->c, s->n_limbs, new_s->c, new_s->n_limbs));
+        ck_assert(limbs_eq(s->z, TC_Z_LIMBS(s->n_limbs), new_s->z, TC_Z_LIMBS(new_s->n_limbs)));
+        ck_assert(tc_verify_signature(new_s, doc_pkcs1, info));
+
+        /* Another length, another key size, or an id out of the key, isn't a share of the key */
+        ck_assert(tc_deserialize_signature_share_fixed_into(buffer, size - 1, fixed, len, info) == NULL);
+        ck_assert(tc_deserialize_signature_share_fixed_into(buffer, size, fixed, len - 1, info) == NULL);
+        ck_assert(tc_deserialize_signature_share_fixed_into(buffer, size, fixed, len + 1, info) == NULL);
+        fixed[5] ^= 1;
+        ck_assert(tc_deserialize_signature_share_fixed_into(buffer, size, fixed, len, info) == NULL);
+        fixed[5] ^= 1;
+        fixed[1] = 6;
+        ck_assert(tc_deserialize_signature_share_fixed_into(buffer, size, fixed, len, info) == NULL);
+        fixed[1] = 0;
+        ck_assert(tc_deserialize_signature_share_fixed_into(buffer, size, fixed, len, info) == NULL);
+
+        free(buffer);
+        free(fixed);
+        tc_clear_signature_share(s);
+        tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+        tc_clear_key_shares(shares, info);
+        tc_clear_key_metainfo(info);
+    }
+END_TEST
+
 START_TEST(test_serialization_key_metainfo)
     {
         key_metainfo_t *mi;
@@ -82,13 +305,16 @@ START_TEST(test_serialization_key_metainfo)
 
         ck_assert(mi->k == new_mi->k);
         ck_assert(mi->l == new_mi->l);
-        ck_assert(bytes_eq(mi->public_key->n, new_mi->public_key->n));
-        ck_assert(bytes_eq(mi->public_key->e, new_mi->public_key->e));
-        ck_assert(bytes_eq(mi->vk_v, new_mi->vk_v));
-        for(int i=0; i<mi->l; i++) {
-            bytes_t * a = mi->vk_i + i;
-            bytes_t * b = new_mi->vk_i + i;
-            ck_assert(bytes_eq(a, b));
+        ck_assert(bytes_eq(tc_public_key_n(tc_key_meta_info_public_key(mi)),
+                           tc_public_key_n(tc_key_meta_info_public_key(new_mi))));
+        ck_assert(bytes_eq(tc_public_key_e(tc_key_meta_info_public_key(mi)),
+                           tc_public_key_e(tc_key_meta_info_public_key(new_mi))));
+        mp_size_t n_limbs = mi->params.n_limbs;
+        ck_assert(new_mi->params.n_limbs == n_limbs);
+        ck_assert(limbs_eq(mi->params.vk_v, n_limbs, new_mi->params.vk_v, n_limbs));
+        ck_assert(limbs_eq(mi->params.vk_u, n_limbs, new_mi->params.vk_u, n_limbs));
+        for(int i=1; i<=mi->l; i++) {
+            ck_assert(limbs_eq(TC_VK_I(mi, i), n_limbs, TC_VK_I(new_mi, i), n_limbs));
         }
 
         tc_clear_key_shares(shares, mi);
@@ -98,6 +324,35 @@ START_TEST(test_serialization_key_metainfo)
     }
 END_TEST
 
+START_TEST(test_serialization_signer_metainfo)
+    {
+        key_metainfo_t *mi;
+        key_share_t **shares = tc_generate_keys(&mi, 512, 3, 5, NULL);
+
+        signer_metainfo_t *smi = tc_extract_signer_metainfo(mi, 4);
+        char *smi_b64 = tc_serialize_signer_metainfo(smi);
+        signer_metainfo_t *new_smi = tc_deserialize_signer_metainfo(smi_b64);
+
+        ck_assert(new_smi->id == 4);
+        ck_assert(mi->k == new_smi->k);
+        ck_assert(mi->l == new_smi->l);
+        ck_assert(bytes_eq(tc_public_key_n(tc_key_meta_info_public_key(mi)),
+                           tc_public_key_n(tc_signer_metainfo_public_key(new_smi))));
+        ck_assert(bytes_eq(tc_public_key_e(tc_key_meta_info_public_key(mi)),
+                           tc_public_key_e(tc_signer_metainfo_public_key(new_smi))));
+        mp_size_t n_limbs = mi->params.n_limbs;
+        ck_assert(limbs_eq(mi->params.vk_v, n_limbs, new_smi->params.vk_v, new_smi->params.n_limbs));
+        ck_assert(limbs_eq(mi->params.vk_u, n_limbs, new_smi->params.vk_u, new_smi->params.n_limbs));
+        ck_assert(limbs_eq(TC_VK_I(mi, 4), n_limbs, new_smi->vk_i, new_smi->params.n_limbs));
+
+        tc_clear_key_shares(shares, mi);
+        tc_clear_key_metainfo(mi);
+        tc_clear_signer_metainfo(smi);
+        tc_clear_signer_metainfo(new_smi);
+        free(smi_b64);
+    }
+END_TEST
+
 
 TCase *tc_test_case_serialization() {
     TCase *tc = tcase_create("poly.c");
@@ -105,6 +360,11 @@ TCase *tc_test_case_serialization() {
     tcase_add_test(tc, test_serialization_key_share);
     tcase_add_test(tc, test_serialization_key_share_error);
     tcase_add_test(tc, test_serialization_signature_share);
+    tcase_add_test(tc, test_serialization_signature_share_error);
+    tcase_add_test(tc, test_serialization_signature_share_for_key);
+    tcase_add_test(tc, test_serialization_signature_share_narrow);
+    tcase_add_test(tc, test_serialization_signature_share_fixed);
     tcase_add_test(tc, test_serialization_key_metainfo);
+    tcase_add_test(tc, test_serialization_signer_metainfo);
     return tc;
 }
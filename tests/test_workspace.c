@@ -0,0 +1,153 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tc.h"
+#include "unit_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+static void *counting_malloc(void *ctx, size_t size) {
+    (*(long *) ctx)++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t size) {
+    (*(long *) ctx)++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ctx, void *ptr) {
+    (void) ctx;
+    free(ptr);
+}
+
+START_TEST(test_workspace_no_allocations){
+    const int k = 3, l = 5;
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, k, l, NULL);
+
+    const char * message = "Hello world!";
+    bytes_t * doc = tc_init_bytes_copy((void *) message, strlen(message));
+    bytes_t * doc_pkcs1 = tc_prepare_document(doc, TC_SHA256, info);
+
+    long allocations = 0;
+    tc_set_allocator(counting_malloc, counting_realloc, counting_free, &allocations, 1);
+    tc_enable_pools(16);
+
+    signature_share_t * signatures[k];
+    for (int round = 0; round < 2; round++) {
+        /* The first round warms up the workspace and the pools, the second one must not allocate */
+        long before = allocations;
+
+        for (int i = 0; i < k; i++) {
+            signatures[i] = tc_node_sign(shares[i], doc_pkcs1, info);
+            ck_assert(tc_verify_signature(signatures[i], doc_pkcs1, info));
+        }
+        if (round > 0) {
+            ck_assert_int_eq(allocations, before);
+        }
+
+        /* The only allocation of join is the buffer of the signature it returns */
+        bytes_t * rsa_signature = tc_join_signatures((void *) signatures, doc_pkcs1, info);
+        if (round > 0) {
+            ck_assert_int_eq(allocations, before + 1);
+        }
+
+        for (int i = 0; i < k; i++) {
+            tc_clear_signature_share(signatures[i]);
+        }
+        tc_clear_bytes(rsa_signature);
+    }
+
+    tc_disable_pools();
+    tc_release_workspace();
+    tc_set_allocator(NULL, NULL, NULL, NULL, 0);
+
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+    tc_clear_bytes_n(doc, doc_pkcs1, NULL);
+}
+END_TEST
+
+/* With the _into functions and caller buffers, a whole request doesn't allocate, even without pools. */
+START_TEST(test_workspace_into_no_allocations){
+    const int k = 3, l = 5;
+    key_metainfo_t * info;
+    key_share_t ** shares = tc_generate_keys(&info, 512, k, l, NULL);
+    size_t n_len = tc_public_key_n(tc_key_meta_info_public_key(info))->data_len;
+    size_t share_size = tc_signature_share_size(info);
+
+    const char * message = "Hello world!";
+    bytes_t doc = { .data = (void *) message, .data_len = strlen(message) };
+    uint8_t prepared_data[n_len], signature_data[n_len];
+    char b64[4 * ((n_len + 2) / 3) + 1];
+    void * buffers[k];
+    for (int i = 0; i < k; i++) {
+        buffers[i] = malloc(share_size);
+    }
+
+    long allocations = 0;
+    tc_set_allocator(counting_malloc, counting_realloc, counting_free, &allocations, 1);
+
+    signature_share_t * signatures[k];
+    for (int round = 0; round < 2; round++) {
+        /* The first round warms up the workspace */
+        long before = allocations;
+
+        ck_assert_int_eq(tc_prepare_document_into(prepared_data, n_len, &doc, TC_SHA256, info), 0);
+        bytes_t prepared = { .data = prepared_data, .data_len = n_len };
+        for (int i = 0; i < k; i++) {
+            signatures[i] = tc_node_sign_into(buffers[i], share_size, shares[i], &prepared, info);
+            ck_assert(signatures[i] == buffers[i]);
+            ck_assert(tc_verify_signature(signatures[i], &prepared, info));
+        }
+        ck_assert_int_eq(tc_join_signatures_into(signature_data, n_len, (void *) signatures, &prepared, info), 0);
+        bytes_t signature = { .data = signature_data, .data_len = n_len };
+        ck_assert_int_eq(tc_bytes_b64_into(b64, sizeof(b64), &signature), 0);
+        if (round > 0) {
+            ck_assert_int_eq(allocations, before);
+        }
+
+        /* The same results as the allocating functions */
+        ck_assert(tc_rsa_verify(&signature, &doc, info, TC_SHA256));
+        bytes_t * expected_prepared = tc_prepare_document(&doc, TC_SHA256, info);
+        ck_assert(memcmp(expected_prepared->data, prepared_data, n_len) == 0);
+        bytes_t * expected = tc_join_signatures((void *) signatures, &prepared, info);
+        ck_assert(expected->data_len <= n_len);
+        for (size_t i = 0; i < n_len - expected->data_len; i++) {
+            ck_assert_int_eq(signature_data[i], 0);
+        }
+        ck_assert(memcmp(signature_data + n_len - expected->data_len, expected->data, expected->data_len) == 0);
+        char * expected_b64 = tc_bytes_b64(&signature);
+        ck_assert_str_eq(b64, expected_b64);
+        free(expected_b64);
+        tc_clear_bytes_n(expected, expected_prepared, NULL);
+    }
+
+    /* Buffers too small */
+    bytes_t prepared = { .data = prepared_data, .data_len = n_len };
+    bytes_t signature = { .data = signature_data, .data_len = n_len };
+    ck_assert_int_eq(tc_prepare_document_into(prepared_data, n_len - 1, &doc, TC_SHA256, info), -1);
+    ck_assert(tc_node_sign_into(buffers[0], share_size - 1, shares[0], &prepared, info) == NULL);
+    ck_assert_int_eq(tc_join_signatures_into(signature_data, n_len - 1, (void *) signatures, &prepared, info), -1);
+    ck_assert_int_eq(tc_bytes_b64_into(b64, sizeof(b64) - 1, &signature), -1);
+
+    tc_release_workspace();
+    tc_set_allocator(NULL, NULL, NULL, NULL, 0);
+
+    for (int i = 0; i < k; i++) {
+        free(buffers[i]);
+    }
+    tc_clear_key_shares(shares, info);
+    tc_clear_key_metainfo(info);
+}
+END_TEST
+
+TCase *tc_test_case_workspace() {
+    TCase *tc = tcase_create("workspace.c");
+    tcase_set_timeout(tc, 30);
+    tcase_add_test(tc, test_workspace_no_allocations);
+    tcase_add_test(tc, test_workspace_into_no_allocations);
+    return tc;
+}
@@ -7,4 +7,19 @@ TCase *tc_test_case_poly_c();
 TCase *tc_test_case_serialization();
 TCase *tc_test_case_system_test();
 TCase *tc_test_case_base64();
+TCase *tc_test_case_memory();
+TCase *tc_test_case_pool();
+TCase *tc_test_case_workspace();
+TCase *tc_test_case_montgomery();
+TCase *tc_test_case_backend();
+TCase *tc_test_case_multibuffer();
+TCase *tc_test_case_fixed_base();
+TCase *tc_test_case_precomputation();
+TCase *tc_test_case_document_ctx();
+TCase *tc_test_case_algorithms_rsa_verify_c();
+TCase *tc_test_case_algorithms_pkcs1_encoding_c();
+TCase *tc_test_case_engine();
+TCase *tc_test_case_scheduler();
+TCase *tc_test_case_completion_queue();
+TCase *tc_test_case_shm_ring();
 #endif